@@ -0,0 +1,69 @@
+// Measures the cost of building a complete AST for a large synthetic
+// program: parse time, arena footprint and peak RSS of the process.
+//
+// usage: asmple_ast_bench [size_mb=64] [path]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "../lang/frontend/lexer.hpp"
+#include "../lang/frontend/parser.hpp"
+#include "../lang/frontend/source.hpp"
+#include "../lang/frontend/token_stream.hpp"
+
+static void generate(const std::string& path, size_t bytes) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && static_cast<size_t>(st.st_size) >= bytes) return;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string block;
+    for (size_t i = 0; i < 64; ++i) {
+        std::string n = std::to_string(i);
+        block += "loop" + n + ":\n";
+        block += "    let reg" + n + " = " + std::to_string(i * 7) + "\n";
+        block += "    add reg" + n + ", reg0 ; accumulate\n";
+        block += "    mul reg" + n + ", 3\n";
+        block += "    cmp reg" + n + ", 1000\n";
+        block += "    jl loop" + n + "\n";
+        block += "    print reg" + n + "\n";
+    }
+    for (size_t written = 0; written < bytes; written += block.size())
+        out << block;
+}
+
+int main(int argc, char* argv[]) {
+    size_t size_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    std::string path = argc > 2 ? argv[2] : "/tmp/asmple_ast_bench.asmp";
+    generate(path, size_mb << 20);
+
+    SourceFile source;
+    if (!source.open(path)) {
+        std::fprintf(stderr, "Could not open %s\n", path.c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Lexer lexer(source.text());
+    TokenStream tokens(lexer);
+    Arena arena;
+    Parser parser(tokens, arena);
+    auto ast = parser.parse();
+    std::chrono::duration<double> parse_time = std::chrono::steady_clock::now() - start;
+
+    size_t arena_bytes = arena.bytes_used();
+    start = std::chrono::steady_clock::now();
+    arena.reset();
+    std::chrono::duration<double> free_time = std::chrono::steady_clock::now() - start;
+
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("input %zu MB: %zu statements, parse %.3f s (%.1f ns/stmt), arena %.1f MB, "
+                "free %.3f ms, peak RSS %.1f MB\n",
+                size_mb, ast.size(), parse_time.count(), parse_time.count() * 1e9 / ast.size(),
+                arena_bytes / 1048576.0, free_time.count() * 1e3, usage.ru_maxrss / 1024.0);
+    return 0;
+}
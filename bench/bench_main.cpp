@@ -0,0 +1,280 @@
+// Microbenchmark suite for the lexer, parser, compiler, program cache and
+// every execution engine over synthetic programs. Every measurement is
+// repeated after a warmup and summarised (min/median/mean/stddev); results
+// can be written as JSON to diff between commits.
+//
+// usage: asmple_bench [--reps N] [--warmup N] [--scale F] [--filter SUBSTR] [--json PATH]
+//                     [--simd scalar|sse4|avx2]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../lang/frontend/lexer.hpp"
+#include "../lang/frontend/parser.hpp"
+#include "../lang/backend/arithmetic.hpp"
+#include "../lang/backend/interpreter.hpp"
+#include "../lang/backend/cache.hpp"
+#include "../lang/backend/compiler.hpp"
+#include "../lang/backend/vm.hpp"
+#include "../lang/backend/jit.hpp"
+#include "../lang/backend/memory.hpp"
+#include "../lang/backend/peephole.hpp"
+#include "../lang/backend/simd.hpp"
+#include "generators.hpp"
+
+struct Options {
+    int reps = 7;
+    int warmup = 2;
+    double scale = 1.0;
+    std::string filter;
+    std::string json;
+};
+
+struct Stats {
+    double min = 0, median = 0, mean = 0, stddev = 0;
+};
+
+struct Row {
+    std::string program;
+    std::string phase;
+    std::string unit;
+    uint64_t count = 0;
+    Stats ns; // per unit
+};
+
+static Stats summarize(std::vector<double> samples) {
+    Stats s;
+    std::sort(samples.begin(), samples.end());
+    s.min = samples.front();
+    size_t n = samples.size();
+    s.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    for (double v : samples) s.mean += v;
+    s.mean /= n;
+    for (double v : samples) s.stddev += (v - s.mean) * (v - s.mean);
+    s.stddev = n > 1 ? std::sqrt(s.stddev / (n - 1)) : 0;
+    return s;
+}
+
+// Runs `body` warmup + reps times; `body` returns the number of units it processed.
+static Row measure(const Options& opt, const std::string& program, const std::string& phase,
+                   const std::string& unit, const std::function<uint64_t()>& body) {
+    Row row{program, phase, unit, 0, {}};
+    for (int i = 0; i < opt.warmup; ++i) body();
+    std::vector<double> samples;
+    for (int i = 0; i < opt.reps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        row.count = body();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        samples.push_back(elapsed.count() / (row.count ? row.count : 1));
+    }
+    row.ns = summarize(samples);
+    std::printf("%-16s %-19s %12llu %-6s  median %8.2f  min %8.2f  mean %8.2f  sd %6.2f  ns/%s\n",
+                program.c_str(), phase.c_str(), static_cast<unsigned long long>(row.count), unit.c_str(),
+                row.ns.median, row.ns.min, row.ns.mean, row.ns.stddev, unit.c_str());
+    std::fflush(stdout);
+    return row;
+}
+
+static void bench_program(const Options& opt, const std::string& name, const std::string& source,
+                          int null_fd, std::vector<Row>& rows) {
+    rows.push_back(measure(opt, name, "lex", "token", [&] {
+        Lexer lexer(source);
+        return static_cast<uint64_t>(lexer.tokenize().size());
+    }));
+
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    rows.push_back(measure(opt, name, "parse", "node", [&] {
+        Arena arena;
+        Parser parser(tokens, arena);
+        return static_cast<uint64_t>(parser.parse().size());
+    }));
+
+    Arena arena;
+    Parser parser(tokens, arena);
+    auto ast = parser.parse();
+    rows.push_back(measure(opt, name, "compile", "node", [&] {
+        Compiler compiler;
+        compiler.compile(ast);
+        return static_cast<uint64_t>(ast.size());
+    }));
+
+    // Startup cost: what a launch does before running, from source versus
+    // from a fresh .asmpc next to it (the file is in the page cache).
+    rows.push_back(measure(opt, name, "startup-source", "byte", [&] {
+        Lexer lexer(source);
+        TokenStream stream(lexer);
+        Arena arena;
+        Parser parser(stream, arena);
+        Compiler compiler;
+        compiler.compile(parser.parse());
+        return static_cast<uint64_t>(source.size());
+    }));
+    {
+        ProgramCache cache;
+        std::string path = "/tmp/asmple_bench_" + std::to_string(getpid()) + ".asmpc";
+        uint64_t key = ProgramCache::key(source, true);
+        if (cache.store(path, key, Compiler().compile(ast))) {
+            rows.push_back(measure(opt, name, "startup-cache", "byte", [&] {
+                Program cached;
+                cache.load(path, ProgramCache::key(source, true), cached);
+                return static_cast<uint64_t>(source.size());
+            }));
+            std::remove(path.c_str());
+        }
+    }
+
+    // Engines run the unoptimized bytecode so ns/instr stays comparable
+    // across them; run-optimized shows what the IR passes remove.
+    Compiler compiler;
+    Program program = compiler.compile(ast, false);
+    Memory memory;
+    rows.push_back(measure(opt, name, "run-tree", "instr", [&] {
+        Interpreter interpreter(BufferMode::BLOCK, null_fd);
+        interpreter.attach_memory(&memory);
+        interpreter.interpret(ast);
+        return interpreter.nodes_executed();
+    }));
+    rows.push_back(measure(opt, name, "run-vm", "instr", [&] {
+        VM vm(BufferMode::BLOCK, null_fd);
+        vm.attach_memory(&memory);
+        vm.run(program, Dispatch::SWITCH);
+        return vm.instructions_executed();
+    }));
+    rows.push_back(measure(opt, name, "run-threaded", "instr", [&] {
+        VM vm(BufferMode::BLOCK, null_fd);
+        vm.attach_memory(&memory);
+        vm.run(program, Dispatch::THREADED);
+        return vm.instructions_executed();
+    }));
+
+    // The tree interpreter under every arithmetic policy (run-tree above is
+    // int32-wrap).
+    if (name.find("arithmetic") != std::string::npos) {
+        for (ArithmeticPolicy policy : ARITHMETIC_POLICIES) {
+            with_arithmetic(policy, [&](auto arith) {
+                rows.push_back(measure(opt, name, std::string("tree-") + arithmetic_name(policy), "instr", [&] {
+                    BasicInterpreter<decltype(arith)> interpreter(BufferMode::BLOCK, null_fd);
+                    interpreter.attach_memory(&memory);
+                    interpreter.interpret(ast);
+                    return interpreter.nodes_executed();
+                }));
+            });
+        }
+    }
+
+    if (name.find("memory") != std::string::npos) {
+        memory.set_checked(false);
+        rows.push_back(measure(opt, name, "run-unchecked", "instr", [&] {
+            VM vm(BufferMode::BLOCK, null_fd);
+            vm.attach_memory(&memory);
+            vm.run(program, Dispatch::THREADED);
+            return vm.instructions_executed();
+        }));
+        memory.set_checked(true);
+    }
+
+    Program optimized = compiler.compile(ast);
+    rows.push_back(measure(opt, name, "run-optimized", "instr", [&] {
+        VM vm(BufferMode::BLOCK, null_fd);
+        vm.attach_memory(&memory);
+        vm.run(optimized, Dispatch::SWITCH);
+        return vm.instructions_executed();
+    }));
+
+    Program fused = program;
+    Peephole().optimize(fused);
+    rows.push_back(measure(opt, name, "run-peephole", "instr", [&] {
+        VM vm(BufferMode::BLOCK, null_fd);
+        vm.attach_memory(&memory);
+        vm.run(fused, Dispatch::THREADED);
+        return vm.instructions_executed();
+    }));
+
+    // The JIT does not count instructions; reuse the VM's count so the
+    // per-instruction numbers line up.
+    Jit jit(BufferMode::BLOCK, null_fd);
+    if (jit.compile(program)) {
+        VM vm(BufferMode::BLOCK, null_fd);
+        vm.attach_memory(&memory);
+        vm.run(program);
+        uint64_t executed = vm.instructions_executed();
+        rows.push_back(measure(opt, name, "run-jit", "instr", [&] {
+            jit.run();
+            return executed;
+        }));
+    }
+}
+
+static void write_json(const std::string& path, const Options& opt, const std::vector<Row>& rows) {
+    std::ofstream out(path);
+    out << "{\n  \"reps\": " << opt.reps << ",\n  \"warmup\": " << opt.warmup
+        << ",\n  \"scale\": " << opt.scale << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Row& r = rows[i];
+        out << "    {\"program\": \"" << r.program << "\", \"phase\": \"" << r.phase
+            << "\", \"unit\": \"" << r.unit << "\", \"count\": " << r.count
+            << ", \"ns_per_unit\": {\"min\": " << r.ns.min << ", \"median\": " << r.ns.median
+            << ", \"mean\": " << r.ns.mean << ", \"stddev\": " << r.ns.stddev << "}}"
+            << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (arg == "--reps") opt.reps = std::max(1, std::atoi(value().c_str()));
+        else if (arg == "--warmup") opt.warmup = std::max(0, std::atoi(value().c_str()));
+        else if (arg == "--scale") opt.scale = std::atof(value().c_str());
+        else if (arg == "--filter") opt.filter = value();
+        else if (arg == "--json") opt.json = value();
+        else if (arg == "--simd") {
+            if (!select_vector_kernels(value())) {
+                std::fprintf(stderr, "unknown or unsupported SIMD level\n");
+                return 1;
+            }
+        } else {
+            std::fprintf(stderr, "usage: asmple_bench [--reps N] [--warmup N] [--scale F] "
+                                 "[--filter SUBSTR] [--json PATH] [--simd LEVEL]\n");
+            return 1;
+        }
+    }
+
+    auto scaled = [&](size_t n) { return std::max<size_t>(1, static_cast<size_t>(n * opt.scale)); };
+    std::vector<std::pair<std::string, std::string>> programs = {
+        {"straight-line", generate_straight_line(scaled(200000))},
+        {"nested-loops", generate_nested_loops(3, scaled(60))},
+        {"many-registers", generate_many_registers(256, scaled(2000))},
+        {"label-dense", generate_label_dense(scaled(5000), 50)},
+        {"print-heavy", generate_print_heavy(scaled(300000))},
+        {"vector-lanes", generate_vector_lanes(scaled(100000))},
+        {"scalar-lanes", generate_scalar_lanes(scaled(100000))},
+        {"memory-scan", generate_memory_scan(scaled(200000))},
+        {"arithmetic", generate_arithmetic_loop(scaled(200000))},
+        {"calls", generate_call_heavy(64, scaled(5000), false)},
+        {"calls-inlined", generate_call_heavy(64, scaled(5000), true)},
+    };
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    std::vector<Row> rows;
+    for (const auto& [name, source] : programs) {
+        if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos) continue;
+        bench_program(opt, name, source, null_fd, rows);
+    }
+    close(null_fd);
+
+    if (!opt.json.empty())
+        write_json(opt.json, opt, rows);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Run-many throughput of the embedding API: one program, many runs with
+// different starting register values. Compares compiling for every run,
+// a fresh RunContext per run and one reused context (single thread and one
+// context per thread sharing the compiled program), and counts heap
+// allocations per run.
+//
+// usage: asmple_embed_bench [--runs N] [--threads N] [--n N]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../lang/asmple.hpp"
+
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// Sums 1..n into acc; n is set by the caller.
+static const char* const SOURCE =
+    "let acc = 0\n"
+    "let i = 0\n"
+    "loop:\n"
+    "    add i, 1\n"
+    "    add acc, i\n"
+    "    cmp i, n\n"
+    "    jl loop\n";
+
+static int expected(int n) {
+    return n * (n + 1) / 2;
+}
+
+static void report(const char* name, size_t runs, uint64_t allocs, double seconds) {
+    std::printf("%-22s %10.0f runs/s  %9.2f us/run  %8.2f allocs/run\n", name, runs / seconds,
+                seconds * 1e6 / runs, static_cast<double>(allocs) / runs);
+}
+
+static void measure(const char* name, size_t runs, const std::function<void()>& body) {
+    uint64_t before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report(name, runs, allocations.load() - before, seconds);
+}
+
+static void check(int got, int n) {
+    if (got != expected(n)) {
+        std::fprintf(stderr, "wrong result for n=%d: %d\n", n, got);
+        std::exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t runs = 20000, threads = 2;
+    int n = 100;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) runs = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--threads" && i + 1 < argc) threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--n" && i + 1 < argc) n = std::atoi(argv[++i]);
+        else {
+            std::fprintf(stderr, "usage: %s [--runs N] [--threads N] [--n N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (threads == 0) threads = 1;
+
+    try {
+        measure("compile every run", runs / 10, [&] {
+            for (size_t r = 0; r < runs / 10; ++r) {
+                int value = n + static_cast<int>(r % 8);
+                CompiledProgram program =
+                    CompiledProgram::from_source("let n = " + std::to_string(value) + "\n" + SOURCE);
+                RunContext context(program);
+                context.run();
+                check(context.get("acc"), value);
+            }
+        });
+
+        CompiledProgram program = CompiledProgram::from_source(SOURCE);
+        const size_t slot_n = program.register_slot("n");
+        const size_t slot_acc = program.register_slot("acc");
+
+        measure("context per run", runs, [&] {
+            for (size_t r = 0; r < runs; ++r) {
+                int value = n + static_cast<int>(r % 8);
+                RunContext context(program);
+                context.set(slot_n, value);
+                context.run();
+                check(context.get(slot_acc), value);
+            }
+        });
+
+        measure("reused context", runs, [&] {
+            RunContext context(program);
+            for (size_t r = 0; r < runs; ++r) {
+                int value = n + static_cast<int>(r % 8);
+                context.reset();
+                context.set(slot_n, value);
+                context.run();
+                check(context.get(slot_acc), value);
+            }
+        });
+
+        std::string label = "reused, " + std::to_string(threads) + " threads";
+        measure(label.c_str(), runs * threads, [&] {
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    RunContext context(program);
+                    for (size_t r = 0; r < runs; ++r) {
+                        int value = n + static_cast<int>((r + t) % 8);
+                        context.reset();
+                        context.set(slot_n, value);
+                        context.run();
+                        check(context.get(slot_acc), value);
+                    }
+                });
+            }
+            for (auto& w : workers) w.join();
+        });
+    } catch (const std::runtime_error& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+
+// Synthetic .asmp program generators for the benchmark suite. Each takes a
+// size parameter so the same shape can be measured at different scales.
+// `n` lines of register/immediate arithmetic with no control flow.
+inline std::string generate_straight_line(size_t n) {
+    std::string src = "let a = 1\nlet b = 2\nlet c = 3\nlet d = 4\n";
+    static const char* const ops[] = {"add", "sub", "mul", "div"};
+    static const char* const regs[] = {"a", "b", "c", "d"};
+    for (size_t i = 0; i < n; ++i) {
+        src += ops[i % 4];
+        src += " ";
+        src += regs[i % 4];
+        src += ", ";
+        if (i % 3 == 0)
+            src += regs[(i + 1) % 4];
+        else
+            src += std::to_string(i % 7 + 1);
+        src += "\n";
+    }
+    src += "print a\nprint b\nprint c\nprint d\n";
+    return src;
+}
+
+// `depth` nested counting loops of `iters` iterations each, closed with cmp/jne.
+inline std::string generate_nested_loops(size_t depth, size_t iters) {
+    std::string src = "let acc = 0\n";
+    for (size_t d = 0; d < depth; ++d) {
+        std::string i = "i" + std::to_string(d);
+        src += "let " + i + " = 0\n";
+        src += "loop" + std::to_string(d) + ":\n";
+    }
+    src += "    add acc, 3\n    sub acc, 1\n";
+    for (size_t d = depth; d-- > 0; ) {
+        std::string i = "i" + std::to_string(d);
+        src += "    add " + i + ", 1\n";
+        src += "    cmp " + i + ", " + std::to_string(iters) + "\n";
+        src += "    jne loop" + std::to_string(d) + "\n";
+        if (d > 0)
+            src += "    let " + i + " = 0\n";
+    }
+    src += "print acc\n";
+    return src;
+}
+
+// `regs` distinct registers, all updated on each of `iters` loop iterations.
+inline std::string generate_many_registers(size_t regs, size_t iters) {
+    std::string src;
+    for (size_t r = 0; r < regs; ++r)
+        src += "let reg" + std::to_string(r) + " = " + std::to_string(r) + "\n";
+    src += "let n = 0\nloop:\n";
+    for (size_t r = 0; r < regs; ++r)
+        src += "    add reg" + std::to_string(r) + ", reg" + std::to_string((r + 1) % regs) + "\n";
+    src += "    add n, 1\n    cmp n, " + std::to_string(iters) + "\n    jl loop\n";
+    src += "print reg0\n";
+    return src;
+}
+
+// A chain of `n` labels, each followed by one instruction and a jump to the next.
+inline std::string generate_label_dense(size_t n, size_t iters) {
+    std::string src = "let x = 0\nlet n = 0\nstart:\n";
+    for (size_t i = 0; i < n; ++i) {
+        src += "l" + std::to_string(i) + ":\n";
+        src += "    add x, " + std::to_string(i % 5) + "\n";
+        src += "    jmp l" + std::to_string(i + 1) + "\n";
+    }
+    src += "l" + std::to_string(n) + ":\n";
+    src += "    add n, 1\n    cmp n, " + std::to_string(iters) + "\n    jl start\n";
+    src += "print x\n";
+    return src;
+}
+
+// A loop that prints its counter `n` times.
+inline std::string generate_print_heavy(size_t n) {
+    return "let i = 0\nloop:\n    print i\n    add i, 1\n    cmp i, " +
+           std::to_string(n) + "\n    jl loop\n";
+}
+
+// Eight running sums of i * k over `iters` iterations, once with the vector
+// instructions and once as the equivalent scalar code.
+inline std::string generate_vector_lanes(size_t iters) {
+    std::string src = "let i = 0\n";
+    for (int k = 0; k < 8; ++k)
+        src += "vset v1, " + std::to_string(k) + ", " + std::to_string(k + 1) + "\n";
+    src += "loop:\n    vbroadcast v2, i\n    vmul v2, v1\n    vadd v0, v2\n";
+    src += "    add i, 1\n    cmp i, " + std::to_string(iters) + "\n    jl loop\n";
+    src += "vsum s, v0\nprint s\n";
+    return src;
+}
+
+inline std::string generate_scalar_lanes(size_t iters) {
+    std::string src = "let i = 0\n";
+    for (int k = 0; k < 8; ++k)
+        src += "let acc" + std::to_string(k) + " = 0\n";
+    src += "loop:\n";
+    for (int k = 0; k < 8; ++k) {
+        src += "    let t = i\n    mul t, " + std::to_string(k + 1) + "\n";
+        src += "    add acc" + std::to_string(k) + ", t\n";
+    }
+    src += "    add i, 1\n    cmp i, " + std::to_string(iters) + "\n    jl loop\n";
+    src += "let s = acc0\n";
+    for (int k = 1; k < 8; ++k)
+        src += "add s, acc" + std::to_string(k) + "\n";
+    src += "print s\n";
+    return src;
+}
+
+// Fills `words` words of linear memory, copies them and sums the copy with
+// load in a loop.
+inline std::string generate_memory_scan(size_t words) {
+    std::string n = std::to_string(words);
+    return "memset 0, 3, " + n + "\nmemcpy " + n + ", 0, " + n + "\n"
+           "let i = " + n + "\nlet end = " + std::to_string(2 * words) + "\nlet sum = 0\n"
+           "loop:\n    load x, [i]\n    add sum, x\n    load x, [i + 1]\n    add sum, x\n"
+           "    add i, 2\n    cmp i, end\n    jl loop\nprint sum\n";
+}
+
+// A loop of add/sub/mul/div on a few registers whose values stay small, so
+// no arithmetic policy ever takes its overflow path.
+inline std::string generate_arithmetic_loop(size_t iters) {
+    return "let i = 0\nlet x = 1\nlet y = 7\nlet z = 3\n"
+           "loop:\n    add x, i\n    mul x, 3\n    div x, 7\n"
+           "    sub y, x\n    mul y, 5\n    div y, 6\n"
+           "    add z, y\n    sub z, i\n    mul z, 2\n    div z, 3\n"
+           "    add i, 1\n    cmp i, " + std::to_string(iters) + "\n    jl loop\n"
+           "print x\nprint y\nprint z\n";
+}
+
+// A loop over `sites` call sites of one subroutine that saves a register
+// with push/pop around its body, or, with `inlined`, the same loop with the
+// body pasted at every site the way programs were written before call/ret.
+inline std::string generate_call_heavy(size_t sites, size_t iters, bool inlined) {
+    const std::string body = "    let t = i\n    mul t, 3\n    add acc, t\n    sub acc, i\n";
+    std::string src = "let i = 0\nlet acc = 0\nlet t = 0\n";
+    if (!inlined) src += "jmp main\nstep:\n    push t\n" + body + "    pop t\n    ret\nmain:\n";
+    src += "loop:\n";
+    for (size_t s = 0; s < sites; ++s)
+        src += inlined ? body : "    call step\n";
+    src += "    add i, 1\n    cmp i, " + std::to_string(iters) + "\n    jl loop\nprint acc\n";
+    return src;
+}
@@ -0,0 +1,277 @@
+// Lexer throughput in MB/s on large generated sources, for every scanner
+// variant the CPU supports, against the previous byte-at-a-time lexer kept
+// here as the reference. Before timing, every variant must produce exactly
+// the reference tokens (type, text, line and column) on each source and on
+// a batch of random inputs built from the characters the lexer cares about.
+//
+// usage: asmple_lexer_bench [--mb N] [--reps N] [--fuzz N]
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../lang/frontend/lexer.hpp"
+#include "../lang/frontend/scan.hpp"
+#include "generators.hpp"
+
+namespace {
+
+// The lexer as it was before the scanners: one advance() per byte, <cctype>
+// classification and a second scan of every word to look for a label.
+class ReferenceLexer {
+public:
+    explicit ReferenceLexer(std::string_view src) : source(src) {
+        if (!source.empty()) current = source[0];
+    }
+
+    Token next_token() {
+        while (current != '\0') {
+            while (current == ' ' || current == '\t' || current == '\r')
+                advance();
+            if (current == ';') {
+                while (current && current != '\n')
+                    advance();
+                continue;
+            }
+            if (digit(current)) {
+                size_t start = pos;
+                int start_col = column;
+                while (digit(current))
+                    advance();
+                return Token(TokenType::INT, source.substr(start, pos - start), line, start_col);
+            }
+            if (alpha(current) && peek() != '\0') {
+                size_t end = pos;
+                while (end < source.size() && (alnum(source[end]) || source[end] == '_'))
+                    ++end;
+                if (end < source.size() && source[end] == ':') {
+                    Token token = word(TokenType::LABEL);
+                    advance();
+                    return token;
+                }
+            }
+            if (alpha(current) || current == '_') {
+                Token token = word(TokenType::IDENT);
+                for (const auto& in : instructions)
+                    if (token.value == in.name) token.type = TokenType::KEYWORD;
+                return token;
+            }
+            switch (current) {
+                case '+': return single(TokenType::PLUS, "+");
+                case '-': return single(TokenType::MINUS, "-");
+                case '*': return single(TokenType::MUL, "*");
+                case '/': return single(TokenType::DIV, "/");
+                case '=': return single(TokenType::EQ, "=");
+                case ',': return single(TokenType::COMMA, ",");
+                case ':': return single(TokenType::COLON, ":");
+                case '[': return single(TokenType::LBRACKET, "[");
+                case ']': return single(TokenType::RBRACKET, "]");
+                case '\n': return single(TokenType::NEWLINE, "\\n");
+                default: break;
+            }
+            advance();
+        }
+        return Token(TokenType::EOF_TOKEN, "", line, column);
+    }
+
+private:
+    std::string_view source;
+    size_t pos = 0;
+    int line = 1;
+    int column = 0;
+    char current = '\0';
+
+    static bool digit(char c) { return std::isdigit(static_cast<unsigned char>(c)); }
+    static bool alpha(char c) { return std::isalpha(static_cast<unsigned char>(c)); }
+    static bool alnum(char c) { return std::isalnum(static_cast<unsigned char>(c)); }
+
+    void advance() {
+        if (current == '\n') {
+            ++line;
+            column = 0;
+        } else {
+            ++column;
+        }
+        current = ++pos < source.size() ? source[pos] : '\0';
+    }
+
+    char peek() const { return pos + 1 < source.size() ? source[pos + 1] : '\0'; }
+
+    Token word(TokenType type) {
+        size_t start = pos;
+        int start_col = column;
+        while (alnum(current) || current == '_')
+            advance();
+        return Token(type, source.substr(start, pos - start), line, start_col);
+    }
+
+    Token single(TokenType type, std::string_view text) {
+        Token token(type, text, line, column);
+        advance();
+        return token;
+    }
+};
+
+bool same(const Token& a, const Token& b) {
+    if (a.type == TokenType::KEYWORD && b.op != find_instruction(a.value)) return false;
+    return a.type == b.type && a.value == b.value && a.line == b.line && a.column == b.column;
+}
+
+// Returns the index of the first differing token, or -1.
+long long first_mismatch(std::string_view source) {
+    ReferenceLexer reference(source);
+    Lexer lexer(source);
+    for (long long i = 0;; ++i) {
+        Token expected = reference.next_token();
+        Token actual = lexer.next_token();
+        if (!same(expected, actual)) return i;
+        if (expected.type == TokenType::EOF_TOKEN) return -1;
+    }
+}
+
+// Source shapes, each repeated up to `bytes`.
+std::string repeat(const std::string& block, size_t bytes) {
+    std::string src;
+    src.reserve(bytes + block.size());
+    while (src.size() < bytes)
+        src += block;
+    return src;
+}
+
+std::string indented_program(size_t bytes) {
+    std::string block;
+    for (size_t i = 0; i < 64; ++i) {
+        std::string n = std::to_string(i);
+        block += "loop" + n + ":\n";
+        block += "    let reg" + n + " = " + std::to_string(i * 7) + "\n";
+        block += "    add reg" + n + ", reg0 ; accumulate\n";
+        block += "    mul reg" + n + ", 3\n";
+        block += "    cmp reg" + n + ", 1000\n";
+        block += "    jl loop" + n + "\n";
+        block += "    print reg" + n + "\n";
+    }
+    return repeat(block, bytes);
+}
+
+std::string commented(size_t bytes) {
+    std::string block;
+    for (size_t i = 0; i < 32; ++i) {
+        block += "; " + std::string(40 + i * 3 % 50, 'x') + " step " + std::to_string(i) + "\n";
+        block += "\t\tadd total, " + std::to_string(i) + "          ; running sum\r\n";
+    }
+    return repeat(block, bytes);
+}
+
+std::string long_words(size_t bytes) {
+    std::string block;
+    for (size_t i = 0; i < 32; ++i) {
+        std::string name = "accumulator_for_the_" + std::to_string(i) + "th_partial_result";
+        block += "let " + name + " = " + std::to_string(1000000000 + i * 7919) + "\n";
+        block += "add " + name + ", " + name + "\n";
+    }
+    return repeat(block, bytes);
+}
+
+std::string random_source(std::mt19937& rng) {
+    static const char alphabet[] = " \t\r\n;:,+-*/=[]_09azAZ\x80\xff@\"";
+    std::string src(rng() % 300, ' ');
+    for (auto& c : src) {
+        unsigned pick = rng() % 8;
+        if (pick < 3) c = static_cast<char>('a' + rng() % 26);
+        else if (pick < 4) c = static_cast<char>('0' + rng() % 10);
+        else c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    if (rng() % 16 == 0 && !src.empty()) src[rng() % src.size()] = '\0';
+    return src;
+}
+
+template <typename L>
+double lex_seconds(const std::string& source, size_t& tokens) {
+    auto start = std::chrono::steady_clock::now();
+    L lexer(source);
+    tokens = 0;
+    while (lexer.next_token().type != TokenType::EOF_TOKEN)
+        ++tokens;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+template <typename L>
+void report(const char* shape, const char* variant, const std::string& source, int reps) {
+    std::vector<double> times;
+    size_t tokens = 0;
+    for (int i = 0; i < reps; ++i)
+        times.push_back(lex_seconds<L>(source, tokens));
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    std::printf("%-10s %-10s %10zu tokens  %8.1f MB/s  %7.1f Mtok/s\n", shape, variant, tokens,
+                source.size() / median / 1e6, tokens / median / 1e6);
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t mb = 32, fuzz = 20000;
+    int reps = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mb" && i + 1 < argc) mb = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--reps" && i + 1 < argc) reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--fuzz" && i + 1 < argc) fuzz = std::strtoul(argv[++i], nullptr, 10);
+        else {
+            std::fprintf(stderr, "usage: asmple_lexer_bench [--mb N] [--reps N] [--fuzz N]\n");
+            return 1;
+        }
+    }
+
+    std::vector<const char*> variants;
+    for (const char* name : {"scalar", "sse2", "avx2"})
+        if (select_scan_kernels(name)) variants.push_back(name);
+
+    const size_t bytes = mb << 20;
+    std::vector<std::pair<const char*, std::string>> shapes = {
+        {"program", indented_program(bytes)},
+        {"comments", commented(bytes)},
+        {"words", long_words(bytes)},
+        {"dense", repeat(generate_straight_line(10000), bytes)},
+    };
+
+    bool ok = true;
+    for (const char* variant : variants) {
+        select_scan_kernels(variant);
+        for (const auto& [shape, source] : shapes) {
+            long long at = first_mismatch(source);
+            if (at >= 0) {
+                std::printf("MISMATCH %s on %s at token %lld\n", variant, shape, at);
+                ok = false;
+            }
+        }
+        std::mt19937 rng(12345);
+        for (size_t i = 0; i < fuzz; ++i) {
+            std::string source = random_source(rng);
+            long long at = first_mismatch(source);
+            if (at >= 0) {
+                std::printf("MISMATCH %s on random input %zu at token %lld\n", variant, i, at);
+                ok = false;
+                break;
+            }
+        }
+    }
+    std::printf("tokens: %s (%zu variants, %zu random inputs)\n", ok ? "identical" : "DIFFERENT",
+                variants.size(), fuzz);
+
+    for (const auto& [shape, source] : shapes) {
+        report<ReferenceLexer>(shape, "reference", source, reps);
+        for (const char* variant : variants) {
+            select_scan_kernels(variant);
+            report<Lexer>(shape, variant, source, reps);
+        }
+    }
+    select_scan_kernels("auto");
+    return ok ? 0 : 1;
+}
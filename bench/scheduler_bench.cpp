@@ -0,0 +1,150 @@
+// Runs many looping scripts through the round-robin scheduler and checks
+// the results against uninterrupted runs: every script must print the same
+// output and execute the same number of instructions however often it was
+// suspended (a failing one up to the instruction that threw), and scripts
+// of equal length must get an equal number of turns. Then reports the cost
+// of suspending at several quantum sizes.
+//
+// usage: asmple_sched_bench [--scripts N] [--threads N] [--iters N] [--threaded]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../lang/frontend/lexer.hpp"
+#include "../lang/frontend/parser.hpp"
+#include "../lang/backend/compiler.hpp"
+#include "../lang/backend/scheduler.hpp"
+#include "../lang/backend/vm.hpp"
+#include "generators.hpp"
+
+struct Script {
+    Program program;
+    std::string expected;
+    std::string expected_error;
+    uint64_t expected_executed = 0;
+};
+
+static Program compile_source(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Arena arena;
+    Parser parser(tokens, arena);
+    auto ast = parser.parse();
+    return Compiler().compile(ast, false);
+}
+
+static void run_reference(Script& s) {
+    VM vm(BufferMode::BLOCK);
+    vm.redirect_output(&s.expected);
+    try {
+        vm.run(s.program, Dispatch::SWITCH);
+    } catch (const std::runtime_error& e) {
+        s.expected_error = e.what();
+    }
+    s.expected_executed = vm.instructions_executed();
+}
+
+int main(int argc, char** argv) {
+    size_t scripts = 64, threads = 2, iters = 20000;
+    Dispatch dispatch = Dispatch::SWITCH;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--scripts" && i + 1 < argc) scripts = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--threads" && i + 1 < argc) threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--iters" && i + 1 < argc) iters = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--threaded") dispatch = Dispatch::THREADED;
+        else {
+            std::fprintf(stderr, "usage: %s [--scripts N] [--threads N] [--iters N] [--threaded]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Three shapes, all of the same length within a shape, plus one script
+    // that fails halfway through its loop.
+    std::vector<Script> pool(scripts);
+    for (size_t i = 0; i < scripts; ++i) {
+        std::string source;
+        switch (i % 3) {
+            case 0: source = generate_print_heavy(iters); break;
+            case 1: source = generate_nested_loops(2, static_cast<size_t>(std::max(1.0, std::sqrt(iters)))); break;
+            default: source = generate_many_registers(8, iters / 4); break;
+        }
+        if (i == scripts / 2)
+            source = "let i = 0\nloop:\n    add i, 1\n    cmp i, " + std::to_string(iters / 2) +
+                     "\n    jl loop\nprint missing\n";
+        pool[i].program = compile_source(source);
+        run_reference(pool[i]);
+    }
+
+    int failures = 0;
+    const uint64_t quanta[] = {100, 1000, 10000, 100000};
+    for (uint64_t quantum : quanta) {
+        std::vector<std::unique_ptr<Execution>> runs;
+        std::vector<std::string> outputs(scripts);
+        SchedulerOptions options;
+        options.threads = threads;
+        options.quantum = quantum;
+        options.dispatch = dispatch;
+        Scheduler scheduler(options);
+        for (size_t i = 0; i < scripts; ++i) {
+            runs.push_back(std::make_unique<Execution>(pool[i].program));
+            runs.back()->output = &outputs[i];
+            scheduler.add(*runs.back());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        scheduler.run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < scripts; ++i) {
+            const Script& s = pool[i];
+            const Execution& e = *runs[i];
+            total += e.executed;
+            bool ok = outputs[i] == s.expected && e.error == s.expected_error && e.executed == s.expected_executed;
+            if (s.expected_error.empty())
+                ok = ok && e.status == Execution::Status::FINISHED;
+            else // stopped at the print of the undefined register
+                ok = ok && e.status == Execution::Status::FAILED && e.ip < s.program.code.size() &&
+                     s.program.code[e.ip].op == OpCode::PRINT;
+            if (!ok) {
+                std::fprintf(stderr, "quantum %llu: script %zu differs from its uninterrupted run\n",
+                             static_cast<unsigned long long>(quantum), i);
+                ++failures;
+            }
+        }
+
+        // Scripts of one shape execute the same instructions, so with a
+        // fair scheduler they get the same number of turns.
+        for (size_t shape = 0; shape < 3 && shape < scripts; ++shape) {
+            uint64_t lo = UINT64_MAX, hi = 0;
+            for (size_t i = shape; i < scripts; i += 3) {
+                if (i == scripts / 2) continue;
+                lo = std::min(lo, runs[i]->slices);
+                hi = std::max(hi, runs[i]->slices);
+            }
+            if (lo != UINT64_MAX && lo != hi) {
+                std::fprintf(stderr, "quantum %llu: shape %zu got %llu..%llu turns\n",
+                             static_cast<unsigned long long>(quantum), shape,
+                             static_cast<unsigned long long>(lo), static_cast<unsigned long long>(hi));
+                ++failures;
+            }
+        }
+
+        std::printf("quantum %7llu  %8llu turns  %12llu instr  %8.2f ns/instr\n",
+                    static_cast<unsigned long long>(quantum),
+                    static_cast<unsigned long long>(scheduler.turns()),
+                    static_cast<unsigned long long>(total), seconds * 1e9 / static_cast<double>(total));
+    }
+
+    if (failures)
+        std::printf("FAILED: %d mismatches\n", failures);
+    else
+        std::printf("all %zu scripts match their uninterrupted runs\n", scripts);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+// Compares peak RSS and throughput of the two front-end paths on a large
+// synthetic program:
+//   legacy - Lexer::tokenize() into a vector, then Parser::parse()
+//   stream - TokenStream pulled on demand by Parser::parse_next()
+// Each path runs in a forked child so its peak RSS is measured in isolation.
+//
+// usage: asmple_stream_bench [size_mb=1024] [path] [legacy|stream|both]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../lang/frontend/lexer.hpp"
+#include "../lang/frontend/parser.hpp"
+#include "../lang/frontend/source.hpp"
+#include "../lang/frontend/token_stream.hpp"
+
+struct Result {
+    double seconds;
+    size_t tokens;
+    size_t statements;
+};
+
+static void generate(const std::string& path, size_t bytes) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && static_cast<size_t>(st.st_size) >= bytes) return;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string block;
+    for (size_t i = 0; i < 64; ++i) {
+        std::string n = std::to_string(i);
+        block += "loop" + n + ":\n";
+        block += "    let reg" + n + " = " + std::to_string(i * 7) + "\n";
+        block += "    add reg" + n + ", reg0 ; accumulate\n";
+        block += "    mul reg" + n + ", 3\n";
+        block += "    cmp reg" + n + ", 1000\n";
+        block += "    jl loop" + n + "\n";
+        block += "    print reg" + n + "\n";
+    }
+    for (size_t written = 0; written < bytes; written += block.size())
+        out << block;
+}
+
+static Result run_legacy(SourceFile& source) {
+    auto start = std::chrono::steady_clock::now();
+    Lexer lexer(source.text());
+    auto tokens = lexer.tokenize();
+    Arena arena;
+    Parser parser(tokens, arena);
+    auto ast = parser.parse();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return Result{elapsed.count(), tokens.size(), ast.size()};
+}
+
+static Result run_stream(SourceFile& source) {
+    auto start = std::chrono::steady_clock::now();
+    Lexer lexer(source.text());
+    TokenStream tokens(lexer, &source);
+    Arena arena;
+    Parser parser(tokens, arena);
+    size_t statements = 0;
+    while (parser.parse_next()) {
+        if (++statements % 4096 == 0)
+            arena.reset();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return Result{elapsed.count(), tokens.consumed(), statements};
+}
+
+static void measure(const std::string& mode, const std::string& path) {
+    int fds[2];
+    if (pipe(fds) != 0) return;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        SourceFile source;
+        if (!source.open(path)) _exit(1);
+        Result result = mode == "legacy" ? run_legacy(source) : run_stream(source);
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+    close(fds[1]);
+    Result result{};
+    bool ok = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage {};
+    wait4(pid, &status, 0, &usage);
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cout << mode << ": failed (status " << status << ")\n";
+        return;
+    }
+    std::printf("%-7s %12zu tokens %10zu stmts %8.2f s %8.2f Mtok/s  peak RSS %8.1f MB\n",
+                mode.c_str(), result.tokens, result.statements, result.seconds,
+                result.tokens / result.seconds / 1e6, usage.ru_maxrss / 1024.0);
+}
+
+int main(int argc, char* argv[]) {
+    size_t size_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1024;
+    std::string path = argc > 2 ? argv[2] : "/tmp/asmple_stream_bench.asmp";
+    std::string mode = argc > 3 ? argv[3] : "both";
+
+    generate(path, size_mb << 20);
+    std::cout << "input: " << path << " (" << size_mb << " MB)\n";
+    if (mode == "both" || mode == "legacy") measure("legacy", path);
+    if (mode == "both" || mode == "stream") measure("stream", path);
+    return 0;
+}
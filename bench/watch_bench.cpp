@@ -0,0 +1,100 @@
+// Measures what --watch spends on one edit as the program grows: the
+// IncrementalProgram update for a single-line edit (an operand changed, a
+// line inserted and removed again, a comment changed) against lexing and
+// parsing the whole text, which is what a fresh tree-engine run starts
+// with. Programs are label-dense (a label, an add and a jump per three
+// lines), so every inserted line lands among many jump targets.
+//
+// usage: asmple_watch_bench [--reps N] [--max-lines N]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../lang/frontend/incremental.hpp"
+#include "../lang/frontend/lexer.hpp"
+#include "../lang/frontend/parser.hpp"
+#include "generators.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+template <typename F>
+static double median_us(size_t reps, F&& f) {
+    std::vector<double> times;
+    for (size_t i = 0; i < reps; ++i) {
+        auto start = Clock::now();
+        f();
+        times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    size_t reps = 21;
+    size_t max_lines = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--reps" && i + 1 < argc) reps = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--max-lines" && i + 1 < argc) max_lines = std::strtoul(argv[++i], nullptr, 10);
+        else {
+            std::fprintf(stderr, "usage: %s [--reps N] [--max-lines N]\n", argv[0]);
+            return 1;
+        }
+    }
+    reps = std::max<size_t>(reps, 1);
+
+    std::printf("%10s %10s %12s %12s %12s %12s\n", "lines", "KB", "full us", "operand us", "insert us",
+                "comment us");
+    for (size_t lines = 1000; lines <= max_lines; lines *= 10) {
+        const std::string source = generate_label_dense(lines / 3, 1);
+        // The edited line is an `add` in the middle of the program.
+        const std::string anchor = "l" + std::to_string(lines / 6) + ":\n";
+        const size_t at = source.find(anchor) + anchor.size();
+        const size_t end = source.find('\n', at) + 1;
+        const std::string line = source.substr(at, end - at);
+
+        double full = median_us(reps, [&] {
+            Lexer lexer(source);
+            auto tokens = lexer.tokenize();
+            Arena arena;
+            Parser parser(tokens, arena);
+            auto ast = parser.parse();
+            if (ast.empty()) std::abort();
+        });
+
+        IncrementalProgram program;
+        std::string text = source;
+        program.update(text);
+        std::vector<std::string> operand = {source, source};
+        operand[1].replace(at, line.size(), "    add x, 9\n");
+        std::vector<std::string> insert = {source, source};
+        insert[1].insert(at, "    add x, 1\n");
+        std::vector<std::string> comment = {source, source};
+        comment[1].replace(at, line.size(), line.substr(0, line.size() - 1) + " ; edited\n");
+
+        // Each edit toggles between two texts, so every update changes a
+        // line. The copy handed to update() is made outside the timing.
+        auto edit_us = [&](const std::vector<std::string>& texts) {
+            std::vector<double> times;
+            for (size_t i = 0; i < reps; ++i) {
+                std::string text = texts[(i + 1) % 2];
+                auto start = Clock::now();
+                program.update(text);
+                times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            }
+            std::string original = source;
+            program.update(original);
+            std::sort(times.begin(), times.end());
+            return times[times.size() / 2];
+        };
+        double operand_us = edit_us(operand);
+        double insert_us = edit_us(insert);
+        double comment_us = edit_us(comment);
+        std::printf("%10zu %10zu %12.1f %12.1f %12.1f %12.1f\n", lines, source.size() / 1024, full, operand_us,
+                    insert_us, comment_us);
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+# asmple_add_executable(<target> <source.asmp>)
+#
+# Builds an .asmp program ahead of time: `asmple --emit-cpp` translates it
+# to C++ at build time and the result is compiled like any other target.
+# The translation reruns when the program or the asmple binary changes.
+function(asmple_add_executable target source)
+    get_filename_component(source_path "${source}" ABSOLUTE)
+    set(generated "${CMAKE_CURRENT_BINARY_DIR}/${target}.cpp")
+    add_custom_command(
+        OUTPUT "${generated}"
+        COMMAND asmple "--emit-cpp=${generated}" "${source_path}"
+        DEPENDS asmple "${source_path}"
+        COMMENT "Translating ${source} to C++"
+        VERBATIM
+    )
+    add_executable(${target} "${generated}")
+endfunction()
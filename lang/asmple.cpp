@@ -0,0 +1,147 @@
+#include "asmple.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "frontend/lexer.hpp"
+#include "frontend/parser.hpp"
+#include "frontend/source.hpp"
+#include "frontend/token_stream.hpp"
+#include "backend/compiler.hpp"
+#include "backend/optimizer.hpp"
+#include "backend/peephole.hpp"
+#include "backend/vm.hpp"
+
+namespace {
+
+template <typename Tokens>
+std::shared_ptr<const Program> compile_tokens(Tokens& tokens) {
+    Arena arena;
+    Parser parser(tokens, arena);
+    auto ast = parser.parse();
+    if (parser.error_count())
+        throw std::runtime_error(std::to_string(parser.error_count()) + " syntax error(s)");
+    IRProgram ir = Compiler().build(ast);
+    Optimizer(true).optimize(ir);
+    auto program = std::make_shared<Program>(ir.lower());
+    Peephole().optimize(*program);
+    return program;
+}
+
+size_t find_slot(const Program& program, std::string_view name) {
+    for (size_t i = 0; i < program.registers.size(); ++i)
+        if (program.registers[i] == name) return i;
+    return CompiledProgram::NO_SLOT;
+}
+
+} // namespace
+
+CompiledProgram::CompiledProgram(std::shared_ptr<const Program> program)
+    : program(std::move(program)) {}
+
+CompiledProgram CompiledProgram::from_source(std::string_view source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    return CompiledProgram(compile_tokens(tokens));
+}
+
+CompiledProgram CompiledProgram::from_file(const std::string& path) {
+    SourceFile source;
+    if (!source.open(path))
+        throw std::runtime_error("Could not open " + path);
+    Lexer lexer(source.text());
+    TokenStream tokens(lexer, &source);
+    return CompiledProgram(compile_tokens(tokens));
+}
+
+const std::vector<std::string>& CompiledProgram::registers() const {
+    return program->registers;
+}
+
+size_t CompiledProgram::register_slot(std::string_view name) const {
+    return find_slot(*program, name);
+}
+
+size_t CompiledProgram::size() const {
+    return program->code.size();
+}
+
+struct RunContext::State {
+    State(const Program& program, int out_fd, int in_fd)
+        : vm(BufferMode::BLOCK, out_fd, in_fd), exec(program) {
+        exec.memory = &memory;
+    }
+
+    Memory memory;
+    VM vm;
+    Execution exec;
+};
+
+RunContext::RunContext(const CompiledProgram& program, int out_fd, int in_fd)
+    : program(program.program), state(std::make_unique<State>(*program.program, out_fd, in_fd)) {}
+
+RunContext::~RunContext() = default;
+RunContext::RunContext(RunContext&&) noexcept = default;
+RunContext& RunContext::operator=(RunContext&&) noexcept = default;
+
+void RunContext::reset() {
+    Execution& exec = state->exec;
+    std::fill(exec.values.begin(), exec.values.end(), 0);
+    std::fill(exec.defined.begin(), exec.defined.end(), 0);
+    exec.vectors = VectorFile();
+}
+
+size_t RunContext::slot_of(std::string_view name) const {
+    size_t slot = find_slot(*program, name);
+    if (slot == CompiledProgram::NO_SLOT)
+        throw std::runtime_error("Unknown register: " + std::string(name));
+    return slot;
+}
+
+void RunContext::set(size_t slot, int value) {
+    state->exec.values.at(slot) = value;
+    state->exec.defined[slot] = 1;
+}
+
+void RunContext::set(std::string_view name, int value) {
+    set(slot_of(name), value);
+}
+
+int RunContext::get(size_t slot) const {
+    const Execution& exec = state->exec;
+    if (!exec.defined.at(slot))
+        throw std::runtime_error("Unknown register: " + program->registers[slot]);
+    return exec.values[slot];
+}
+
+int RunContext::get(std::string_view name) const {
+    return get(slot_of(name));
+}
+
+bool RunContext::defined(size_t slot) const {
+    return state->exec.defined.at(slot) != 0;
+}
+
+void RunContext::set_output(std::string* sink) {
+    state->exec.output = sink;
+}
+
+void RunContext::run() {
+    Execution& exec = state->exec;
+    exec.rewind();
+    state->vm.resume(exec, std::numeric_limits<uint64_t>::max());
+    if (exec.status == Execution::Status::FAILED)
+        throw std::runtime_error(exec.error);
+}
+
+int32_t* RunContext::memory() {
+    return state->memory.data();
+}
+
+size_t RunContext::memory_size() const {
+    return state->memory.size();
+}
+
+uint64_t RunContext::instructions_executed() const {
+    return state->exec.executed;
+}
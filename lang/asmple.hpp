@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Embedding API: compile a program once, then run it any number of times,
+// from any number of threads, each run with its own context.
+//
+//     CompiledProgram program = CompiledProgram::from_source(text);
+//     RunContext context(program);
+//     size_t n = program.register_slot("n");
+//     for (int value : inputs) {
+//         context.reset();
+//         context.set(n, value);
+//         context.run();
+//     }
+
+struct Program;
+class VM;
+struct Execution;
+
+// Parsed, compiled and optimized bytecode. Immutable once built; copies
+// share the same code, and it can be run from several threads at once.
+// Registers may be preset before a run and read after it, so the optimizer
+// keeps every register's final value and assumes nothing about its start.
+class CompiledProgram {
+public:
+    static constexpr size_t NO_SLOT = static_cast<size_t>(-1);
+
+    // Throw std::runtime_error when the program cannot be read or compiled
+    // (syntax errors are also reported on stderr).
+    static CompiledProgram from_source(std::string_view source);
+    static CompiledProgram from_file(const std::string& path);
+
+    const std::vector<std::string>& registers() const;
+    // Slot of a register by name, or NO_SLOT when the program never uses it.
+    size_t register_slot(std::string_view name) const;
+    size_t size() const;
+
+private:
+    friend class RunContext;
+    explicit CompiledProgram(std::shared_ptr<const Program> program);
+
+    std::shared_ptr<const Program> program;
+};
+
+// Per-run state for one CompiledProgram: registers, flags and a VM with its
+// I/O buffers. Everything is allocated when the context is created, so a
+// context reused for many runs does no allocation per run. A context must
+// only be used by one thread at a time.
+class RunContext {
+public:
+    explicit RunContext(const CompiledProgram& program, int out_fd = 1, int in_fd = 0);
+    ~RunContext();
+    RunContext(RunContext&&) noexcept;
+    RunContext& operator=(RunContext&&) noexcept;
+
+    // Registers keep their values from one run to the next; reset() makes
+    // all of them undefined again and zeroes the vector registers.
+    void reset();
+    void set(size_t slot, int value);
+    void set(std::string_view name, int value);
+    // Throws std::runtime_error like the program would for an undefined register.
+    int get(size_t slot) const;
+    int get(std::string_view name) const;
+    bool defined(size_t slot) const;
+
+    // Output goes to `sink` (appended, flushed at the end of every run)
+    // instead of out_fd; nullptr switches back.
+    void set_output(std::string* sink);
+
+    // The context's linear memory (2^20 words, zeroed when
+    // the context is created and kept across runs), for passing data in
+    // and out of load/store.
+    int32_t* memory();
+    size_t memory_size() const;
+
+    // Runs the program from the start; throws std::runtime_error on errors.
+    void run();
+    uint64_t instructions_executed() const;
+
+private:
+    struct State;
+    std::shared_ptr<const Program> program;
+    std::unique_ptr<State> state;
+
+    size_t slot_of(std::string_view name) const;
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// What add/sub/mul/div do when the exact result does not fit.
+enum class Overflow : uint8_t {
+    WRAP,     // two's complement wraparound
+    TRAP,     // runtime error
+    SATURATE  // clamp to the nearest representable value
+};
+
+// Integer arithmetic for one register width and overflow behaviour. Engines
+// are instantiated per policy, so the checks a policy does not need are not
+// compiled in: WRAP is plain machine arithmetic. Division by zero yields 0
+// under every policy, as the language defines it.
+template <typename Int, Overflow Mode>
+struct Arithmetic {
+    static_assert(std::is_same_v<Int, int32_t> || std::is_same_v<Int, int64_t>,
+                  "registers are 32 or 64 bits wide");
+    using Value = Int;
+    using Unsigned = std::make_unsigned_t<Int>;
+    static constexpr Overflow overflow = Mode;
+    static constexpr Int MIN = std::numeric_limits<Int>::min();
+    static constexpr Int MAX = std::numeric_limits<Int>::max();
+
+    static Int add(Int lhs, Int rhs) {
+        if constexpr (Mode == Overflow::WRAP) {
+            return static_cast<Int>(static_cast<Unsigned>(lhs) + static_cast<Unsigned>(rhs));
+        } else {
+            Int result;
+            if (!add_overflows(lhs, rhs, result)) return result;
+            return overflowed(lhs, "+", rhs, rhs > 0 ? MAX : MIN);
+        }
+    }
+
+    static Int sub(Int lhs, Int rhs) {
+        if constexpr (Mode == Overflow::WRAP) {
+            return static_cast<Int>(static_cast<Unsigned>(lhs) - static_cast<Unsigned>(rhs));
+        } else {
+            Int result;
+            if (!sub_overflows(lhs, rhs, result)) return result;
+            return overflowed(lhs, "-", rhs, rhs < 0 ? MAX : MIN);
+        }
+    }
+
+    static Int mul(Int lhs, Int rhs) {
+        if constexpr (Mode == Overflow::WRAP) {
+            return static_cast<Int>(static_cast<Unsigned>(lhs) * static_cast<Unsigned>(rhs));
+        } else {
+            Int result;
+            if (!mul_overflows(lhs, rhs, result)) return result;
+            return overflowed(lhs, "*", rhs, (lhs < 0) != (rhs < 0) ? MIN : MAX);
+        }
+    }
+
+    // MIN / -1 is the only quotient that does not fit.
+    static Int div(Int lhs, Int rhs) {
+        if (rhs == 0) return 0;
+        if (rhs == -1) {
+            if constexpr (Mode == Overflow::WRAP) return sub(0, lhs);
+            else return lhs == MIN ? overflowed(lhs, "/", rhs, MAX) : -lhs;
+        }
+        return lhs / rhs;
+    }
+
+    // Narrows a register value to a 32-bit vector lane or memory word.
+    static int32_t narrow(Int value) {
+        if constexpr (std::is_same_v<Int, int32_t>) {
+            return value;
+        } else {
+            if (value >= INT32_MIN && value <= INT32_MAX) return static_cast<int32_t>(value);
+            if constexpr (Mode == Overflow::WRAP)
+                return static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint64_t>(value)));
+            else if constexpr (Mode == Overflow::SATURATE)
+                return value < 0 ? INT32_MIN : INT32_MAX;
+            else
+                throw std::runtime_error("Integer overflow: " + std::to_string(value) +
+                                         " does not fit in a 32-bit word");
+        }
+    }
+
+private:
+    // Only reached by the checking policies.
+    static Int overflowed(Int lhs, const char* op, Int rhs, Int saturated) {
+        if constexpr (Mode == Overflow::TRAP)
+            throw std::runtime_error("Integer overflow: " + std::to_string(lhs) + " " + op + " " +
+                                     std::to_string(rhs));
+        return saturated;
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    static bool add_overflows(Int lhs, Int rhs, Int& result) { return __builtin_add_overflow(lhs, rhs, &result); }
+    static bool sub_overflows(Int lhs, Int rhs, Int& result) { return __builtin_sub_overflow(lhs, rhs, &result); }
+    static bool mul_overflows(Int lhs, Int rhs, Int& result) { return __builtin_mul_overflow(lhs, rhs, &result); }
+#else
+    static bool add_overflows(Int lhs, Int rhs, Int& result) {
+        result = static_cast<Int>(static_cast<Unsigned>(lhs) + static_cast<Unsigned>(rhs));
+        return rhs > 0 ? lhs > MAX - rhs : lhs < MIN - rhs;
+    }
+    static bool sub_overflows(Int lhs, Int rhs, Int& result) {
+        result = static_cast<Int>(static_cast<Unsigned>(lhs) - static_cast<Unsigned>(rhs));
+        return rhs < 0 ? lhs > MAX + rhs : lhs < MIN + rhs;
+    }
+    static bool mul_overflows(Int lhs, Int rhs, Int& result) {
+        result = static_cast<Int>(static_cast<Unsigned>(lhs) * static_cast<Unsigned>(rhs));
+        if (lhs == 0 || rhs == 0) return false;
+        if ((lhs == -1 && rhs == MIN) || (rhs == -1 && lhs == MIN)) return true;
+        return result / rhs != lhs;
+    }
+#endif
+};
+
+using Int32Wrap = Arithmetic<int32_t, Overflow::WRAP>;
+using Int32Trap = Arithmetic<int32_t, Overflow::TRAP>;
+using Int32Saturate = Arithmetic<int32_t, Overflow::SATURATE>;
+using Int64Wrap = Arithmetic<int64_t, Overflow::WRAP>;
+using Int64Trap = Arithmetic<int64_t, Overflow::TRAP>;
+using Int64Saturate = Arithmetic<int64_t, Overflow::SATURATE>;
+
+// The policies --arith= selects from. INT32_WRAP is what the bytecode
+// engines implement.
+enum class ArithmeticPolicy : uint8_t {
+    INT32_WRAP, INT32_TRAP, INT32_SATURATE,
+    INT64_WRAP, INT64_TRAP, INT64_SATURATE
+};
+
+inline constexpr ArithmeticPolicy ARITHMETIC_POLICIES[] = {
+    ArithmeticPolicy::INT32_WRAP, ArithmeticPolicy::INT32_TRAP, ArithmeticPolicy::INT32_SATURATE,
+    ArithmeticPolicy::INT64_WRAP, ArithmeticPolicy::INT64_TRAP, ArithmeticPolicy::INT64_SATURATE
+};
+
+inline const char* arithmetic_name(ArithmeticPolicy policy) {
+    switch (policy) {
+        case ArithmeticPolicy::INT32_WRAP: return "int32-wrap";
+        case ArithmeticPolicy::INT32_TRAP: return "int32-trap";
+        case ArithmeticPolicy::INT32_SATURATE: return "int32-saturate";
+        case ArithmeticPolicy::INT64_WRAP: return "int64-wrap";
+        case ArithmeticPolicy::INT64_TRAP: return "int64-trap";
+        case ArithmeticPolicy::INT64_SATURATE: return "int64-saturate";
+    }
+    return "?";
+}
+
+inline bool parse_arithmetic(std::string_view name, ArithmeticPolicy& policy) {
+    for (ArithmeticPolicy candidate : ARITHMETIC_POLICIES) {
+        if (name == arithmetic_name(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Calls `f` with a value of the policy's Arithmetic type, so a runtime
+// choice reaches code that is specialised at compile time.
+template <typename F>
+decltype(auto) with_arithmetic(ArithmeticPolicy policy, F&& f) {
+    switch (policy) {
+        case ArithmeticPolicy::INT32_TRAP: return f(Int32Trap{});
+        case ArithmeticPolicy::INT32_SATURATE: return f(Int32Saturate{});
+        case ArithmeticPolicy::INT64_WRAP: return f(Int64Wrap{});
+        case ArithmeticPolicy::INT64_TRAP: return f(Int64Trap{});
+        case ArithmeticPolicy::INT64_SATURATE: return f(Int64Saturate{});
+        case ArithmeticPolicy::INT32_WRAP: break;
+    }
+    return f(Int32Wrap{});
+}
@@ -0,0 +1,176 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "../frontend/lexer.hpp"
+#include "../frontend/parser.hpp"
+#include "../frontend/source.hpp"
+#include "compiler.hpp"
+#include "interpreter.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "peephole.hpp"
+#include "vm.hpp"
+
+BatchRunner::BatchRunner(BatchOptions options)
+    : options(std::move(options)) {}
+
+std::vector<BatchFile> BatchRunner::collect(const std::vector<std::string>& inputs) {
+    namespace fs = std::filesystem;
+    std::vector<BatchFile> files;
+    for (const auto& input : inputs) {
+        std::error_code ec;
+        if (!fs::is_directory(input, ec)) {
+            files.push_back({input, fs::path(input).filename().string()});
+            continue;
+        }
+        std::vector<fs::path> found;
+        for (const auto& entry : fs::recursive_directory_iterator(input, ec))
+            if (entry.is_regular_file() && entry.path().extension() == ".asmp")
+                found.push_back(entry.path());
+        std::sort(found.begin(), found.end());
+        for (const auto& path : found)
+            files.push_back({path.string(), path.lexically_relative(input).generic_string()});
+    }
+    return files;
+}
+
+size_t BatchRunner::run(const std::vector<BatchFile>& files) {
+    const size_t n = files.size();
+    if (!options.output_dir.empty()) {
+        std::unordered_set<std::string> names;
+        for (const auto& file : files)
+            if (!names.insert(file.name).second)
+                throw std::runtime_error("More than one input would write " + file.name + ".out");
+    }
+    std::vector<Result> results(n);
+    std::vector<char> finished(n, 0);
+    size_t next = 0;
+    std::mutex emit_lock;
+    OutputBuffer out(1, BufferMode::BLOCK);
+    int null_fd = ::open("/dev/null", O_RDONLY);
+
+    // Called by whichever worker finishes a program: writes out every result
+    // that is now at the head of the input order.
+    auto emit = [&](size_t index) {
+        std::lock_guard<std::mutex> guard(emit_lock);
+        finished[index] = 1;
+        for (; next < n && finished[next]; ++next) {
+            Result& r = results[next];
+            if (options.output_dir.empty())
+                out.write(r.output);
+            if (r.failed || !r.diagnostics.empty()) {
+                out.flush();
+                std::istringstream lines(r.diagnostics);
+                for (std::string line; std::getline(lines, line);)
+                    std::cerr << files[next].path << ": " << line << "\n";
+                if (r.failed) std::cerr << files[next].path << ": " << r.error << "\n";
+            }
+            std::string().swap(r.output);
+            std::string().swap(r.diagnostics);
+        }
+    };
+
+    std::vector<WorkStealingPool::Task> tasks;
+    tasks.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        tasks.emplace_back([&, i](size_t) {
+            run_one(files[i].path, results[i], null_fd);
+            if (!options.output_dir.empty()) {
+                std::filesystem::path out_path = std::filesystem::path(options.output_dir) / (files[i].name + ".out");
+                std::error_code ec;
+                std::filesystem::create_directories(out_path.parent_path(), ec);
+                std::FILE* f = std::fopen(out_path.string().c_str(), "wb");
+                if (f) {
+                    std::fwrite(results[i].output.data(), 1, results[i].output.size(), f);
+                    std::fclose(f);
+                }
+            }
+            emit(i);
+        });
+    }
+
+    size_t jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    WorkStealingPool pool(std::min(jobs, std::max<size_t>(n, 1)));
+    auto start = std::chrono::steady_clock::now();
+    pool.run(std::move(tasks));
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    out.flush();
+    if (null_fd >= 0) ::close(null_fd);
+
+    programs = n;
+    failures = 0;
+    instructions = 0;
+    for (const Result& r : results) {
+        failures += r.failed;
+        instructions += r.instructions;
+    }
+    wall_seconds = elapsed.count();
+    workers = pool.stats();
+    return failures;
+}
+
+void BatchRunner::run_one(const std::string& path, Result& result, int null_fd) const {
+    SourceFile source;
+    if (!source.open(path)) {
+        result.failed = true;
+        result.error = "Could not open " + path;
+        return;
+    }
+    std::ostringstream diagnostics;
+    try {
+        Memory memory;
+        Lexer lexer(source.text());
+        TokenStream tokens(lexer, &source);
+        Arena arena;
+        Parser parser(tokens, arena);
+        parser.report_to(diagnostics);
+        auto ast = parser.parse();
+
+        if (options.engine == "tree") {
+            Interpreter interpreter(BufferMode::BLOCK, 1, null_fd);
+            interpreter.redirect_output(&result.output);
+            interpreter.attach_memory(&memory);
+            interpreter.interpret(ast);
+            result.instructions = interpreter.nodes_executed();
+        } else {
+            Compiler compiler;
+            Program program = compiler.compile(ast, options.optimize);
+            Peephole().optimize(program);
+            VM vm(BufferMode::BLOCK, 1, null_fd);
+            vm.redirect_output(&result.output);
+            vm.attach_memory(&memory);
+            vm.run(program, Dispatch::THREADED);
+            result.instructions = vm.instructions_executed();
+        }
+    } catch (const std::runtime_error& e) {
+        // The engine has been destroyed by now, so its buffered output is
+        // already in result.output ahead of the error.
+        result.failed = true;
+        result.error = std::string("Error: ") + e.what();
+    }
+    result.diagnostics = diagnostics.str();
+}
+
+void BatchRunner::summary(std::ostream& out) const {
+    char line[160];
+    std::snprintf(line, sizeof(line), "Batch: %zu program(s), %zu failed, %.3f s, %.1f programs/s, %llu instructions\n",
+                  programs, failures, wall_seconds, wall_seconds > 0 ? programs / wall_seconds : 0.0,
+                  static_cast<unsigned long long>(instructions));
+    out << line;
+    for (size_t w = 0; w < workers.size(); ++w) {
+        const auto& s = workers[w];
+        std::snprintf(line, sizeof(line), "  worker %zu: %zu task(s), %zu stolen, %.1f%% busy\n", w, s.tasks,
+                      s.steals, wall_seconds > 0 ? 100.0 * s.busy_seconds / wall_seconds : 0.0);
+        out << line;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../common/thread_pool.hpp"
+
+// Runs many programs in one process on a work-stealing pool. Every program
+// gets its own front end, compiler and engine state and prints into a
+// private buffer; buffers are written to stdout in input order as soon as
+// all earlier programs have finished, or to <output_dir>/<name>.out.
+// Programs read from an empty stdin. Syntax errors are held with the
+// program's output and printed to stderr in the same order.
+struct BatchOptions {
+    std::string engine = "vm"; // vm or tree
+    size_t jobs = 0;           // 0: one worker per hardware thread
+    std::string output_dir;    // empty: ordered output on stdout
+    bool optimize = true;
+};
+
+struct BatchFile {
+    std::string path;
+    std::string name; // where its output goes under output_dir, without ".out"
+};
+
+class BatchRunner {
+public:
+    explicit BatchRunner(BatchOptions options);
+
+    // Expands directories into the .asmp files they contain (sorted);
+    // other paths are taken as they are. A file found in a directory is
+    // named by its path below that directory, any other by its file name.
+    static std::vector<BatchFile> collect(const std::vector<std::string>& inputs);
+
+    // Returns the number of programs that failed. Throws std::runtime_error
+    // before running anything when two files would write the same output.
+    size_t run(const std::vector<BatchFile>& files);
+    void summary(std::ostream& out) const;
+
+private:
+    struct Result {
+        std::string output;
+        std::string error;
+        std::string diagnostics; // syntax errors
+        uint64_t instructions = 0;
+        bool failed = false;
+    };
+
+    BatchOptions options;
+    size_t programs = 0;
+    size_t failures = 0;
+    uint64_t instructions = 0;
+    double wall_seconds = 0;
+    std::vector<WorkStealingPool::WorkerStats> workers;
+
+    void run_one(const std::string& path, Result& result, int null_fd) const;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../common/opcodes.hpp"
+
+// Operand mode bits: when set, the operand holds an immediate value
+// instead of a register slot.
+enum OperandMode : uint8_t {
+    A_IMM = 1 << 0,
+    B_IMM = 1 << 1,
+    C_IMM = 1 << 2
+};
+
+// Fixed-size instruction. `a` is the destination register, the left
+// operand or the jump target; `b` is the source / right operand; `c` is
+// only used by the memory instructions.
+struct Instr {
+    OpCode op;
+    uint8_t mode;
+    int32_t a;
+    int32_t b;
+    int32_t c = 0;
+};
+
+// Position in the source a bytecode instruction came from; line 0 marks
+// instructions the compiler synthesized.
+struct SourceLoc {
+    int line = 0;
+    int column = 0;
+};
+
+struct Program {
+    std::vector<Instr> code;
+    std::vector<std::string> registers;
+    std::vector<std::string> messages;
+
+    // Debug info, used by the profiler. `locations` is parallel to `code`
+    // (empty for programs loaded from a cache); `labels` lists each label
+    // with the index of the instruction it marks, in code order.
+    std::vector<SourceLoc> locations;
+    std::vector<std::pair<size_t, std::string>> labels;
+};
@@ -0,0 +1,252 @@
+#include "cache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+#include "../common/vector.hpp"
+
+namespace {
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t instr_size;
+    uint32_t instr_count;
+    uint32_t register_count;
+    uint32_t message_count;
+};
+
+constexpr char MAGIC[4] = {'A', 'S', 'P', 'C'};
+
+static_assert(std::is_trivially_copyable<Instr>::value, "Instr is written to disk as raw bytes");
+static_assert(sizeof(CacheHeader) % alignof(Instr) == 0, "code must stay aligned after the header");
+
+// Read-only mapping of a whole file, unmapped on scope exit.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = static_cast<const char*>(p);
+                size = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+bool read_strings(const char*& at, const char* end, uint32_t count, std::vector<std::string>& out) {
+    out.clear();
+    out.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t length = 0;
+        if (static_cast<size_t>(end - at) < sizeof(length)) return false;
+        std::memcpy(&length, at, sizeof(length));
+        at += sizeof(length);
+        if (static_cast<size_t>(end - at) < length) return false;
+        out.emplace_back(at, length);
+        at += length;
+    }
+    return true;
+}
+
+// Rejects anything the compiler could not have produced, so a damaged file
+// can never make the VM index out of bounds.
+bool valid(const Program& program) {
+    const size_t regs = program.registers.size();
+    const size_t size = program.code.size();
+    auto reg = [&](int32_t v) { return v >= 0 && static_cast<size_t>(v) < regs; };
+    auto operand = [&](int32_t v, bool immediate) { return immediate || reg(v); };
+    auto vector = [](int32_t v) { return v >= 0 && static_cast<size_t>(v) < VECTOR_REGISTERS; };
+
+    for (const Instr& in : program.code) {
+        switch (in.op) {
+            case OpCode::NOP:
+                break;
+            case OpCode::LOAD: case OpCode::ADD: case OpCode::SUB:
+            case OpCode::MUL: case OpCode::DIV:
+                if (!reg(in.a) || !operand(in.b, in.mode & B_IMM)) return false;
+                break;
+            case OpCode::CMP:
+                if (!operand(in.a, in.mode & A_IMM) || !operand(in.b, in.mode & B_IMM)) return false;
+                break;
+            case OpCode::JMP: case OpCode::JE: case OpCode::JNE: case OpCode::JL:
+            case OpCode::JG: case OpCode::JLE: case OpCode::JGE:
+                if (in.a < 0 || static_cast<size_t>(in.a) > size) return false;
+                break;
+            case OpCode::PRINT:
+                if (!operand(in.b, in.mode & B_IMM)) return false;
+                break;
+            case OpCode::READ:
+                if (!reg(in.a)) return false;
+                break;
+            case OpCode::TRAP:
+                if (in.a < 0 || static_cast<size_t>(in.a) >= program.messages.size()) return false;
+                break;
+            case OpCode::VADD: case OpCode::VSUB: case OpCode::VMUL: case OpCode::VCMP:
+                if (!vector(in.a) || !vector(in.b)) return false;
+                break;
+            case OpCode::VBROADCAST:
+                if (!vector(in.a) || !operand(in.b, in.mode & B_IMM)) return false;
+                break;
+            case OpCode::VSET:
+                if (in.a < 0 || static_cast<size_t>(in.a) >= VECTOR_REGISTERS * VECTOR_LANES ||
+                    !operand(in.b, in.mode & B_IMM))
+                    return false;
+                break;
+            case OpCode::VSUM: case OpCode::VMIN: case OpCode::VMAX:
+                if (!reg(in.a) || !vector(in.b)) return false;
+                break;
+            case OpCode::VPRINT:
+                if (!vector(in.b)) return false;
+                break;
+            case OpCode::MEM_LOAD:
+                if (!reg(in.a) || !operand(in.b, in.mode & B_IMM)) return false;
+                break;
+            case OpCode::MEM_STORE:
+                if (!operand(in.a, in.mode & A_IMM) || !operand(in.b, in.mode & B_IMM)) return false;
+                break;
+            case OpCode::MEM_COPY: case OpCode::MEM_FILL:
+                if (!operand(in.a, in.mode & A_IMM) || !operand(in.b, in.mode & B_IMM) ||
+                    !operand(in.c, in.mode & C_IMM))
+                    return false;
+                break;
+            case OpCode::CALL:
+                if (in.a < 0 || static_cast<size_t>(in.a) > size) return false;
+                break;
+            case OpCode::RET:
+                break;
+            case OpCode::PUSH:
+                if (!operand(in.b, in.mode & B_IMM)) return false;
+                break;
+            case OpCode::POP:
+                if (!reg(in.a)) return false;
+                break;
+            default:
+                // Superinstructions are introduced after loading, never stored.
+                return false;
+        }
+    }
+    return true;
+}
+
+void write_strings(std::ofstream& out, const std::vector<std::string>& strings) {
+    for (const auto& s : strings) {
+        uint32_t length = static_cast<uint32_t>(s.size());
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(s.data(), static_cast<std::streamsize>(s.size()));
+    }
+}
+
+} // namespace
+
+ProgramCache::ProgramCache(std::string directory)
+    : directory(std::move(directory)) {}
+
+// FNV-1a over the source, then the options that change the bytecode.
+uint64_t ProgramCache::key(std::string_view source, bool optimized) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : source) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    hash ^= (static_cast<uint64_t>(VERSION) << 1) | (optimized ? 1 : 0);
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+std::string ProgramCache::path_for(const std::string& source_path, uint64_t key) const {
+    if (directory.empty()) {
+        if (source_path.size() > 5 && source_path.compare(source_path.size() - 5, 5, ".asmp") == 0)
+            return source_path + "c";
+        return source_path + ".asmpc";
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.asmpc", static_cast<unsigned long long>(key));
+    return directory + "/" + name;
+}
+
+bool ProgramCache::load(const std::string& path, uint64_t key, Program& program) const {
+    return read(path, &key, program);
+}
+
+bool ProgramCache::load(const std::string& path, Program& program) const {
+    return read(path, nullptr, program);
+}
+
+bool ProgramCache::read(const std::string& path, const uint64_t* key, Program& program) const {
+    MappedFile file(path);
+    if (!file.data || file.size < sizeof(CacheHeader)) return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.instr_size != sizeof(Instr) || (key && header.key != *key))
+        return false;
+
+    const char* at = file.data + sizeof(header);
+    const char* end = file.data + file.size;
+    size_t code_bytes = static_cast<size_t>(header.instr_count) * sizeof(Instr);
+    if (static_cast<size_t>(end - at) < code_bytes) return false;
+
+    Program loaded;
+    loaded.code.resize(header.instr_count);
+    std::memcpy(loaded.code.data(), at, code_bytes);
+    at += code_bytes;
+    if (!read_strings(at, end, header.register_count, loaded.registers) ||
+        !read_strings(at, end, header.message_count, loaded.messages) ||
+        !valid(loaded))
+        return false;
+
+    program = std::move(loaded);
+    return true;
+}
+
+bool ProgramCache::store(const std::string& path, uint64_t key, const Program& program) const {
+    CacheHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.instr_size = sizeof(Instr);
+    header.instr_count = static_cast<uint32_t>(program.code.size());
+    header.register_count = static_cast<uint32_t>(program.registers.size());
+    header.message_count = static_cast<uint32_t>(program.messages.size());
+
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(program.code.data()),
+                  static_cast<std::streamsize>(program.code.size() * sizeof(Instr)));
+        write_strings(out, program.registers);
+        write_strings(out, program.messages);
+        if (!out.flush()) {
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "bytecode.hpp"
+
+// Precompiled program cache (.asmpc). A cache file holds one compiled,
+// label-resolved Program:
+//
+//   header   magic "ASPC", format version, key, counts
+//   code     instr_count raw Instr records
+//   strings  register names then trap messages, each a u32 length + bytes
+//
+// The key is a hash of the source text and the compile options, so a file
+// is only used when it was built from exactly the same input. Files are
+// mapped read-only and validated before use; anything stale, truncated or
+// from another format version is ignored and rebuilt.
+class ProgramCache {
+public:
+    // Bump whenever Instr, OpCode or the layout below changes.
+    static constexpr uint32_t VERSION = 4;
+
+    // With an empty directory the cache lives next to the source
+    // (foo.asmp -> foo.asmpc); otherwise files are named by key inside it.
+    explicit ProgramCache(std::string directory = "");
+
+    static uint64_t key(std::string_view source, bool optimized);
+    std::string path_for(const std::string& source_path, uint64_t key) const;
+
+    // Loads `path` if it is a valid cache file built for `key`.
+    bool load(const std::string& path, uint64_t key, Program& program) const;
+    // Loads `path` regardless of which source it was built from.
+    bool load(const std::string& path, Program& program) const;
+    // Writes atomically (temp file + rename); returns false on any I/O error.
+    bool store(const std::string& path, uint64_t key, const Program& program) const;
+
+private:
+    std::string directory;
+
+    bool read(const std::string& path, const uint64_t* key, Program& program) const;
+};
@@ -0,0 +1,262 @@
+#include "compiler.hpp"
+#include "optimizer.hpp"
+#include <stdexcept>
+
+#include "../common/vector.hpp"
+
+Program Compiler::compile(const std::vector<ASTNode*>& nodes, bool optimize) {
+    IRProgram program = build(nodes);
+    if (optimize) Optimizer().optimize(program);
+    return program.lower();
+}
+
+IRProgram Compiler::build(const std::vector<ASTNode*>& nodes) {
+    ir = IRProgram();
+    ir.blocks.emplace_back();
+    current = 0;
+    symbols = RegisterFile();
+    label_table.clear();
+    pending_jumps.clear();
+
+    for (const ASTNode* node : nodes)
+        compile_node(node);
+    ir.blocks[current].next = ir.exit();
+
+    for (const auto& [block, label] : pending_jumps) {
+        auto it = label_table.find(label.value);
+        if (it == label_table.end())
+            throw std::runtime_error("Undefined label '" + std::string(label.value) + "' at line " +
+                                     std::to_string(label.line) + ", column " +
+                                     std::to_string(label.column));
+        ir.blocks[block].target = it->second;
+    }
+    ir.registers = symbols.names;
+    return std::move(ir);
+}
+
+// Closes the current block, which falls through into the new one.
+void Compiler::start_block() {
+    ir.blocks[current].next = ir.blocks.size();
+    ir.blocks.emplace_back();
+    current = ir.blocks.size() - 1;
+}
+
+// Line and column of the token a statement is reported at.
+static SourceLoc statement_location(const ASTNode* node) {
+    auto at = [](const Token& token) { return SourceLoc{token.line, token.column}; };
+    switch (node->kind) {
+        case NodeKind::NUMBER: return at(static_cast<const NumberNode*>(node)->token);
+        case NodeKind::IDENTIFIER: return at(static_cast<const IdentifierNode*>(node)->token);
+        case NodeKind::ASSIGNMENT: return at(static_cast<const AssignmentNode*>(node)->var_token);
+        case NodeKind::BINOP: return at(static_cast<const BinOpNode*>(node)->op_token);
+        case NodeKind::JUMP: return at(static_cast<const JumpNode*>(node)->label);
+        case NodeKind::READ: return at(static_cast<const ReadNode*>(node)->var_token);
+        case NodeKind::VECTOR: return at(static_cast<const VectorNode*>(node)->op_token);
+        case NodeKind::MEMORY: return at(static_cast<const MemoryNode*>(node)->op_token);
+        case NodeKind::STACK: return at(static_cast<const StackNode*>(node)->op_token);
+        case NodeKind::PRINT: {
+            const ASTNode* expr = static_cast<const PrintNode*>(node)->expr;
+            return expr ? statement_location(expr) : SourceLoc();
+        }
+        case NodeKind::CMP: {
+            const ASTNode* left = static_cast<const CmpNode*>(node)->left;
+            return left ? statement_location(left) : SourceLoc();
+        }
+        default: return SourceLoc();
+    }
+}
+
+void Compiler::compile_node(const ASTNode* node) {
+    if (!node) return;
+    location = statement_location(node);
+
+    switch (node->kind) {
+        case NodeKind::LABEL: {
+            std::string_view label = static_cast<const LabelNode*>(node)->label;
+            if (!ir.blocks[current].body.empty()) start_block();
+            label_table[label] = current;
+            ir.blocks[current].labels.emplace_back(label);
+            break;
+        }
+        case NodeKind::ASSIGNMENT: {
+            auto* assign = static_cast<const AssignmentNode*>(node);
+            int32_t src = 0;
+            uint8_t mode = 0;
+            if (!compile_operand(assign->value, src, mode, B_IMM)) return;
+            emit(OpCode::LOAD, mode, register_slot(assign->var_token.value), src);
+            break;
+        }
+        case NodeKind::BINOP: {
+            auto* binop = static_cast<const BinOpNode*>(node);
+            int32_t dst = register_slot(binop->left->token.value);
+            int32_t src = 0;
+            uint8_t mode = 0;
+            if (!compile_operand(binop->right, src, mode, B_IMM)) return;
+
+            emit(instruction(binop->op_token.op).opcode, mode, dst, src);
+            break;
+        }
+        case NodeKind::CMP: {
+            auto* cmp = static_cast<const CmpNode*>(node);
+            int32_t lhs = 0, rhs = 0;
+            uint8_t mode = 0;
+            if (!compile_operand(cmp->left, lhs, mode, A_IMM)) return;
+            if (!compile_operand(cmp->right, rhs, mode, B_IMM)) return;
+            emit(OpCode::CMP, mode, lhs, rhs);
+            break;
+        }
+        case NodeKind::PRINT: {
+            auto* print = static_cast<const PrintNode*>(node);
+            int32_t src = 0;
+            uint8_t mode = 0;
+            if (!compile_operand(print->expr, src, mode, B_IMM)) return;
+            emit(OpCode::PRINT, mode, 0, src);
+            break;
+        }
+        case NodeKind::READ:
+            emit(OpCode::READ, 0, register_slot(static_cast<const ReadNode*>(node)->var_token.value));
+            break;
+        case NodeKind::JUMP: {
+            auto* jump = static_cast<const JumpNode*>(node);
+            OpCode op = OpCode::JMP;
+            switch (jump->op) {
+                case JumpKind::JMP: op = OpCode::JMP; break;
+                case JumpKind::JE:  op = OpCode::JE;  break;
+                case JumpKind::JNE: op = OpCode::JNE; break;
+                case JumpKind::JL:  op = OpCode::JL;  break;
+                case JumpKind::JG:  op = OpCode::JG;  break;
+                case JumpKind::JLE: op = OpCode::JLE; break;
+                case JumpKind::JGE: op = OpCode::JGE; break;
+            }
+            ir.blocks[current].branch = op;
+            ir.blocks[current].branch_location = location;
+            pending_jumps.emplace_back(current, jump->label);
+            start_block();
+            break;
+        }
+        case NodeKind::VECTOR: {
+            auto* vec = static_cast<const VectorNode*>(node);
+            OpCode op = instruction(vec->op_token.op).opcode;
+            int32_t src = 0;
+            uint8_t mode = 0;
+            switch (vec->op) {
+                case VectorOp::ADD: case VectorOp::SUB: case VectorOp::MUL: case VectorOp::CMP:
+                    emit(op, 0, vec->vector, vec->source);
+                    break;
+                case VectorOp::PRINT: emit(op, 0, 0, vec->source); break;
+                case VectorOp::BROADCAST:
+                    if (!compile_operand(vec->scalar, src, mode, B_IMM)) return;
+                    emit(op, mode, vec->vector, src);
+                    break;
+                case VectorOp::SET:
+                    if (!compile_operand(vec->scalar, src, mode, B_IMM)) return;
+                    emit(op, mode, vec->vector * static_cast<int32_t>(VECTOR_LANES) + vec->lane, src);
+                    break;
+                case VectorOp::SUM: case VectorOp::MIN: case VectorOp::MAX: {
+                    auto* dst = static_cast<const IdentifierNode*>(vec->scalar);
+                    emit(op, 0, register_slot(dst->token.value), vec->source);
+                    break;
+                }
+            }
+            break;
+        }
+        case NodeKind::MEMORY: {
+            auto* mem = static_cast<const MemoryNode*>(node);
+            OpCode op = instruction(mem->op_token.op).opcode;
+            int32_t a = 0, b = 0, c = 0;
+            uint8_t mode = 0;
+            switch (mem->op) {
+                case MemoryOp::LOAD: {
+                    auto* dst = static_cast<const IdentifierNode*>(mem->args[0]);
+                    if (!compile_operand(mem->base, b, mode, B_IMM)) return;
+                    emit(op, mode, register_slot(dst->token.value), b, mem->offset);
+                    break;
+                }
+                case MemoryOp::STORE:
+                    if (!compile_operand(mem->base, a, mode, A_IMM)) return;
+                    if (!compile_operand(mem->args[0], b, mode, B_IMM)) return;
+                    emit(op, mode, a, b, mem->offset);
+                    break;
+                case MemoryOp::COPY: case MemoryOp::FILL:
+                    if (!compile_operand(mem->args[0], a, mode, A_IMM)) return;
+                    if (!compile_operand(mem->args[1], b, mode, B_IMM)) return;
+                    if (!compile_operand(mem->args[2], c, mode, C_IMM)) return;
+                    emit(op, mode, a, b, c);
+                    break;
+            }
+            break;
+        }
+        case NodeKind::STACK: {
+            auto* stack = static_cast<const StackNode*>(node);
+            switch (stack->op) {
+                case StackOp::CALL:
+                    ir.blocks[current].branch = OpCode::CALL;
+                    ir.blocks[current].branch_location = location;
+                    pending_jumps.emplace_back(current, stack->label);
+                    start_block();
+                    break;
+                case StackOp::RET:
+                    ir.blocks[current].branch = OpCode::RET;
+                    ir.blocks[current].branch_location = location;
+                    start_block();
+                    break;
+                case StackOp::PUSH: {
+                    int32_t src = 0;
+                    uint8_t mode = 0;
+                    if (!compile_operand(stack->operand, src, mode, B_IMM)) return;
+                    emit(OpCode::PUSH, mode, 0, src);
+                    break;
+                }
+                case StackOp::POP: {
+                    auto* dst = static_cast<const IdentifierNode*>(stack->operand);
+                    emit(OpCode::POP, 0, register_slot(dst->token.value));
+                    break;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Lowers a leaf expression into an operand. Returns false (after emitting
+// a trap) when the expression cannot be evaluated at runtime.
+bool Compiler::compile_operand(const ASTNode* node, int32_t& operand, uint8_t& mode, uint8_t imm_bit) {
+    if (!node) {
+        emit_trap("Null AST node in eval_node");
+        return false;
+    }
+    if (node->kind == NodeKind::NUMBER) {
+        // Out of range fails where the tree interpreter fails: when it runs.
+        auto* number = static_cast<const NumberNode*>(node);
+        if (!number->fits(operand)) {
+            emit_trap("Integer literal out of range: " + std::string(number->token.value));
+            return false;
+        }
+        mode |= imm_bit;
+        return true;
+    }
+    if (node->kind == NodeKind::IDENTIFIER) {
+        operand = register_slot(static_cast<const IdentifierNode*>(node)->token.value);
+        return true;
+    }
+    emit_trap(std::string("Unsupported AST node in eval_node: ") + node_kind_name(node->kind));
+    return false;
+}
+
+int32_t Compiler::register_slot(std::string_view name) {
+    return static_cast<int32_t>(symbols.resolve(name));
+}
+
+void Compiler::emit(OpCode op, uint8_t mode, int32_t a, int32_t b, int32_t c) {
+    ir.blocks[current].body.push_back(Instr{op, mode, a, b, c});
+    ir.blocks[current].locations.push_back(location);
+}
+
+void Compiler::emit_trap(const std::string& message) {
+    emit(OpCode::TRAP, 0, static_cast<int32_t>(ir.messages.size()));
+    ir.messages.push_back(message);
+    ir.blocks[current].branch = OpCode::TRAP;
+    start_block();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../common/nodes.hpp"
+#include "bytecode.hpp"
+#include "ir.hpp"
+#include "values.hpp"
+
+class Compiler {
+public:
+    // AST -> IR -> (optimized) IR -> bytecode.
+    Program compile(const std::vector<ASTNode*>& nodes, bool optimize = true);
+    IRProgram build(const std::vector<ASTNode*>& nodes);
+
+private:
+    IRProgram ir;
+    size_t current = 0;
+    SourceLoc location; // of the statement being compiled
+    RegisterFile symbols;
+    std::unordered_map<std::string_view, size_t> label_table;
+    std::vector<std::pair<size_t, Token>> pending_jumps;
+
+    void compile_node(const ASTNode* node);
+    void start_block();
+    bool compile_operand(const ASTNode* node, int32_t& operand, uint8_t& mode, uint8_t imm_bit);
+    int32_t register_slot(std::string_view name);
+    void emit(OpCode op, uint8_t mode = 0, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+    void emit_trap(const std::string& message);
+};
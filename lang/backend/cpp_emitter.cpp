@@ -0,0 +1,478 @@
+#include "cpp_emitter.hpp"
+#include <climits>
+#include <stdexcept>
+
+#include "../common/vector.hpp"
+#include "memory.hpp"
+#include "values.hpp"
+
+namespace {
+
+// Runtime pieces of the generated program. They mirror OutputBuffer,
+// InputBuffer, the vector kernels and Memory closely enough that output,
+// error messages and exit codes match the VM.
+const char* const PRELUDE_OUTPUT = R"cpp(
+char out_buffer[1 << 16];
+size_t out_size = 0;
+bool line_buffered = false;
+
+void flush() {
+    size_t done = 0;
+    while (done < out_size) {
+        ssize_t n = ::write(1, out_buffer + done, out_size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += static_cast<size_t>(n);
+    }
+    out_size = 0;
+}
+
+void write_text(const char* text, size_t length) {
+    if (sizeof(out_buffer) - out_size < length) {
+        flush();
+        if (length > sizeof(out_buffer)) {
+            for (size_t done = 0; done < length; ) {
+                ssize_t n = ::write(1, text + done, length - done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return;
+                done += static_cast<size_t>(n);
+            }
+            return;
+        }
+    }
+    std::memcpy(out_buffer + out_size, text, length);
+    out_size += length;
+    if (line_buffered && length && text[length - 1] == '\n') flush();
+}
+
+[[maybe_unused]] void print_int(int value) {
+    char text[16];
+    char* end = std::to_chars(text, text + sizeof(text) - 1, value).ptr;
+    *end++ = '\n';
+    write_text(text, static_cast<size_t>(end - text));
+}
+
+[[noreturn, maybe_unused]] void fail(const std::string& message) {
+    flush();
+    std::fprintf(stderr, "Error: %s\n", message.c_str());
+    std::exit(1);
+}
+
+inline int wrap_add(int lhs, int rhs) { return static_cast<int>(static_cast<uint32_t>(lhs) + static_cast<uint32_t>(rhs)); }
+inline int wrap_sub(int lhs, int rhs) { return static_cast<int>(static_cast<uint32_t>(lhs) - static_cast<uint32_t>(rhs)); }
+inline int wrap_mul(int lhs, int rhs) { return static_cast<int>(static_cast<uint32_t>(lhs) * static_cast<uint32_t>(rhs)); }
+inline int divide(int lhs, int rhs) {
+    if (rhs == -1) return wrap_sub(0, lhs); // INT_MIN / -1 wraps instead of trapping
+    return rhs != 0 ? lhs / rhs : 0;
+}
+)cpp";
+
+const char* const PRELUDE_UNDEFINED = R"cpp(
+[[noreturn]] int undefined(int slot) {
+    fail(std::string("Unknown register: ") + register_names[slot]);
+}
+)cpp";
+
+const char* const PRELUDE_INPUT = R"cpp(
+char in_buffer[1 << 16];
+size_t in_pos = 0, in_size = 0;
+bool in_eof = false;
+
+bool fill() {
+    if (in_eof) return false;
+    flush();
+    if (in_pos > 0) {
+        std::memmove(in_buffer, in_buffer + in_pos, in_size - in_pos);
+        in_size -= in_pos;
+        in_pos = 0;
+    }
+    ssize_t n;
+    do {
+        n = ::read(0, in_buffer + in_size, sizeof(in_buffer) - in_size);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        in_eof = true;
+        return false;
+    }
+    in_size += static_cast<size_t>(n);
+    return true;
+}
+
+bool digit(char c) { return c >= '0' && c <= '9'; }
+
+int read_int() {
+    size_t end = 0;
+    for (;;) {
+        while (in_pos < in_size && !digit(in_buffer[in_pos]) && in_buffer[in_pos] != '-')
+            ++in_pos;
+        if (in_pos == in_size) {
+            if (!fill()) return 0;
+            continue;
+        }
+        end = in_pos + (in_buffer[in_pos] == '-' ? 1 : 0);
+        while (end < in_size && digit(in_buffer[end]))
+            ++end;
+        if (end == in_size && !in_eof && !(in_pos == 0 && in_size == sizeof(in_buffer))) {
+            fill();
+            continue;
+        }
+        if (in_buffer[in_pos] == '-' && end == in_pos + 1) {
+            ++in_pos;
+            continue;
+        }
+        break;
+    }
+    bool negative = in_buffer[in_pos] == '-';
+    unsigned magnitude = 0;
+    for (size_t i = in_pos + (negative ? 1 : 0); i < end; ++i)
+        magnitude = magnitude * 10u + static_cast<unsigned>(in_buffer[i] - '0');
+    in_pos = end;
+    return static_cast<int>(negative ? 0u - magnitude : magnitude);
+}
+)cpp";
+
+const char* const PRELUDE_VECTORS = R"cpp(
+struct Vector { int32_t lanes[LANES]; };
+Vector vectors[VECTORS] = {};
+
+inline void vadd(Vector& d, const Vector& s) { for (int i = 0; i < LANES; ++i) d.lanes[i] = wrap_add(d.lanes[i], s.lanes[i]); }
+inline void vsub(Vector& d, const Vector& s) { for (int i = 0; i < LANES; ++i) d.lanes[i] = wrap_sub(d.lanes[i], s.lanes[i]); }
+inline void vmul(Vector& d, const Vector& s) { for (int i = 0; i < LANES; ++i) d.lanes[i] = wrap_mul(d.lanes[i], s.lanes[i]); }
+inline void vbroadcast(Vector& d, int x) { for (int i = 0; i < LANES; ++i) d.lanes[i] = x; }
+
+inline int vsum(const Vector& v) {
+    int total = 0;
+    for (int i = 0; i < LANES; ++i) total = wrap_add(total, v.lanes[i]);
+    return total;
+}
+
+inline int vmin(const Vector& v) {
+    int result = v.lanes[0];
+    for (int i = 1; i < LANES; ++i) if (v.lanes[i] < result) result = v.lanes[i];
+    return result;
+}
+
+inline int vmax(const Vector& v) {
+    int result = v.lanes[0];
+    for (int i = 1; i < LANES; ++i) if (v.lanes[i] > result) result = v.lanes[i];
+    return result;
+}
+
+inline int vcompare(const Vector& a, const Vector& b) {
+    for (int i = 0; i < LANES; ++i)
+        if (a.lanes[i] != b.lanes[i]) return a.lanes[i] < b.lanes[i] ? -1 : 1;
+    return 0;
+}
+
+void vprint(const Vector& v) {
+    std::string text = "[";
+    for (int i = 0; i < LANES; ++i) {
+        if (i) text += ", ";
+        text += std::to_string(v.lanes[i]);
+    }
+    text += "]\n";
+    write_text(text.data(), text.size());
+}
+)cpp";
+
+const char* const PRELUDE_MEMORY = R"cpp(
+int32_t* memory = nullptr;
+int64_t memory_words = 0;
+
+int32_t* at(int64_t address, int64_t length) {
+    if (address < 0 || length < 0 || address + length > memory_words) {
+        std::string what = length == 1 ? "address " + std::to_string(address)
+                                        : std::to_string(length) + " words at " + std::to_string(address);
+        fail("Memory access out of bounds: " + what + " (memory has " + std::to_string(memory_words) + " words)");
+    }
+    return memory + address;
+}
+
+// Same layout as the VM: an anonymous mapping, with a data file mapped
+// copy-on-write over its start.
+void setup_memory(size_t words, const char* data) {
+    size_t bytes = 0;
+    int fd = -1;
+    if (data) {
+        fd = ::open(data, O_RDONLY);
+        if (fd < 0) fail(std::string("Could not open data file ") + data);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) fail(std::string("Could not stat data file ") + data);
+        bytes = static_cast<size_t>(st.st_size);
+        size_t file_words = (bytes + sizeof(int32_t) - 1) / sizeof(int32_t);
+        if (file_words > words) words = file_words;
+    }
+    if (words) {
+        void* p = ::mmap(nullptr, words * sizeof(int32_t), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) fail("Could not allocate " + std::to_string(words) + " words of memory");
+        memory = static_cast<int32_t*>(p);
+        memory_words = static_cast<int64_t>(words);
+    }
+    if (bytes > 0 && ::mmap(memory, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+        fail(std::string("Could not map data file ") + data);
+    if (fd >= 0) ::close(fd);
+}
+)cpp";
+
+const char* const PRELUDE_STACKS = R"cpp(
+[[maybe_unused]] size_t call_stack[CALL_STACK_DEPTH];
+[[maybe_unused]] size_t call_depth = 0;
+[[maybe_unused]] int value_stack[VALUE_STACK_DEPTH];
+[[maybe_unused]] size_t value_depth = 0;
+)cpp";
+
+std::string quoted(const std::string& text) {
+    std::string result = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += static_cast<char>(c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            // Octal escapes cannot swallow the characters that follow.
+            result += '\\';
+            result += static_cast<char>('0' + (c >> 6));
+            result += static_cast<char>('0' + ((c >> 3) & 7));
+            result += static_cast<char>('0' + (c & 7));
+        } else {
+            result += static_cast<char>(c);
+        }
+    }
+    return result + "\"";
+}
+
+bool uses(const Program& program, OpCode first, OpCode last) {
+    for (const Instr& in : program.code)
+        if (in.op >= first && in.op <= last) return true;
+    return false;
+}
+
+} // namespace
+
+void CppEmitter::scan() {
+    const auto& code = program->code;
+    jump_targets.assign(code.size() + 1, false);
+    return_points.clear();
+    checked_registers.assign(program->registers.size(), false);
+    auto reads = [&](int32_t operand, bool immediate) {
+        if (!immediate) checked_registers[operand] = true;
+    };
+    for (size_t i = 0; i < code.size(); ++i) {
+        const Instr& in = code[i];
+        switch (in.op) {
+            case OpCode::JMP: case OpCode::JE: case OpCode::JNE: case OpCode::JL:
+            case OpCode::JG: case OpCode::JLE: case OpCode::JGE:
+                jump_targets[in.a] = true;
+                break;
+            case OpCode::CALL:
+                jump_targets[in.a] = true;
+                return_points.push_back(i + 1);
+                break;
+            case OpCode::LOAD: case OpCode::ADD: case OpCode::SUB: case OpCode::MUL:
+            case OpCode::DIV: case OpCode::PRINT: case OpCode::PUSH: case OpCode::VBROADCAST:
+            case OpCode::VSET: case OpCode::MEM_LOAD:
+                reads(in.b, in.mode & B_IMM);
+                break;
+            case OpCode::CMP: case OpCode::MEM_STORE:
+                reads(in.a, in.mode & A_IMM);
+                reads(in.b, in.mode & B_IMM);
+                break;
+            case OpCode::MEM_COPY: case OpCode::MEM_FILL:
+                reads(in.a, in.mode & A_IMM);
+                reads(in.b, in.mode & B_IMM);
+                reads(in.c, in.mode & C_IMM);
+                break;
+            case OpCode::NOP: case OpCode::READ: case OpCode::TRAP: case OpCode::VADD:
+            case OpCode::VSUB: case OpCode::VMUL: case OpCode::VSUM: case OpCode::VMIN:
+            case OpCode::VMAX: case OpCode::VCMP: case OpCode::VPRINT: case OpCode::RET:
+            case OpCode::POP:
+                break;
+            default:
+                throw std::runtime_error(std::string("Cannot translate ") + opcode_name(in.op) +
+                                         " to C++ (emit before the peephole pass)");
+        }
+    }
+    // Return points are only labelled when a ret can reach them.
+    if (!uses(*program, OpCode::RET, OpCode::RET)) return_points.clear();
+    for (size_t point : return_points)
+        jump_targets[point] = true;
+}
+
+std::string CppEmitter::operand(int32_t value, bool immediate) const {
+    if (immediate)
+        return value == INT_MIN ? "(-2147483647 - 1)" : std::to_string(value);
+    std::string r = "r" + std::to_string(value);
+    if (!checked_registers[value]) return r;
+    return "(d" + std::to_string(value) + " ? " + r + " : undefined(" + std::to_string(value) + "))";
+}
+
+std::string CppEmitter::write_register(int32_t slot, const std::string& value) const {
+    std::string r = std::to_string(slot);
+    std::string text = "r" + r + " = " + value + ";";
+    if (checked_registers[slot]) text += " d" + r + " = true;";
+    return text;
+}
+
+void CppEmitter::emit_instruction(const Instr& in, size_t index, std::ostream& out) const {
+    auto a = [&] { return operand(in.a, in.mode & A_IMM); };
+    auto b = [&] { return operand(in.b, in.mode & B_IMM); };
+    auto c = [&] { return operand(in.c, in.mode & C_IMM); };
+    auto r = [](int32_t slot) { return "r" + std::to_string(slot); };
+    auto v = [](int32_t index) { return "vectors[" + std::to_string(index) + "]"; };
+    auto jump = [&](const char* condition) {
+        std::string target = "goto L" + std::to_string(in.a) + ";";
+        out << (condition ? std::string("if (") + condition + ") " + target : target) << "\n";
+    };
+    auto check = [&](const char* condition, StackError error) {
+        out << "if (" << condition << ") fail(" << quoted(stack_error_message(error)) << ");\n    ";
+    };
+    auto binary = [&](const char* helper) {
+        out << write_register(in.a, std::string(helper) + "(" + r(in.a) + ", " + b() + ")") << "\n";
+    };
+
+    switch (in.op) {
+        case OpCode::NOP: out << ";\n"; break;
+        case OpCode::LOAD: out << write_register(in.a, b()) << "\n"; break;
+        case OpCode::ADD: binary("wrap_add"); break;
+        case OpCode::SUB: binary("wrap_sub"); break;
+        case OpCode::MUL: binary("wrap_mul"); break;
+        case OpCode::DIV: binary("divide"); break;
+        case OpCode::CMP:
+            out << "{ int lhs = " << a() << ", rhs = " << b()
+                << "; eq = lhs == rhs; lt = lhs < rhs; gt = lhs > rhs; }\n";
+            break;
+        case OpCode::JMP: jump(nullptr); break;
+        case OpCode::JE: jump("eq"); break;
+        case OpCode::JNE: jump("!eq"); break;
+        case OpCode::JL: jump("lt"); break;
+        case OpCode::JG: jump("gt"); break;
+        case OpCode::JLE: jump("lt || eq"); break;
+        case OpCode::JGE: jump("gt || eq"); break;
+        case OpCode::PRINT: out << "print_int(" << b() << ");\n"; break;
+        case OpCode::READ: out << write_register(in.a, "read_int()") << "\n"; break;
+        case OpCode::TRAP: out << "fail(" << quoted(program->messages[in.a]) << ");\n"; break;
+        case OpCode::VADD: out << "vadd(" << v(in.a) << ", " << v(in.b) << ");\n"; break;
+        case OpCode::VSUB: out << "vsub(" << v(in.a) << ", " << v(in.b) << ");\n"; break;
+        case OpCode::VMUL: out << "vmul(" << v(in.a) << ", " << v(in.b) << ");\n"; break;
+        case OpCode::VBROADCAST: out << "vbroadcast(" << v(in.a) << ", " << b() << ");\n"; break;
+        case OpCode::VSET:
+            out << v(in.a / static_cast<int32_t>(VECTOR_LANES)) << ".lanes["
+                << in.a % static_cast<int32_t>(VECTOR_LANES) << "] = " << b() << ";\n";
+            break;
+        case OpCode::VSUM: out << write_register(in.a, "vsum(" + v(in.b) + ")") << "\n"; break;
+        case OpCode::VMIN: out << write_register(in.a, "vmin(" + v(in.b) + ")") << "\n"; break;
+        case OpCode::VMAX: out << write_register(in.a, "vmax(" + v(in.b) + ")") << "\n"; break;
+        case OpCode::VCMP:
+            out << "{ int order = vcompare(" << v(in.a) << ", " << v(in.b)
+                << "); eq = order == 0; lt = order < 0; gt = order > 0; }\n";
+            break;
+        case OpCode::VPRINT: out << "vprint(" << v(in.b) << ");\n"; break;
+        case OpCode::MEM_LOAD:
+            out << write_register(in.a, "*at(int64_t(" + b() + ") + " + std::to_string(in.c) + ", 1)") << "\n";
+            break;
+        case OpCode::MEM_STORE:
+            out << "{ int32_t* word = at(int64_t(" << a() << ") + " << in.c << ", 1); *word = " << b() << "; }\n";
+            break;
+        case OpCode::MEM_COPY:
+            out << "{ int dst = " << a() << ", src = " << b() << ", count = " << c()
+                << "; int32_t* to = at(dst, count); const int32_t* from = at(src, count);"
+                << " std::memmove(to, from, size_t(count) * sizeof(int32_t)); }\n";
+            break;
+        case OpCode::MEM_FILL:
+            out << "{ int dst = " << a() << ", value = " << b() << ", count = " << c()
+                << "; std::fill_n(at(dst, count), count, value); }\n";
+            break;
+        case OpCode::CALL:
+            check("call_depth == CALL_STACK_DEPTH", StackError::CALL_OVERFLOW);
+            out << "call_stack[call_depth++] = " << index + 1 << "; goto L" << in.a << ";\n";
+            break;
+        case OpCode::RET:
+            check("call_depth == 0", StackError::CALL_UNDERFLOW);
+            out << "goto return_point;\n";
+            break;
+        case OpCode::PUSH:
+            check("value_depth == VALUE_STACK_DEPTH", StackError::PUSH_OVERFLOW);
+            out << "value_stack[value_depth++] = " << b() << ";\n";
+            break;
+        case OpCode::POP:
+            check("value_depth == 0", StackError::POP_UNDERFLOW);
+            out << write_register(in.a, "value_stack[--value_depth]") << "\n";
+            break;
+        default:
+            break; // rejected by scan()
+    }
+}
+
+void CppEmitter::emit(const Program& prog, std::ostream& out, const std::string& source_name) {
+    program = &prog;
+    scan();
+    const auto& code = prog.code;
+    const size_t registers = prog.registers.size();
+    bool checked = false;
+    for (size_t i = 0; i < registers; ++i) checked = checked || checked_registers[i];
+    const bool input = uses(prog, OpCode::READ, OpCode::READ);
+    const bool vectors = uses(prog, OpCode::VADD, OpCode::VPRINT);
+    const bool memory = uses(prog, OpCode::MEM_LOAD, OpCode::MEM_FILL);
+    const bool stacks = uses(prog, OpCode::CALL, OpCode::POP);
+
+    out << "// Generated by asmple --emit-cpp" << (source_name.empty() ? "" : " from " + source_name)
+        << ". Do not edit.\n";
+    out << "#include <algorithm>\n#include <cerrno>\n#include <charconv>\n#include <cstdint>\n"
+           "#include <cstdio>\n#include <cstdlib>\n#include <cstring>\n#include <string>\n";
+    if (memory) out << "#include <fcntl.h>\n#include <sys/mman.h>\n#include <sys/stat.h>\n";
+    out << "#include <unistd.h>\n\nnamespace {\n";
+    out << PRELUDE_OUTPUT;
+    if (checked) {
+        out << "\nconst char* const register_names[] = {";
+        for (size_t i = 0; i < registers; ++i)
+            out << (i ? ", " : "") << quoted(prog.registers[i]);
+        out << "};\n" << PRELUDE_UNDEFINED;
+    }
+    if (input) out << PRELUDE_INPUT;
+    if (vectors) {
+        out << "\nconstexpr int LANES = " << VECTOR_LANES << ";\nconstexpr int VECTORS = "
+            << VECTOR_REGISTERS << ";\n" << PRELUDE_VECTORS;
+    }
+    if (memory) out << PRELUDE_MEMORY;
+    if (stacks) {
+        out << "\nconstexpr size_t CALL_STACK_DEPTH = " << CALL_STACK_DEPTH
+            << ";\nconstexpr size_t VALUE_STACK_DEPTH = " << VALUE_STACK_DEPTH << ";\n" << PRELUDE_STACKS;
+    }
+
+    out << "\nvoid run() {\n";
+    for (size_t i = 0; i < registers; ++i) {
+        out << "    [[maybe_unused]] int r" << i << " = 0;";
+        if (checked_registers[i]) out << " [[maybe_unused]] bool d" << i << " = false;";
+        out << " // " << prog.registers[i] << "\n";
+    }
+    out << "    bool eq = false, lt = false, gt = false;\n";
+    out << "    (void)eq; (void)lt; (void)gt;\n";
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (jump_targets[i]) out << "L" << i << ":\n";
+        out << "    ";
+        emit_instruction(code[i], i, out);
+    }
+    if (jump_targets[code.size()]) out << "L" << code.size() << ":\n";
+    out << "    return;\n";
+    if (uses(prog, OpCode::RET, OpCode::RET)) {
+        out << "return_point:\n    switch (call_stack[--call_depth]) {\n";
+        for (size_t point : return_points)
+            out << "        case " << point << ": goto L" << point << ";\n";
+        out << "        default: return;\n    }\n";
+    }
+    out << "}\n\n} // namespace\n\n";
+
+    out << "int main(int argc, char** argv) {\n    line_buffered = isatty(1);\n";
+    if (memory) {
+        out << "    size_t words = " << Memory::DEFAULT_WORDS << ";\n    const char* data = nullptr;\n"
+               "    for (int i = 1; i < argc; ++i) {\n"
+               "        if (std::strncmp(argv[i], \"--memory=\", 9) == 0) words = std::strtoul(argv[i] + 9, nullptr, 10);\n"
+               "        else if (std::strncmp(argv[i], \"--data=\", 7) == 0) data = argv[i] + 7;\n"
+               "    }\n"
+               "    setup_memory(words, data);\n";
+    } else {
+        out << "    (void)argc; (void)argv;\n";
+    }
+    out << "    run();\n    flush();\n    return 0;\n}\n";
+    program = nullptr;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+
+// Ahead-of-time backend: writes a compiled program as one self-contained
+// C++ translation unit for the system compiler. Registers become local ints,
+// jump targets become goto labels and the flags become local bools, so the
+// C++ compiler turns cmp and a conditional jump into one native compare and
+// branch. ret dispatches on the saved return address with a switch over
+// every return point. The generated program behaves like
+// the VM run from the command line: same output (line-buffered on a
+// terminal), same "Error: ..." message and exit status 1 on a runtime error,
+// and the same --data=FILE / --memory=WORDS options when it uses memory.
+//
+// emit() throws std::runtime_error for superinstructions; translate the
+// program before the peephole pass.
+class CppEmitter {
+public:
+    void emit(const Program& program, std::ostream& out, const std::string& source_name = "");
+
+private:
+    const Program* program = nullptr;
+    std::vector<bool> jump_targets;
+    std::vector<size_t> return_points; // the instruction after each call
+    std::vector<bool> checked_registers; // read as operands, so track definedness
+
+    void scan();
+    std::string operand(int32_t value, bool immediate) const;
+    std::string write_register(int32_t slot, const std::string& value) const;
+    void emit_instruction(const Instr& in, size_t index, std::ostream& out) const;
+};
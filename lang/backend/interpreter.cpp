@@ -1,101 +1,245 @@
 #include "interpreter.hpp"
+#include "simd.hpp"
+#include "../common/probes.hpp"
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
-Interpreter::Interpreter() {}
+template <typename Arith>
+BasicInterpreter<Arith>::BasicInterpreter(BufferMode mode, int out_fd, int in_fd)
+    : output(out_fd, mode), input(in_fd, &output) {}
 
-void Interpreter::interpret(const std::vector<std::unique_ptr<ASTNode>>& nodes) {
+template <typename Arith>
+void BasicInterpreter<Arith>::interpret(const std::vector<ASTNode*>& nodes) {
     label_table.clear();
     for (size_t i = 0; i < nodes.size(); ++i) {
-        if (nodes[i]->type_name() == "LabelNode") {
-            auto* label = static_cast<const LabelNode*>(nodes[i].get());
+        if (nodes[i]->kind == NodeKind::LABEL) {
+            auto* label = static_cast<const LabelNode*>(nodes[i]);
             label_table[label->label] = i;
         }
+        resolve_registers(nodes[i]);
     }
+    auto resolve_label = [&](const Token& label) {
+        auto it = label_table.find(label.value);
+        if (it == label_table.end())
+            throw std::runtime_error("Undefined label '" + std::string(label.value) + "' at line " +
+                                     std::to_string(label.line) + ", column " +
+                                     std::to_string(label.column));
+        return it->second + 1;
+    };
+    for (ASTNode* node : nodes) {
+        if (node->kind == NodeKind::JUMP) {
+            auto* jump = static_cast<JumpNode*>(node);
+            jump->target = resolve_label(jump->label);
+        } else if (node->kind == NodeKind::STACK) {
+            auto* call = static_cast<StackNode*>(node);
+            if (call->op == StackOp::CALL) call->target = resolve_label(call->label);
+        }
+    }
+    execute(NodeList{nodes});
+}
+
+template <typename Arith>
+void BasicInterpreter<Arith>::rerun(const IncrementalProgram& program) {
+    registers.clear();
+    try {
+        execute(program);
+    } catch (const std::runtime_error&) {
+        output.flush();
+        throw;
+    }
+}
 
-    for (size_t ip = 0; ip < nodes.size(); ) {
-        const ASTNode* node = nodes[ip].get();
-        if (node->type_name() == "JumpNode") {
-             auto* jump = static_cast<const JumpNode*>(node);
-            if (should_jump(jump->op) && label_table.count(jump->label)) {
-                ip = label_table[jump->label] + 1;
+// `code` walks the nodes: start() is the first position, at() the node there
+// (nullptr past the end), next() the position after it and target() where a
+// jump or call continues.
+template <typename Arith>
+template <typename Code>
+void BasicInterpreter<Arith>::execute(const Code& code) {
+    vectors = VectorFile();
+    stacks.clear();
+    flags = Flags();
+    executed = 0;
+    size_t ip = code.start();
+    for (const ASTNode* node; (node = code.at(ip)); ++executed) {
+        ASMPLE_PROBE2(dispatch, ip, static_cast<int>(node->kind));
+        if (counts) ++counts->instructions;
+        if (node->kind == NodeKind::JUMP) {
+            auto* jump = static_cast<const JumpNode*>(node);
+            if (should_jump(jump->op)) {
+                ip = code.target(jump->target);
+                if (counts) ++counts->jumps_taken;
             } else {
-                ++ip;
+                ip = code.next(ip);
+                if (counts) ++counts->jumps_not_taken;
             }
+        } else if (node->kind == NodeKind::STACK) {
+            ip = exec_stack(code, static_cast<const StackNode*>(node), ip);
         } else {
-            exec_node(node, ip, nodes);
-            ++ip;
+            exec_node(node);
+            ip = code.next(ip);
+        }
+    }
+    output.flush();
+}
+
+template <typename Arith>
+typename BasicInterpreter<Arith>::Int BasicInterpreter<Arith>::read_register(size_t slot) const {
+    if (counts) ++counts->register_reads;
+    return registers.read(slot);
+}
+
+template <typename Arith>
+void BasicInterpreter<Arith>::write_register(size_t slot, Int value) {
+    if (counts) ++counts->register_writes;
+    registers.write(slot, value);
+}
+
+template <typename Arith>
+void BasicInterpreter<Arith>::resolve_registers(ASTNode* node) {
+    if (!node) return;
+    switch (node->kind) {
+        case NodeKind::IDENTIFIER: {
+            auto* ident = static_cast<IdentifierNode*>(node);
+            ident->slot = registers.resolve(ident->token.value);
+            break;
+        }
+        case NodeKind::ASSIGNMENT: {
+            auto* assign = static_cast<AssignmentNode*>(node);
+            assign->slot = registers.resolve(assign->var_token.value);
+            resolve_registers(assign->value);
+            break;
+        }
+        case NodeKind::BINOP: {
+            auto* binop = static_cast<BinOpNode*>(node);
+            resolve_registers(binop->left);
+            resolve_registers(binop->right);
+            break;
         }
+        case NodeKind::CMP: {
+            auto* cmp = static_cast<CmpNode*>(node);
+            resolve_registers(cmp->left);
+            resolve_registers(cmp->right);
+            break;
+        }
+        case NodeKind::PRINT:
+            resolve_registers(static_cast<PrintNode*>(node)->expr);
+            break;
+        case NodeKind::READ: {
+            auto* read = static_cast<ReadNode*>(node);
+            read->slot = registers.resolve(read->var_token.value);
+            break;
+        }
+        case NodeKind::VECTOR:
+            resolve_registers(static_cast<VectorNode*>(node)->scalar);
+            break;
+        case NodeKind::MEMORY: {
+            auto* mem = static_cast<MemoryNode*>(node);
+            resolve_registers(mem->base);
+            for (ASTNode* arg : mem->args)
+                resolve_registers(arg);
+            break;
+        }
+        case NodeKind::STACK:
+            resolve_registers(static_cast<StackNode*>(node)->operand);
+            break;
+        default:
+            break;
     }
 }
 
-void Interpreter::exec_node(const ASTNode* node, size_t& ip, const std::vector<std::unique_ptr<ASTNode>>& nodes) {
+template <typename Arith>
+void BasicInterpreter<Arith>::exec_node(const ASTNode* node) {
     if (!node) return;
 
-    if (node->type_name() == "PrintNode") {
-        auto* print = static_cast<const PrintNode*>(node);
-        int value = eval_node(print->expr.get());
-        std::cout << value << std::endl;
+    switch (node->kind) {
+        case NodeKind::PRINT: {
+            auto* print = static_cast<const PrintNode*>(node);
+            output.print_int(eval_node(print->expr));
+            break;
+        }
+        case NodeKind::READ: {
+            Int value = 0;
+            input.read_int(value);
+            write_register(static_cast<const ReadNode*>(node)->slot, value);
+            break;
+        }
+        case NodeKind::ASSIGNMENT:
+            exec_assignment(static_cast<const AssignmentNode*>(node));
+            break;
+        case NodeKind::BINOP:
+            exec_binop(static_cast<const BinOpNode*>(node));
+            break;
+        case NodeKind::CMP:
+            exec_cmp(static_cast<const CmpNode*>(node));
+            break;
+        case NodeKind::VECTOR:
+            exec_vector(static_cast<const VectorNode*>(node));
+            break;
+        case NodeKind::MEMORY:
+            exec_memory(static_cast<const MemoryNode*>(node));
+            break;
+        default:
+            break;
     }
-    if (node->type_name() == "AssignmentNode")
-        exec_assignment(static_cast<const AssignmentNode*>(node));
-    else if (node->type_name() == "BinOpNode")
-        exec_binop(static_cast<const BinOpNode*>(node));
-    else if (node->type_name() == "CmpNode")
-        exec_cmp(static_cast<const CmpNode*>(node));
 }
 
-int Interpreter::eval_node(const ASTNode* node) const {
+template <typename Arith>
+typename BasicInterpreter<Arith>::Int BasicInterpreter<Arith>::eval_node(const ASTNode* node) const {
     if (!node) throw std::runtime_error("Null AST node in eval_node");
 
-    if (node->type_name() == "NumberNode") {
-        return std::stoi(static_cast<const NumberNode*>(node)->token.value);
-    }
-    if (node->type_name() == "IdentifierNode") {
-        std::string reg = static_cast<const IdentifierNode*>(node)->token.value;
-        if (registers.count(reg))
-            return static_cast<IntValue*>(registers.at(reg).get())->value;
-        throw std::runtime_error("Unknown register: " + reg);
-    }
-    if (node->type_name() == "BinOpNode") {
-        auto* binop = static_cast<const BinOpNode*>(node);
-        int lhs = eval_node(binop->left.get());
-        int rhs = eval_node(binop->right.get());
-        std::string op = binop->op_token.value;
-        if (op == "add") return lhs + rhs;
-        else if (op == "sub") return lhs - rhs;
-        else if (op == "mul") return lhs * rhs;
-        else if (op == "div") return (rhs != 0) ? (lhs / rhs) : 0;
-        else throw std::runtime_error("Unknown binop: " + op);
+    switch (node->kind) {
+        case NodeKind::NUMBER:
+            return static_cast<const NumberNode*>(node)->value<Int>();
+        case NodeKind::IDENTIFIER:
+            return read_register(static_cast<const IdentifierNode*>(node)->slot);
+        case NodeKind::BINOP: {
+            auto* binop = static_cast<const BinOpNode*>(node);
+            Int lhs = eval_node(binop->left);
+            Int rhs = eval_node(binop->right);
+            switch (binop->op_token.op) {
+                case Mnemonic::ADD: return Arith::add(lhs, rhs);
+                case Mnemonic::SUB: return Arith::sub(lhs, rhs);
+                case Mnemonic::MUL: return Arith::mul(lhs, rhs);
+                case Mnemonic::DIV: return Arith::div(lhs, rhs);
+                default: throw std::runtime_error("Unknown binop: " + std::string(binop->op_token.value));
+            }
+        }
+        default:
+            break;
     }
-    throw std::runtime_error("Unsupported AST node in eval_node: " + node->type_name());
+    throw std::runtime_error(std::string("Unsupported AST node in eval_node: ") + node_kind_name(node->kind));
 }
 
-void Interpreter::exec_assignment(const AssignmentNode* node) {
-    int val = eval_node(node->value.get());
-    registers[node->var_token.value] = std::make_shared<IntValue>(val);
+template <typename Arith>
+void BasicInterpreter<Arith>::exec_assignment(const AssignmentNode* node) {
+    Int val = eval_node(node->value);
+    write_register(node->slot, val);
 }
 
-void Interpreter::exec_binop(const BinOpNode* node) {
-    std::string reg = static_cast<const IdentifierNode*>(node->left.get())->token.value;
-    int lhs = 0;
-    if (registers.count(reg))
-        lhs = static_cast<IntValue*>(registers[reg].get())->value;
-    int rhs = eval_node(node->right.get());
+template <typename Arith>
+void BasicInterpreter<Arith>::exec_binop(const BinOpNode* node) {
+    size_t reg = node->left->slot;
+    if (counts) ++counts->register_reads;
+    Int lhs = registers.values[reg];
+    Int rhs = eval_node(node->right);
 
-    int result = lhs;
-    std::string op = node->op_token.value;
-    if (op == "add") result = lhs + rhs;
-    else if (op == "sub") result = lhs - rhs;
-    else if (op == "mul") result = lhs * rhs;
-    else if (op == "div") result = (rhs != 0) ? (lhs / rhs) : 0;
+    Int result = lhs;
+    switch (node->op_token.op) {
+        case Mnemonic::ADD: result = Arith::add(lhs, rhs); break;
+        case Mnemonic::SUB: result = Arith::sub(lhs, rhs); break;
+        case Mnemonic::MUL: result = Arith::mul(lhs, rhs); break;
+        case Mnemonic::DIV: result = Arith::div(lhs, rhs); break;
+        default: break;
+    }
 
-    registers[reg] = std::make_shared<IntValue>(result);
+    write_register(reg, result);
 }
 
-void Interpreter::exec_cmp(const CmpNode* node) {
-    int lhs = eval_node(node->left.get());
-    int rhs = eval_node(node->right.get());
+template <typename Arith>
+void BasicInterpreter<Arith>::exec_cmp(const CmpNode* node) {
+    Int lhs = eval_node(node->left);
+    Int rhs = eval_node(node->right);
     flags.equal = (lhs == rhs);
     flags.less = (lhs < rhs);
     flags.greater = (lhs > rhs);
@@ -106,20 +250,117 @@ void Interpreter::exec_cmp(const CmpNode* node) {
     //           << " gt=" << flags.greater << std::endl;
 }
 
-void Interpreter::dump_registers() const {
-    std::cout << "Registers:\n";
-    for (const auto& kv : registers) {
-        std::cout << "  " << kv.first << " = " << kv.second->to_string() << "\n";
+template <typename Arith>
+void BasicInterpreter<Arith>::exec_vector(const VectorNode* node) {
+    const VectorKernels& simd = vector_kernels();
+    Vector& vector = vectors[node->vector];
+    const Vector& source = vectors[node->source];
+    switch (node->op) {
+        case VectorOp::ADD: simd.add(vector, source); break;
+        case VectorOp::SUB: simd.sub(vector, source); break;
+        case VectorOp::MUL: simd.mul(vector, source); break;
+        case VectorOp::BROADCAST: simd.broadcast(vector, Arith::narrow(eval_node(node->scalar))); break;
+        case VectorOp::SET: vector.lanes[node->lane] = Arith::narrow(eval_node(node->scalar)); break;
+        case VectorOp::SUM:
+            write_register(static_cast<const IdentifierNode*>(node->scalar)->slot, simd.sum(source));
+            break;
+        case VectorOp::MIN:
+            write_register(static_cast<const IdentifierNode*>(node->scalar)->slot, simd.min(source));
+            break;
+        case VectorOp::MAX:
+            write_register(static_cast<const IdentifierNode*>(node->scalar)->slot, simd.max(source));
+            break;
+        case VectorOp::CMP: {
+            int order = simd.compare(vector, source);
+            flags.equal = order == 0;
+            flags.less = order < 0;
+            flags.greater = order > 0;
+            break;
+        }
+        case VectorOp::PRINT:
+            output.write(VectorValue(source).to_string() + "\n");
+            break;
     }
 }
 
-bool Interpreter::should_jump(const std::string& op) const {
-    if (op == "jmp") return true;
-    if (op == "je")  return flags.equal;
-    if (op == "jne") return !flags.equal;
-    if (op == "jl")  return flags.less;
-    if (op == "jle") return flags.less || flags.equal;
-    if (op == "jg")  return flags.greater;
-    if (op == "jge") return flags.greater || flags.equal;
+template <typename Arith>
+void BasicInterpreter<Arith>::exec_memory(const MemoryNode* node) {
+    switch (node->op) {
+        case MemoryOp::LOAD: {
+            int32_t* word = memory->at(int64_t(eval_node(node->base)) + node->offset);
+            write_register(static_cast<const IdentifierNode*>(node->args[0])->slot, *word);
+            break;
+        }
+        case MemoryOp::STORE: {
+            int32_t* word = memory->at(int64_t(eval_node(node->base)) + node->offset);
+            *word = Arith::narrow(eval_node(node->args[0]));
+            break;
+        }
+        case MemoryOp::COPY: case MemoryOp::FILL: {
+            Int dst = eval_node(node->args[0]);
+            Int second = eval_node(node->args[1]);
+            Int count = eval_node(node->args[2]);
+            int32_t* to = memory->at(dst, count);
+            if (node->op == MemoryOp::COPY)
+                std::memmove(to, memory->at(second, count), static_cast<size_t>(count) * sizeof(int32_t));
+            else
+                vector_kernels().fill(to, Arith::narrow(second), static_cast<size_t>(count));
+            break;
+        }
+    }
+}
+
+// Returns the position of the next node to run; `ip` is the position of `node`.
+template <typename Arith>
+template <typename Code>
+size_t BasicInterpreter<Arith>::exec_stack(const Code& code, const StackNode* node, size_t ip) {
+    switch (node->op) {
+        case StackOp::CALL:
+            stacks.returns.push(code.next(ip), StackError::CALL_OVERFLOW);
+            if (counts) ++counts->jumps_taken;
+            return code.target(node->target);
+        case StackOp::RET:
+            ip = stacks.returns.pop(StackError::CALL_UNDERFLOW);
+            if (counts) ++counts->jumps_taken;
+            return ip;
+        case StackOp::PUSH:
+            stacks.values.push(eval_node(node->operand), StackError::PUSH_OVERFLOW);
+            break;
+        case StackOp::POP:
+            write_register(static_cast<const IdentifierNode*>(node->operand)->slot,
+                           stacks.values.pop(StackError::POP_UNDERFLOW));
+            break;
+    }
+    return code.next(ip);
+}
+
+template <typename Arith>
+void BasicInterpreter<Arith>::dump_registers() {
+    output.write("Registers:\n");
+    for (size_t i = 0; i < registers.size(); ++i) {
+        if (registers.defined[i])
+            output.write("  " + registers.names[i] + " = " + std::to_string(registers.values[i]) + "\n");
+    }
+    output.flush();
+}
+
+template <typename Arith>
+bool BasicInterpreter<Arith>::should_jump(JumpKind op) const {
+    switch (op) {
+        case JumpKind::JMP: return true;
+        case JumpKind::JE:  return flags.equal;
+        case JumpKind::JNE: return !flags.equal;
+        case JumpKind::JL:  return flags.less;
+        case JumpKind::JLE: return flags.less || flags.equal;
+        case JumpKind::JG:  return flags.greater;
+        case JumpKind::JGE: return flags.greater || flags.equal;
+    }
     return false;
-}
\ No newline at end of file
+}
+
+template class BasicInterpreter<Int32Wrap>;
+template class BasicInterpreter<Int32Trap>;
+template class BasicInterpreter<Int32Saturate>;
+template class BasicInterpreter<Int64Wrap>;
+template class BasicInterpreter<Int64Trap>;
+template class BasicInterpreter<Int64Saturate>;
@@ -6,25 +6,76 @@
 
 #include "../frontend/tokens.hpp"
 #include "../common/nodes.hpp"
+#include "../frontend/incremental.hpp"
+#include "arithmetic.hpp"
 #include "values.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "stats.hpp"
 
-class Interpreter {
+// Walks the AST directly. Register width and overflow behaviour come from
+// the Arith policy (see arithmetic.hpp); every policy is instantiated in
+// interpreter.cpp. Vector lanes and memory words stay 32 bits wide, and
+// values stored there are narrowed by the policy.
+template <typename Arith>
+class BasicInterpreter {
 public:
-Interpreter();
-    void interpret(const std::vector<std::unique_ptr<ASTNode>>& nodes);
-    void dump_registers() const;
+    using Int = typename Arith::Value;
+
+    explicit BasicInterpreter(BufferMode mode = BufferMode::BLOCK, int out_fd = 1, int in_fd = 0);
+    void interpret(const std::vector<ASTNode*>& nodes);
+    // For callers that keep an AST resident (see IncrementalProgram):
+    // resolve() binds the registers of one node, and rerun() runs a program
+    // whose nodes were all resolved, starting from undefined registers,
+    // clear vectors and empty stacks.
+    void resolve(ASTNode* node) { resolve_registers(node); }
+    void rerun(const IncrementalProgram& program);
+    void dump_registers();
+    void redirect_output(std::string* sink) { output.redirect(sink); }
+    void attach_memory(Memory* memory) { this->memory = memory ? memory : &Memory::none(); }
+    uint64_t nodes_executed() const { return executed; }
+    // Counts jumps and register traffic into `counts` (nullptr: off).
+    void count_into(ExecutionCounts* counts) { this->counts = counts; }
 
 private:
-    RegisterFile registers;
-    std::unordered_map<std::string, size_t> label_table;
+    BasicRegisterFile<Int> registers;
+    VectorFile vectors{};
+    BasicStackFile<Int> stacks;
+    Memory* memory = &Memory::none();
+    std::unordered_map<std::string_view, size_t> label_table;
     Flags flags;
+    OutputBuffer output;
+    InputBuffer input;
+    uint64_t executed = 0;
+    ExecutionCounts* counts = nullptr;
+
+    // interpret()'s view of the nodes for execute(): positions are indices
+    // and a jump or call target is the index to continue at.
+    struct NodeList {
+        const std::vector<ASTNode*>& nodes;
 
-    void exec_node(const ASTNode* node, size_t& ip, const std::vector<std::unique_ptr<ASTNode>>& nodes);
+        size_t start() const { return 0; }
+        const ASTNode* at(size_t ip) const { return ip < nodes.size() ? nodes[ip] : nullptr; }
+        size_t next(size_t ip) const { return ip + 1; }
+        size_t target(size_t target) const { return target; }
+    };
+
+    void resolve_registers(ASTNode* node);
+    template <typename Code>
+    void execute(const Code& code);
+    void exec_node(const ASTNode* node);
     void exec_assignment(const AssignmentNode* node);
     void exec_binop(const BinOpNode* node);
     void exec_cmp(const CmpNode* node);
+    void exec_vector(const VectorNode* node);
+    void exec_memory(const MemoryNode* node);
+    template <typename Code>
+    size_t exec_stack(const Code& code, const StackNode* node, size_t ip);
+
+    Int eval_node(const ASTNode* node) const;
+    Int read_register(size_t slot) const;
+    void write_register(size_t slot, Int value);
+    bool should_jump(JumpKind op) const;
+};
 
-    int last_cmp_result = 0;
-    int eval_node(const ASTNode* node) const;
-    bool should_jump(const std::string& op) const;
-};
\ No newline at end of file
+using Interpreter = BasicInterpreter<Int32Wrap>;
\ No newline at end of file
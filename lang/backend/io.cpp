@@ -0,0 +1,151 @@
+#include "io.hpp"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
+#include <unistd.h>
+
+OutputBuffer::OutputBuffer(int fd, BufferMode mode, size_t capacity)
+    : fd(fd), mode(mode), buffer(capacity < 64 ? 64 : capacity) {}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+template <typename Int>
+void OutputBuffer::print_number(Int value) {
+    if (buffer.size() - size < 24)
+        flush();
+    auto result = std::to_chars(buffer.data() + size, buffer.data() + buffer.size(), value);
+    size = static_cast<size_t>(result.ptr - buffer.data());
+    buffer[size++] = '\n';
+    end_piece(true);
+}
+
+void OutputBuffer::print_int(int value) {
+    print_number(value);
+}
+
+void OutputBuffer::print_int(int64_t value) {
+    print_number(value);
+}
+
+void OutputBuffer::write(std::string_view text) {
+    if (buffer.size() - size < text.size()) {
+        flush();
+        if (text.size() > buffer.size()) {
+            if (sink) {
+                sink->append(text);
+                return;
+            }
+            for (size_t done = 0; done < text.size(); ) {
+                ssize_t n = ::write(fd, text.data() + done, text.size() - done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return;
+                done += static_cast<size_t>(n);
+            }
+            return;
+        }
+    }
+    std::memcpy(buffer.data() + size, text.data(), text.size());
+    size += text.size();
+    end_piece(!text.empty() && text.back() == '\n');
+}
+
+void OutputBuffer::end_piece(bool newline) {
+    if (mode == BufferMode::UNBUFFERED || (mode == BufferMode::LINE && newline))
+        flush();
+}
+
+void OutputBuffer::flush() {
+    if (sink) {
+        sink->append(buffer.data(), size);
+        size = 0;
+        return;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::write(fd, buffer.data() + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += static_cast<size_t>(n);
+    }
+    size = 0;
+}
+
+InputBuffer::InputBuffer(int fd, OutputBuffer* tie, size_t capacity)
+    : fd(fd), tie(tie), buffer(capacity < 64 ? 64 : capacity) {}
+
+bool InputBuffer::fill() {
+    if (eof) return false;
+    if (tie) tie->flush();
+    if (pos > 0) {
+        std::memmove(buffer.data(), buffer.data() + pos, size - pos);
+        size -= pos;
+        pos = 0;
+    }
+    ssize_t n;
+    do {
+        n = ::read(fd, buffer.data() + size, buffer.size() - size);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        eof = true;
+        return false;
+    }
+    size += static_cast<size_t>(n);
+    return true;
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Finds the next number in the input: [pos, end) is a digit run, possibly
+// after a minus sign.
+bool InputBuffer::next_number(size_t& end) {
+    for (;;) {
+        while (pos < size && !is_digit(buffer[pos]) && buffer[pos] != '-')
+            ++pos;
+        if (pos == size) {
+            if (!fill()) return false;
+            continue;
+        }
+        end = pos + (buffer[pos] == '-' ? 1 : 0);
+        while (end < size && is_digit(buffer[end]))
+            ++end;
+        // The value may continue in the next chunk unless it already fills the buffer.
+        if (end == size && !eof && !(pos == 0 && size == buffer.size())) {
+            fill();
+            continue;
+        }
+        if (buffer[pos] == '-' && end == pos + 1) {
+            ++pos;
+            continue;
+        }
+        return true;
+    }
+}
+
+template <typename Int>
+bool InputBuffer::read_number(Int& value) {
+    using Unsigned = std::make_unsigned_t<Int>;
+    value = 0;
+    size_t end = 0;
+    if (!next_number(end)) return false;
+
+    bool negative = buffer[pos] == '-';
+    Unsigned magnitude = 0;
+    for (size_t i = pos + (negative ? 1 : 0); i < end; ++i)
+        magnitude = static_cast<Unsigned>(magnitude * 10u + static_cast<Unsigned>(buffer[i] - '0'));
+    pos = end;
+    value = static_cast<Int>(negative ? Unsigned(0) - magnitude : magnitude);
+    return true;
+}
+
+bool InputBuffer::read_int(int& value) {
+    return read_number(value);
+}
+
+bool InputBuffer::read_int(int64_t& value) {
+    return read_number(value);
+}
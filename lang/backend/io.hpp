@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class BufferMode {
+    LINE,       // flush after every printed line
+    BLOCK,      // flush when the buffer fills up
+    UNBUFFERED  // write every piece straight through
+};
+
+// Output layer owned by an interpreter. Integers are formatted directly
+// into a large buffer that is written out on a size threshold, on flush()
+// and on destruction.
+class OutputBuffer {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+    explicit OutputBuffer(int fd = 1, BufferMode mode = BufferMode::BLOCK,
+                          size_t capacity = DEFAULT_CAPACITY);
+    ~OutputBuffer();
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void set_mode(BufferMode mode) { this->mode = mode; }
+    BufferMode get_mode() const { return mode; }
+    // Appends flushed output to `sink` instead of writing to the file
+    // descriptor; nullptr switches back.
+    void redirect(std::string* sink) { this->sink = sink; }
+    std::string* redirection() const { return sink; }
+
+    void print_int(int value);
+    void print_int(int64_t value);
+    void write(std::string_view text);
+    void flush();
+
+private:
+    int fd;
+    BufferMode mode;
+    std::string* sink = nullptr;
+    std::vector<char> buffer;
+    size_t size = 0;
+
+    void end_piece(bool newline);
+    template <typename Int>
+    void print_number(Int value);
+};
+
+// Bulk integer reader over a file descriptor. Input is pulled in large
+// chunks and parsed in place; anything that is not a digit or a leading
+// minus sign separates values.
+class InputBuffer {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+    explicit InputBuffer(int fd = 0, OutputBuffer* tie = nullptr,
+                         size_t capacity = DEFAULT_CAPACITY);
+
+    // Reads the next integer; returns false (leaving `value` at 0) at end of
+    // input. Values too large for the type wrap around.
+    bool read_int(int& value);
+    bool read_int(int64_t& value);
+
+private:
+    int fd;
+    OutputBuffer* tie;
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t size = 0;
+    bool eof = false;
+
+    bool fill();
+    bool next_number(size_t& end);
+    template <typename Int>
+    bool read_number(Int& value);
+};
@@ -0,0 +1,154 @@
+#include "ir.hpp"
+#include "../common/vector.hpp"
+
+std::vector<size_t> IRProgram::successors(size_t block) const {
+    const BasicBlock& b = blocks[block];
+    switch (b.branch) {
+        case OpCode::TRAP: return {};
+        case OpCode::JMP: return {b.target};
+        case OpCode::NOP: return {b.next};
+        case OpCode::RET: {
+            std::vector<size_t> returns;
+            for (const BasicBlock& caller : blocks)
+                if (caller.branch == OpCode::CALL) returns.push_back(caller.next);
+            return returns;
+        }
+        default: return {b.target, b.next};
+    }
+}
+
+std::string describe(const Instr& in, const std::vector<std::string>& registers,
+                     const std::vector<std::string>& messages) {
+    auto operand = [&](int32_t value, bool immediate) {
+        return immediate ? std::to_string(value) : registers[value];
+    };
+    auto vector = [](int32_t index) { return "v" + std::to_string(index); };
+    std::string text = opcode_name(in.op);
+    switch (in.op) {
+        case OpCode::LOAD: case OpCode::ADD: case OpCode::SUB:
+        case OpCode::MUL: case OpCode::DIV:
+            return text + " " + registers[in.a] + ", " + operand(in.b, in.mode & B_IMM);
+        case OpCode::CMP:
+            return text + " " + operand(in.a, in.mode & A_IMM) + ", " + operand(in.b, in.mode & B_IMM);
+        case OpCode::JMP: case OpCode::JE: case OpCode::JNE: case OpCode::JL:
+        case OpCode::JG: case OpCode::JLE: case OpCode::JGE: case OpCode::CALL:
+            return text + " @" + std::to_string(in.a);
+        case OpCode::PRINT:
+            return text + " " + operand(in.b, in.mode & B_IMM);
+        case OpCode::READ: case OpCode::POP:
+            return text + " " + registers[in.a];
+        case OpCode::PUSH:
+            return text + " " + operand(in.b, in.mode & B_IMM);
+        case OpCode::TRAP:
+            return text + " \"" + messages[in.a] + "\"";
+        case OpCode::VADD: case OpCode::VSUB: case OpCode::VMUL: case OpCode::VCMP:
+            return text + " " + vector(in.a) + ", " + vector(in.b);
+        case OpCode::VBROADCAST:
+            return text + " " + vector(in.a) + ", " + operand(in.b, in.mode & B_IMM);
+        case OpCode::VSET:
+            return text + " " + vector(in.a / static_cast<int32_t>(VECTOR_LANES)) + ", " +
+                   std::to_string(in.a % static_cast<int32_t>(VECTOR_LANES)) + ", " +
+                   operand(in.b, in.mode & B_IMM);
+        case OpCode::VSUM: case OpCode::VMIN: case OpCode::VMAX:
+            return text + " " + registers[in.a] + ", " + vector(in.b);
+        case OpCode::VPRINT:
+            return text + " " + vector(in.b);
+        case OpCode::MEM_LOAD: case OpCode::MEM_STORE: {
+            std::string address = "[" + (in.op == OpCode::MEM_LOAD ? operand(in.b, in.mode & B_IMM)
+                                                                   : operand(in.a, in.mode & A_IMM));
+            if (in.c) address += (in.c < 0 ? " - " : " + ") + std::to_string(in.c < 0 ? -int64_t(in.c) : in.c);
+            address += "]";
+            if (in.op == OpCode::MEM_LOAD) return text + " " + registers[in.a] + ", " + address;
+            return text + " " + address + ", " + operand(in.b, in.mode & B_IMM);
+        }
+        case OpCode::MEM_COPY: case OpCode::MEM_FILL:
+            return text + " " + operand(in.a, in.mode & A_IMM) + ", " + operand(in.b, in.mode & B_IMM) +
+                   ", " + operand(in.c, in.mode & C_IMM);
+        default:
+            return text;
+    }
+}
+
+void IRProgram::dump(std::ostream& out) const {
+    auto block_name = [&](size_t id) {
+        return id == exit() ? std::string("exit") : "B" + std::to_string(id);
+    };
+
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        const BasicBlock& b = blocks[id];
+        out << block_name(id) << ":";
+        for (const auto& label : b.labels)
+            out << " " << label << ":";
+        out << "\n";
+        for (const Instr& in : b.body)
+            out << "    " << describe(in, registers, messages) << "\n";
+        switch (b.branch) {
+            case OpCode::TRAP:
+                break;
+            case OpCode::JMP:
+                out << "    jmp " << block_name(b.target) << "\n";
+                break;
+            case OpCode::NOP:
+                out << "    -> " << block_name(b.next) << "\n";
+                break;
+            case OpCode::CALL:
+                out << "    call " << block_name(b.target) << " return " << block_name(b.next) << "\n";
+                break;
+            case OpCode::RET:
+                out << "    ret\n";
+                break;
+            default:
+                out << "    " << opcode_name(b.branch) << " " << block_name(b.target)
+                    << " else " << block_name(b.next) << "\n";
+                break;
+        }
+    }
+}
+
+// Lays the blocks out in order. Jumps to the block placed right after are
+// dropped, and a fall-through that does not land on that block becomes a jmp.
+Program IRProgram::lower() const {
+    Program program;
+    program.registers = registers;
+    program.messages = messages;
+
+    std::vector<size_t> starts(blocks.size() + 1, 0);
+    std::vector<std::pair<size_t, size_t>> fixups; // (instruction, block)
+    auto jump = [&](OpCode op, size_t block, SourceLoc location) {
+        fixups.emplace_back(program.code.size(), block);
+        program.code.push_back(Instr{op, 0, 0, 0});
+        program.locations.push_back(location);
+    };
+
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        const BasicBlock& b = blocks[id];
+        starts[id] = program.code.size();
+        for (const auto& label : b.labels)
+            program.labels.emplace_back(starts[id], label);
+        program.code.insert(program.code.end(), b.body.begin(), b.body.end());
+        program.locations.insert(program.locations.end(), b.locations.begin(), b.locations.end());
+        switch (b.branch) {
+            case OpCode::TRAP:
+                break;
+            case OpCode::JMP:
+                if (b.target != id + 1) jump(OpCode::JMP, b.target, b.branch_location);
+                break;
+            case OpCode::NOP:
+                if (b.next != id + 1) jump(OpCode::JMP, b.next, SourceLoc());
+                break;
+            case OpCode::RET:
+                program.code.push_back(Instr{OpCode::RET, 0, 0, 0});
+                program.locations.push_back(b.branch_location);
+                break;
+            default:
+                jump(b.branch, b.target, b.branch_location);
+                if (b.next != id + 1) jump(OpCode::JMP, b.next, SourceLoc());
+                break;
+        }
+    }
+    starts[blocks.size()] = program.code.size();
+
+    for (const auto& [index, block] : fixups)
+        program.code[index].a = static_cast<int32_t>(starts[block]);
+    return program;
+}
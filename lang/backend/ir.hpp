@@ -0,0 +1,39 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+
+// Mid-level IR: the program split into basic blocks at labels and jumps.
+// A block body is straight-line bytecode (never a jump); control flow is
+// described by the block's terminator. Block ids index IRProgram::blocks,
+// and the id equal to blocks.size() stands for the end of the program.
+//
+// A call goes to `target` and comes back to `next`. For the analyses a
+// call block flows into both and a ret block into the return block of
+// every call, which over-approximates the real paths.
+struct BasicBlock {
+    std::vector<Instr> body;
+    std::vector<SourceLoc> locations; // parallel to body
+    OpCode branch = OpCode::NOP; // NOP falls through, JMP/Jcc/CALL go to target, TRAP stops, RET returns
+    SourceLoc branch_location;
+    size_t target = 0;
+    size_t next = 0;             // fall-through successor
+    std::vector<std::string> labels;
+};
+
+struct IRProgram {
+    std::vector<BasicBlock> blocks; // blocks[0] is the entry
+    std::vector<std::string> registers;
+    std::vector<std::string> messages;
+
+    size_t exit() const { return blocks.size(); }
+    std::vector<size_t> successors(size_t block) const;
+    void dump(std::ostream& out) const;
+    Program lower() const;
+};
+
+// Human-readable form of one instruction, e.g. "add s, 3" or "jl @12".
+std::string describe(const Instr& in, const std::vector<std::string>& registers,
+                     const std::vector<std::string>& messages);
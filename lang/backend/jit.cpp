@@ -0,0 +1,527 @@
+#include "jit.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if ASMPLE_JIT_X64
+#include <sys/mman.h>
+#endif
+
+Jit::Jit(BufferMode mode, int out_fd)
+    : output(out_fd, mode), input(0, &output) {}
+
+Jit::~Jit() {
+    release();
+}
+
+void Jit::runtime_print(Jit* self, int32_t value) {
+    self->output.print_int(value);
+}
+
+int32_t Jit::runtime_read(Jit* self) {
+    int value = 0;
+    self->input.read_int(value);
+    return value;
+}
+
+void Jit::runtime_trap(Jit* self, int32_t message) {
+    self->trap = message;
+}
+
+#if ASMPLE_JIT_X64
+
+namespace {
+
+// Frame layout addressed through r15 by the generated code.
+constexpr int32_t FRAME_SELF = 0;
+constexpr int32_t FRAME_EQUAL = 8;
+constexpr int32_t FRAME_LESS = 9;
+constexpr int32_t FRAME_GREATER = 10;
+constexpr int32_t FRAME_REGS = 16;
+
+enum Reg { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+           R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+// Callee-saved registers that hold the hottest asmple registers.
+constexpr Reg HOT_REGS[] = {RBX, RBP, R12, R13, R14};
+constexpr size_t HOT_COUNT = sizeof(HOT_REGS) / sizeof(HOT_REGS[0]);
+
+// x86 condition codes used with jcc/setcc.
+enum Cond : uint8_t { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+// Where an operand lives: an immediate, a machine register or a frame slot.
+struct Loc {
+    bool imm;
+    int reg;       // machine register, or -1 for a frame slot
+    int32_t value; // immediate value or frame displacement
+};
+
+class Emitter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void byte(uint8_t b) { bytes.push_back(b); }
+    void dword(int32_t v) {
+        uint32_t u = static_cast<uint32_t>(v);
+        for (int i = 0; i < 4; ++i) byte(static_cast<uint8_t>(u >> (8 * i)));
+    }
+    void qword(uint64_t v) {
+        for (int i = 0; i < 8; ++i) byte(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    size_t pos() const { return bytes.size(); }
+    void patch_rel32(size_t at, size_t target) {
+        int32_t rel = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+        std::memcpy(&bytes[at], &rel, 4);
+    }
+
+    void rex(bool w, int reg, int rm) {
+        uint8_t r = static_cast<uint8_t>(0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0));
+        if (r != 0x40) byte(r);
+    }
+    void modrm_reg(int reg, int rm) { byte(static_cast<uint8_t>(0xC0 | ((reg & 7) << 3) | (rm & 7))); }
+    void modrm_frame(int reg, int32_t disp) {
+        byte(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | (R15 & 7)));
+        dword(disp);
+    }
+
+    // op r/m32, r32 (add 01, sub 29, cmp 39, mov 89, xor 31, test 85)
+    void rr(uint8_t opcode, int dst, int src) { rex(false, src, dst); byte(opcode); modrm_reg(src, dst); }
+    // op r32, [r15 + disp] (add 03, sub 2B, cmp 3B, mov 8B)
+    void rm(uint8_t opcode, int dst, int32_t disp) { rex(false, dst, R15); byte(opcode); modrm_frame(dst, disp); }
+    // op r/m32, imm32 (81 /ext: add 0, sub 5, cmp 7)
+    void ri(int ext, int dst, int32_t imm) { rex(false, 0, dst); byte(0x81); modrm_reg(ext, dst); dword(imm); }
+    void mov_ri(int dst, int32_t imm) { rex(false, 0, dst); byte(static_cast<uint8_t>(0xB8 + (dst & 7))); dword(imm); }
+    void store(int32_t disp, int src) { rex(false, src, R15); byte(0x89); modrm_frame(src, disp); }
+    void store_imm(int32_t disp, int32_t imm) { rex(false, 0, R15); byte(0xC7); modrm_frame(0, disp); dword(imm); }
+    void imul_rr(int dst, int src) { rex(false, dst, src); byte(0x0F); byte(0xAF); modrm_reg(dst, src); }
+    void imul_rm(int dst, int32_t disp) { rex(false, dst, R15); byte(0x0F); byte(0xAF); modrm_frame(dst, disp); }
+    void imul_rri(int dst, int src, int32_t imm) { rex(false, dst, src); byte(0x69); modrm_reg(dst, src); dword(imm); }
+    void setcc_frame(Cond cc, int32_t disp) { rex(false, 0, R15); byte(0x0F); byte(static_cast<uint8_t>(0x90 | cc)); modrm_frame(0, disp); }
+    void cmp_byte_zero(int32_t disp) { rex(false, 0, R15); byte(0x80); modrm_frame(7, disp); byte(0); }
+    void load_byte_al(int32_t disp) { rex(false, 0, R15); byte(0x8A); modrm_frame(RAX, disp); }
+    void or_byte_al(int32_t disp) { rex(false, 0, R15); byte(0x0A); modrm_frame(RAX, disp); }
+    void push(int r) { rex(false, 0, r); byte(static_cast<uint8_t>(0x50 + (r & 7))); }
+    void pop(int r) { rex(false, 0, r); byte(static_cast<uint8_t>(0x58 + (r & 7))); }
+
+    // Emits a rel32 jump/jcc and returns the offset of its displacement.
+    size_t jmp32() { byte(0xE9); size_t at = pos(); dword(0); return at; }
+    size_t jcc32(Cond cc) { byte(0x0F); byte(static_cast<uint8_t>(0x80 | cc)); size_t at = pos(); dword(0); return at; }
+
+    void call(const void* fn) {
+        byte(0x48); byte(0xB8); qword(reinterpret_cast<uint64_t>(fn)); // mov rax, imm64
+        byte(0xFF); byte(0xD0);                                          // call rax
+    }
+    void load_self_rdi() { rex(true, RDI, R15); byte(0x8B); modrm_frame(RDI, FRAME_SELF); }
+};
+
+bool reads_register(const Instr& in, bool second) {
+    uint8_t bit = second ? B_IMM : A_IMM;
+    if (in.mode & bit) return false;
+    switch (in.op) {
+        case OpCode::LOAD: case OpCode::ADD: case OpCode::SUB:
+        case OpCode::MUL: case OpCode::DIV: case OpCode::PRINT:
+            return second;
+        case OpCode::CMP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool writes_register(const Instr& in) {
+    switch (in.op) {
+        case OpCode::LOAD: case OpCode::ADD: case OpCode::SUB:
+        case OpCode::MUL: case OpCode::DIV: case OpCode::READ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_jump(OpCode op) {
+    return op >= OpCode::JMP && op <= OpCode::JGE;
+}
+
+// Forward dataflow over register definedness. With `must` set the meet is
+// intersection (defined on every path), otherwise union (on some path).
+std::vector<std::vector<uint64_t>> definedness(const Program& program, bool must) {
+    const size_t n = program.code.size();
+    const size_t words = (program.registers.size() + 63) / 64;
+    std::vector<std::vector<uint64_t>> in(n + 1);
+    std::vector<bool> seen(n + 1, false);
+    std::vector<size_t> work;
+
+    auto merge = [&](size_t at, const std::vector<uint64_t>& state) {
+        if (!seen[at]) {
+            seen[at] = true;
+            in[at] = state;
+            work.push_back(at);
+            return;
+        }
+        bool changed = false;
+        for (size_t w = 0; w < words; ++w) {
+            uint64_t merged = must ? (in[at][w] & state[w]) : (in[at][w] | state[w]);
+            if (merged != in[at][w]) {
+                in[at][w] = merged;
+                changed = true;
+            }
+        }
+        if (changed) work.push_back(at);
+    };
+
+    merge(0, std::vector<uint64_t>(words, 0));
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        if (i >= n) continue;
+        const Instr& ins = program.code[i];
+        std::vector<uint64_t> out = in[i];
+        if (writes_register(ins))
+            out[ins.a / 64] |= uint64_t(1) << (ins.a % 64);
+        if (ins.op == OpCode::TRAP) continue;
+        if (is_jump(ins.op)) merge(static_cast<size_t>(ins.a), out);
+        if (ins.op != OpCode::JMP) merge(i + 1, out);
+    }
+    for (size_t i = 0; i <= n; ++i)
+        if (!seen[i]) in[i].clear(); // unreachable
+    return in;
+}
+
+bool test_bit(const std::vector<uint64_t>& set, int32_t slot) {
+    return !set.empty() && (set[slot / 64] >> (slot % 64)) & 1;
+}
+
+} // namespace
+
+bool Jit::compile(const Program& program) {
+    release();
+    const auto& code_in = program.code;
+    const size_t n = code_in.size();
+
+    for (const Instr& in : code_in) {
+        switch (in.op) {
+            case OpCode::NOP: case OpCode::LOAD: case OpCode::ADD: case OpCode::SUB:
+            case OpCode::MUL: case OpCode::DIV: case OpCode::CMP: case OpCode::JMP:
+            case OpCode::JE: case OpCode::JNE: case OpCode::JL: case OpCode::JG:
+            case OpCode::JLE: case OpCode::JGE: case OpCode::PRINT: case OpCode::READ:
+            case OpCode::TRAP:
+                break;
+            default:
+                return false;
+        }
+    }
+
+    // Reads of registers that are defined on some paths but not on others
+    // would need a runtime check per read; leave those programs to the VM.
+    // Reads that can never see a value become a trap, exactly as in the VM.
+    auto must = definedness(program, true);
+    auto may = definedness(program, false);
+    messages = program.messages;
+    std::vector<int32_t> undefined_read(n, -1);
+    for (size_t i = 0; i < n; ++i) {
+        if (must[i].empty()) continue;
+        for (bool second : {false, true}) {
+            if (!reads_register(code_in[i], second)) continue;
+            int32_t slot = second ? code_in[i].b : code_in[i].a;
+            if (test_bit(must[i], slot)) continue;
+            if (test_bit(may[i], slot)) return false;
+            undefined_read[i] = static_cast<int32_t>(messages.size());
+            messages.push_back("Unknown register: " + program.registers[slot]);
+            break;
+        }
+    }
+
+    // Pick the hottest registers, weighting instructions inside loops.
+    std::vector<int64_t> loop_depth(n + 1, 0);
+    std::vector<bool> is_target(n + 1, false);
+    for (size_t i = 0; i < n; ++i) {
+        if (!is_jump(code_in[i].op)) continue;
+        size_t target = static_cast<size_t>(code_in[i].a);
+        is_target[target] = true;
+        if (target <= i) {
+            loop_depth[target] += 1;
+            loop_depth[i + 1] -= 1;
+        }
+    }
+    std::vector<uint64_t> weight(program.registers.size(), 0);
+    int64_t depth = 0;
+    for (size_t i = 0; i < n; ++i) {
+        depth += loop_depth[i];
+        uint64_t w = depth > 0 ? 16 : 1;
+        const Instr& in = code_in[i];
+        if (writes_register(in) || reads_register(in, false)) weight[in.a] += w;
+        if (reads_register(in, true)) weight[in.b] += w;
+    }
+    std::vector<int32_t> order(program.registers.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<int32_t>(i);
+    std::stable_sort(order.begin(), order.end(), [&](int32_t x, int32_t y) { return weight[x] > weight[y]; });
+    std::vector<int> machine(program.registers.size(), -1);
+    for (size_t i = 0; i < order.size() && i < HOT_COUNT; ++i)
+        if (weight[order[i]] > 0) machine[order[i]] = HOT_REGS[i];
+
+    auto loc = [&](int32_t operand, bool imm) -> Loc {
+        if (imm) return Loc{true, -1, operand};
+        if (machine[operand] >= 0) return Loc{false, machine[operand], 0};
+        return Loc{false, -1, FRAME_REGS + 4 * operand};
+    };
+
+    Emitter e;
+    // Moves or combines `src` into machine register `dst`. `rr_op`/`rm_op`
+    // are the r/m,reg and reg,r/m encodings; `ext` selects the imm32 form.
+    auto alu = [&](uint8_t rr_op, uint8_t rm_op, int ext, int dst, const Loc& src) {
+        if (src.imm) {
+            if (rr_op == 0x89) e.mov_ri(dst, src.value);
+            else e.ri(ext, dst, src.value);
+        } else if (src.reg >= 0) {
+            e.rr(rr_op, dst, src.reg);
+        } else {
+            e.rm(rm_op, dst, src.value);
+        }
+    };
+    auto load = [&](int dst, const Loc& src) {
+        if (!src.imm && src.reg == dst) return;
+        alu(0x89, 0x8B, 0, dst, src);
+    };
+
+    // Flags only need to be materialised in the frame when some conditional
+    // jump cannot use the native flags of the immediately preceding cmp.
+    std::vector<bool> fused(n, false);
+    bool need_flags = false;
+    bool native_valid = false;
+    for (size_t i = 0; i < n; ++i) {
+        const Instr& in = code_in[i];
+        if (is_target[i]) native_valid = false;
+        if (in.op == OpCode::CMP) {
+            native_valid = true;
+            continue;
+        }
+        if (is_jump(in.op)) {
+            if (in.op != OpCode::JMP) {
+                fused[i] = native_valid;
+                if (!native_valid) need_flags = true;
+            }
+            continue;
+        }
+        if (in.op != OpCode::NOP) native_valid = false;
+    }
+
+    // Prologue: save callee-saved registers, keep the frame in r15 and load
+    // the hot registers. Six pushes plus 8 bytes keep rsp 16-byte aligned.
+    for (int r : {RBX, RBP, R12, R13, R14, R15}) e.push(r);
+    e.byte(0x48); e.byte(0x83); e.byte(0xEC); e.byte(0x08); // sub rsp, 8
+    e.rex(true, RDI, R15); e.byte(0x89); e.modrm_reg(RDI, R15); // mov r15, rdi
+    for (size_t slot = 0; slot < machine.size(); ++slot)
+        if (machine[slot] >= 0) e.rm(0x8B, machine[slot], FRAME_REGS + 4 * static_cast<int32_t>(slot));
+
+    std::vector<size_t> offsets(n + 1, 0);
+    std::vector<std::pair<size_t, size_t>> fixups; // (displacement offset, instruction index)
+    std::vector<size_t> exits;                     // jumps to the epilogue
+
+    for (size_t i = 0; i < n; ++i) {
+        offsets[i] = e.pos();
+        const Instr& in = code_in[i];
+
+        if (undefined_read[i] >= 0) {
+            e.load_self_rdi();
+            e.mov_ri(RSI, undefined_read[i]);
+            e.call(reinterpret_cast<const void*>(&Jit::runtime_trap));
+            exits.push_back(e.jmp32());
+            continue;
+        }
+
+        switch (in.op) {
+            case OpCode::NOP:
+                break;
+            case OpCode::LOAD: {
+                Loc dst = loc(in.a, false);
+                Loc src = loc(in.b, in.mode & B_IMM);
+                if (dst.reg >= 0) {
+                    load(dst.reg, src);
+                } else if (src.imm) {
+                    e.store_imm(dst.value, src.value);
+                } else {
+                    load(RAX, src);
+                    e.store(dst.value, RAX);
+                }
+                break;
+            }
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL: {
+                Loc dst = loc(in.a, false);
+                Loc src = loc(in.b, in.mode & B_IMM);
+                int r = dst.reg >= 0 ? dst.reg : RAX;
+                if (dst.reg < 0) load(RAX, dst);
+                if (in.op == OpCode::ADD) alu(0x01, 0x03, 0, r, src);
+                else if (in.op == OpCode::SUB) alu(0x29, 0x2B, 5, r, src);
+                else if (src.imm) e.imul_rri(r, r, src.value);
+                else if (src.reg >= 0) e.imul_rr(r, src.reg);
+                else e.imul_rm(r, src.value);
+                if (dst.reg < 0) e.store(dst.value, RAX);
+                break;
+            }
+            case OpCode::DIV: {
+                // Division by zero yields 0 and INT_MIN / -1 wraps, like
+                // the interpreter; idiv would fault on both.
+                Loc dst = loc(in.a, false);
+                Loc src = loc(in.b, in.mode & B_IMM);
+                if (src.imm && src.value == 0) {
+                    if (dst.reg >= 0) e.rr(0x31, dst.reg, dst.reg);
+                    else e.store_imm(dst.value, 0);
+                    break;
+                }
+                load(RAX, dst);
+                load(RCX, src);
+                size_t skip_zero = 0, skip_divide = 0;
+                if (!src.imm) {
+                    e.rr(0x85, RCX, RCX);               // test ecx, ecx
+                    e.byte(0x74); skip_zero = e.pos(); e.byte(0); // jz .zero
+                    e.byte(0x83); e.byte(0xF9); e.byte(0xFF); // cmp ecx, -1
+                    e.byte(0x75); e.byte(4);            // jne .divide
+                    e.byte(0xF7); e.byte(0xD8);         // neg eax
+                    e.byte(0xEB); skip_divide = e.pos(); e.byte(0); // jmp .done
+                }
+                if (src.imm && src.value == -1) {
+                    e.byte(0xF7); e.byte(0xD8);         // neg eax
+                } else {
+                    e.byte(0x99);                       // .divide: cdq
+                    e.byte(0xF7); e.byte(0xF9);         // idiv ecx
+                }
+                if (!src.imm) {
+                    e.byte(0xEB); e.byte(2);            // jmp .done
+                    e.bytes[skip_zero] = static_cast<uint8_t>(e.pos() - skip_zero - 1);
+                    e.rr(0x31, RAX, RAX);               // .zero: xor eax, eax
+                    e.bytes[skip_divide] = static_cast<uint8_t>(e.pos() - skip_divide - 1);
+                }
+                if (dst.reg >= 0) e.rr(0x89, dst.reg, RAX);
+                else e.store(dst.value, RAX);
+                break;
+            }
+            case OpCode::CMP: {
+                Loc lhs = loc(in.a, in.mode & A_IMM);
+                Loc rhs = loc(in.b, in.mode & B_IMM);
+                int r = lhs.reg;
+                if (lhs.imm || lhs.reg < 0) {
+                    load(RAX, lhs);
+                    r = RAX;
+                }
+                alu(0x39, 0x3B, 7, r, rhs);
+                if (need_flags) {
+                    e.setcc_frame(CC_E, FRAME_EQUAL);
+                    e.setcc_frame(CC_L, FRAME_LESS);
+                    e.setcc_frame(CC_G, FRAME_GREATER);
+                }
+                break;
+            }
+            case OpCode::JMP:
+                fixups.emplace_back(e.jmp32(), static_cast<size_t>(in.a));
+                break;
+            case OpCode::JE: case OpCode::JNE: case OpCode::JL:
+            case OpCode::JG: case OpCode::JLE: case OpCode::JGE: {
+                Cond native = CC_E;
+                switch (in.op) {
+                    case OpCode::JE: native = CC_E; break;
+                    case OpCode::JNE: native = CC_NE; break;
+                    case OpCode::JL: native = CC_L; break;
+                    case OpCode::JG: native = CC_G; break;
+                    case OpCode::JLE: native = CC_LE; break;
+                    default: native = CC_GE; break;
+                }
+                if (fused[i]) {
+                    fixups.emplace_back(e.jcc32(native), static_cast<size_t>(in.a));
+                    break;
+                }
+                switch (in.op) {
+                    case OpCode::JE: e.cmp_byte_zero(FRAME_EQUAL); native = CC_NE; break;
+                    case OpCode::JNE: e.cmp_byte_zero(FRAME_EQUAL); native = CC_E; break;
+                    case OpCode::JL: e.cmp_byte_zero(FRAME_LESS); native = CC_NE; break;
+                    case OpCode::JG: e.cmp_byte_zero(FRAME_GREATER); native = CC_NE; break;
+                    case OpCode::JLE: e.load_byte_al(FRAME_EQUAL); e.or_byte_al(FRAME_LESS); native = CC_NE; break;
+                    default: e.load_byte_al(FRAME_EQUAL); e.or_byte_al(FRAME_GREATER); native = CC_NE; break;
+                }
+                fixups.emplace_back(e.jcc32(native), static_cast<size_t>(in.a));
+                break;
+            }
+            case OpCode::PRINT: {
+                Loc src = loc(in.b, in.mode & B_IMM);
+                load(RSI, src);
+                e.load_self_rdi();
+                e.call(reinterpret_cast<const void*>(&Jit::runtime_print));
+                break;
+            }
+            case OpCode::READ: {
+                e.load_self_rdi();
+                e.call(reinterpret_cast<const void*>(&Jit::runtime_read));
+                Loc dst = loc(in.a, false);
+                if (dst.reg >= 0) e.rr(0x89, dst.reg, RAX);
+                else e.store(dst.value, RAX);
+                break;
+            }
+            case OpCode::TRAP:
+                e.load_self_rdi();
+                e.mov_ri(RSI, in.a);
+                e.call(reinterpret_cast<const void*>(&Jit::runtime_trap));
+                exits.push_back(e.jmp32());
+                break;
+            default:
+                return false;
+        }
+    }
+
+    // Epilogue: write hot registers back to the frame and restore.
+    offsets[n] = e.pos();
+    for (size_t slot = 0; slot < machine.size(); ++slot)
+        if (machine[slot] >= 0) e.store(FRAME_REGS + 4 * static_cast<int32_t>(slot), machine[slot]);
+    e.byte(0x48); e.byte(0x83); e.byte(0xC4); e.byte(0x08); // add rsp, 8
+    for (int r : {R15, R14, R13, R12, RBP, RBX}) e.pop(r);
+    e.byte(0xC3);
+
+    for (const auto& [at, target] : fixups) e.patch_rel32(at, offsets[target]);
+    for (size_t at : exits) e.patch_rel32(at, offsets[n]);
+
+    void* mem = mmap(nullptr, e.bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    std::memcpy(mem, e.bytes.data(), e.bytes.size());
+    if (mprotect(mem, e.bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, e.bytes.size());
+        return false;
+    }
+    code = mem;
+    code_bytes = e.bytes.size();
+    register_count = program.registers.size();
+    return true;
+}
+
+void Jit::run() {
+    if (!code) throw std::runtime_error("JIT: no compiled program");
+    frame.assign((static_cast<size_t>(FRAME_REGS) + 4 * register_count + 7) / 8, 0);
+    Jit* self = this;
+    std::memcpy(reinterpret_cast<char*>(frame.data()) + FRAME_SELF, &self, sizeof(self));
+    trap = -1;
+
+    auto entry = reinterpret_cast<void (*)(void*)>(code);
+    entry(frame.data());
+    output.flush();
+    if (trap >= 0)
+        throw std::runtime_error(messages[trap]);
+}
+
+void Jit::release() {
+    if (code) munmap(code, code_bytes);
+    code = nullptr;
+    code_bytes = 0;
+}
+
+#else
+
+bool Jit::compile(const Program&) {
+    return false;
+}
+
+void Jit::run() {
+    throw std::runtime_error("JIT: not supported on this platform");
+}
+
+void Jit::release() {}
+
+#endif
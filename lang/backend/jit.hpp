@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "io.hpp"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define ASMPLE_JIT_X64 1
+#else
+#define ASMPLE_JIT_X64 0
+#endif
+
+// Template JIT for x86-64 Linux. Each bytecode instruction is expanded into
+// a fixed machine-code sequence: the most used registers live in callee-saved
+// machine registers, cmp followed by a conditional jump becomes a native
+// compare and branch, and print/read call back into the runtime.
+//
+// compile() returns false when the program cannot be translated (other
+// architectures, unsupported opcodes, registers that may be read before
+// they are written); callers then run the program on the VM instead.
+class Jit {
+public:
+    explicit Jit(BufferMode mode = BufferMode::BLOCK, int out_fd = 1);
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    static bool supported() { return ASMPLE_JIT_X64; }
+
+    bool compile(const Program& program);
+    void run();
+
+    size_t code_size() const { return code_bytes; }
+
+private:
+    void* code = nullptr;
+    size_t code_bytes = 0;
+    size_t register_count = 0;
+    std::vector<std::string> messages;
+    std::vector<uint64_t> frame;
+    OutputBuffer output;
+    InputBuffer input;
+    int32_t trap = -1;
+
+    void release();
+
+    static void runtime_print(Jit* self, int32_t value);
+    static int32_t runtime_read(Jit* self);
+    static void runtime_trap(Jit* self, int32_t message);
+};
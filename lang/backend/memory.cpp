@@ -0,0 +1,69 @@
+#include "memory.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Memory::Memory(size_t words) {
+    allocate(words);
+}
+
+Memory::~Memory() {
+    release();
+}
+
+Memory& Memory::none() {
+    static Memory empty(0);
+    return empty;
+}
+
+void Memory::allocate(size_t size) {
+    release();
+    if (size == 0) return;
+    void* p = ::mmap(nullptr, size * sizeof(int32_t), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        throw std::runtime_error("Could not allocate " + std::to_string(size) + " words of memory");
+    words = static_cast<int32_t*>(p);
+    count = size;
+    mapped_bytes = size * sizeof(int32_t);
+}
+
+void Memory::release() {
+    if (words) ::munmap(words, mapped_bytes);
+    words = nullptr;
+    count = 0;
+    mapped_bytes = 0;
+}
+
+void Memory::map_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open data file " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Could not stat data file " + path);
+    }
+    size_t bytes = static_cast<size_t>(st.st_size);
+    size_t file_words = (bytes + sizeof(int32_t) - 1) / sizeof(int32_t);
+    try {
+        allocate(file_words > count ? file_words : count);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    // Replace the start of the anonymous mapping with the file; the rest of
+    // the last page reads as zeros.
+    if (bytes > 0 && ::mmap(words, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Could not map data file " + path);
+    }
+    ::close(fd);
+}
+
+void Memory::out_of_bounds(int64_t address, int64_t length) const {
+    std::string what = length == 1 ? "address " + std::to_string(address)
+                                    : std::to_string(length) + " words at " + std::to_string(address);
+    throw std::runtime_error("Memory access out of bounds: " + what + " (memory has " +
+                             std::to_string(count) + " words)");
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Flat memory for load/store/memcpy/memset, addressed in 32-bit words from
+// 0. It is an anonymous private mapping, so pages nobody touches cost
+// nothing. A data file is mapped copy-on-write over the start of the
+// segment: reads come straight from the page cache with no copy, and
+// stores never reach the file.
+class Memory {
+public:
+    static constexpr size_t DEFAULT_WORDS = size_t(1) << 20;
+
+    explicit Memory(size_t words = DEFAULT_WORDS);
+    ~Memory();
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
+    // Maps `path` at word 0 (native byte order; a trailing partial word is
+    // zero-padded) and grows the segment to cover it if needed. Throws
+    // std::runtime_error when the file cannot be mapped.
+    void map_file(const std::string& path);
+
+    int32_t* data() const { return words; }
+    size_t size() const { return count; }
+
+    // Bounds checks can be turned off for trusted scripts; an access out
+    // of range is then undefined behaviour.
+    void set_checked(bool checked) { this->checked = checked; }
+    bool is_checked() const { return checked; }
+
+    // The `length` words starting at `address`.
+    int32_t* at(int64_t address, int64_t length = 1) const {
+        if (checked && (address < 0 || length < 0 || address + length > static_cast<int64_t>(count)))
+            out_of_bounds(address, length);
+        return words + address;
+    }
+
+    // A zero-sized segment, for engines nobody attached memory to.
+    static Memory& none();
+
+private:
+    int32_t* words = nullptr;
+    size_t count = 0;
+    size_t mapped_bytes = 0;
+    bool checked = true;
+
+    void allocate(size_t words);
+    void release();
+    [[noreturn]] void out_of_bounds(int64_t address, int64_t length) const;
+};
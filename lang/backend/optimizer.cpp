@@ -0,0 +1,435 @@
+#include "optimizer.hpp"
+#include "arithmetic.hpp"
+
+namespace {
+
+// What is known about a register on entry to an instruction. An undefined
+// register still has the value 0 as far as arithmetic is concerned.
+enum Def : uint8_t { DEF_NO, DEF_YES, DEF_MAYBE };
+
+struct Known {
+    Def def;
+    bool constant;
+    int32_t value;
+};
+
+struct State {
+    bool reached = false;
+    std::vector<Known> regs;
+    bool flags_constant = true;
+    bool equal = false, less = false, greater = false;
+};
+
+bool is_arith(OpCode op) {
+    return op == OpCode::LOAD || op == OpCode::ADD || op == OpCode::SUB ||
+           op == OpCode::MUL || op == OpCode::DIV;
+}
+
+bool is_conditional(OpCode op) {
+    return op >= OpCode::JE && op <= OpCode::JGE;
+}
+
+// Vector instructions that read a scalar operand in `b`.
+bool reads_scalar(OpCode op) {
+    return op == OpCode::VBROADCAST || op == OpCode::VSET;
+}
+
+// Vector reductions that write a scalar register in `a`.
+bool writes_scalar(OpCode op) {
+    return op == OpCode::VSUM || op == OpCode::VMIN || op == OpCode::VMAX;
+}
+
+bool taken(OpCode op, const State& s) {
+    switch (op) {
+        case OpCode::JE: return s.equal;
+        case OpCode::JNE: return !s.equal;
+        case OpCode::JL: return s.less;
+        case OpCode::JG: return s.greater;
+        case OpCode::JLE: return s.less || s.equal;
+        case OpCode::JGE: return s.greater || s.equal;
+        default: return true;
+    }
+}
+
+// Evaluates like the VM does (see Int32Wrap).
+bool fold(OpCode op, int32_t lhs, int32_t rhs, int32_t& out) {
+    switch (op) {
+        case OpCode::LOAD: out = rhs; return true;
+        case OpCode::ADD: out = Int32Wrap::add(lhs, rhs); return true;
+        case OpCode::SUB: out = Int32Wrap::sub(lhs, rhs); return true;
+        case OpCode::MUL: out = Int32Wrap::mul(lhs, rhs); return true;
+        case OpCode::DIV: out = Int32Wrap::div(lhs, rhs); return true;
+        default:
+            return false;
+    }
+}
+
+Known operand(const State& s, int32_t value, bool immediate) {
+    if (immediate) return Known{DEF_YES, true, value};
+    return s.regs[value];
+}
+
+// True when reading the instruction's register operands may throw.
+bool may_throw(const State& s, const Instr& in) {
+    auto unsafe = [&](int32_t value, bool immediate) {
+        return !immediate && (!s.reached || s.regs[value].def != DEF_YES);
+    };
+    if (is_arith(in.op) || in.op == OpCode::PRINT || in.op == OpCode::PUSH || reads_scalar(in.op))
+        return unsafe(in.b, in.mode & B_IMM);
+    if (in.op == OpCode::CMP || in.op == OpCode::MEM_STORE)
+        return unsafe(in.a, in.mode & A_IMM) || unsafe(in.b, in.mode & B_IMM);
+    if (in.op == OpCode::MEM_LOAD) return unsafe(in.b, in.mode & B_IMM);
+    if (in.op == OpCode::MEM_COPY || in.op == OpCode::MEM_FILL)
+        return unsafe(in.a, in.mode & A_IMM) || unsafe(in.b, in.mode & B_IMM) || unsafe(in.c, in.mode & C_IMM);
+    return false;
+}
+
+void transfer(State& s, const Instr& in) {
+    // A register that was read without throwing is defined from then on.
+    auto touch = [&](int32_t value, bool immediate) {
+        if (!immediate) s.regs[value].def = DEF_YES;
+    };
+    switch (in.op) {
+        case OpCode::LOAD: case OpCode::ADD: case OpCode::SUB:
+        case OpCode::MUL: case OpCode::DIV: {
+            Known lhs = s.regs[in.a];
+            Known rhs = operand(s, in.b, in.mode & B_IMM);
+            touch(in.b, in.mode & B_IMM);
+            Known result{DEF_YES, false, 0};
+            if (rhs.constant && (in.op == OpCode::LOAD || lhs.constant) &&
+                fold(in.op, lhs.value, rhs.value, result.value))
+                result.constant = true;
+            s.regs[in.a] = result;
+            break;
+        }
+        case OpCode::CMP: {
+            Known lhs = operand(s, in.a, in.mode & A_IMM);
+            Known rhs = operand(s, in.b, in.mode & B_IMM);
+            touch(in.a, in.mode & A_IMM);
+            touch(in.b, in.mode & B_IMM);
+            s.flags_constant = lhs.constant && rhs.constant;
+            s.equal = lhs.value == rhs.value;
+            s.less = lhs.value < rhs.value;
+            s.greater = lhs.value > rhs.value;
+            break;
+        }
+        case OpCode::PRINT: case OpCode::PUSH: case OpCode::VBROADCAST: case OpCode::VSET:
+            touch(in.b, in.mode & B_IMM);
+            break;
+        case OpCode::READ: case OpCode::POP: case OpCode::VSUM: case OpCode::VMIN: case OpCode::VMAX:
+            s.regs[in.a] = Known{DEF_YES, false, 0};
+            break;
+        case OpCode::VCMP:
+            s.flags_constant = false;
+            break;
+        case OpCode::MEM_LOAD:
+            touch(in.b, in.mode & B_IMM);
+            s.regs[in.a] = Known{DEF_YES, false, 0};
+            break;
+        case OpCode::MEM_STORE:
+            touch(in.a, in.mode & A_IMM);
+            touch(in.b, in.mode & B_IMM);
+            break;
+        case OpCode::MEM_COPY: case OpCode::MEM_FILL:
+            touch(in.a, in.mode & A_IMM);
+            touch(in.b, in.mode & B_IMM);
+            touch(in.c, in.mode & C_IMM);
+            break;
+        default:
+            break;
+    }
+}
+
+bool merge_into(State& dst, const State& src) {
+    if (!dst.reached) {
+        dst = src;
+        return true;
+    }
+    bool changed = false;
+    for (size_t i = 0; i < dst.regs.size(); ++i) {
+        Known& d = dst.regs[i];
+        const Known& s = src.regs[i];
+        if (d.def != s.def && d.def != DEF_MAYBE) {
+            d.def = DEF_MAYBE;
+            changed = true;
+        }
+        if (d.constant && (!s.constant || s.value != d.value)) {
+            d.constant = false;
+            changed = true;
+        }
+    }
+    if (dst.flags_constant && (!src.flags_constant || src.equal != dst.equal ||
+                               src.less != dst.less || src.greater != dst.greater)) {
+        dst.flags_constant = false;
+        changed = true;
+    }
+    return changed;
+}
+
+// Forward dataflow to a fixed point, following only the feasible edge of
+// branches on known flags. Returns the state on entry to every block.
+std::vector<State> analyze(const IRProgram& program, bool open_registers) {
+    const size_t n = program.blocks.size();
+    std::vector<State> in(n);
+    if (n == 0) return in;
+
+    State entry;
+    entry.reached = true;
+    entry.regs.assign(program.registers.size(),
+                      open_registers ? Known{DEF_MAYBE, false, 0} : Known{DEF_NO, true, 0});
+    in[0] = entry;
+
+    std::vector<size_t> work{0};
+    std::vector<bool> queued(n, false);
+    queued[0] = true;
+    while (!work.empty()) {
+        size_t id = work.back();
+        work.pop_back();
+        queued[id] = false;
+
+        const BasicBlock& b = program.blocks[id];
+        State s = in[id];
+        for (const Instr& ins : b.body)
+            transfer(s, ins);
+
+        std::vector<size_t> succ;
+        if (is_conditional(b.branch) && s.flags_constant)
+            succ.push_back(taken(b.branch, s) ? b.target : b.next);
+        else
+            succ = program.successors(id);
+
+        for (size_t next : succ) {
+            if (next >= n) continue;
+            if (merge_into(in[next], s) && !queued[next]) {
+                queued[next] = true;
+                work.push_back(next);
+            }
+        }
+    }
+    return in;
+}
+
+bool analysis_fits(const IRProgram& program) {
+    size_t regs = program.registers.size() ? program.registers.size() : 1;
+    return program.blocks.size() <= Optimizer::MAX_ANALYSIS_CELLS / regs;
+}
+
+} // namespace
+
+void Optimizer::optimize(IRProgram& program) {
+    counters = Stats();
+    // Each pass can expose work for the others; a few rounds reach the
+    // fixed point on everything we have seen.
+    for (int round = 0; round < 4; ++round) {
+        bool changed = propagate_constants(program);
+        changed |= remove_unreachable(program);
+        changed |= eliminate_dead_stores(program);
+        if (!changed) break;
+    }
+}
+
+bool Optimizer::propagate_constants(IRProgram& program) {
+    if (!analysis_fits(program)) return false;
+    std::vector<State> in = analyze(program, open_registers);
+    bool changed = false;
+
+    for (size_t id = 0; id < program.blocks.size(); ++id) {
+        if (!in[id].reached) continue;
+        BasicBlock& b = program.blocks[id];
+        State s = in[id];
+
+        for (Instr& ins : b.body) {
+            auto propagate = [&](int32_t& value, uint8_t bit) {
+                if (ins.mode & bit) return;
+                const Known& k = s.regs[value];
+                if (k.def != DEF_YES || !k.constant) return;
+                value = k.value;
+                ins.mode |= bit;
+                ++counters.operands_propagated;
+                changed = true;
+            };
+            if (is_arith(ins.op) || ins.op == OpCode::PRINT || ins.op == OpCode::PUSH ||
+                reads_scalar(ins.op) || ins.op == OpCode::MEM_LOAD) {
+                propagate(ins.b, B_IMM);
+            } else if (ins.op == OpCode::CMP || ins.op == OpCode::MEM_STORE) {
+                propagate(ins.a, A_IMM);
+                propagate(ins.b, B_IMM);
+            } else if (ins.op == OpCode::MEM_COPY || ins.op == OpCode::MEM_FILL) {
+                propagate(ins.a, A_IMM);
+                propagate(ins.b, B_IMM);
+                propagate(ins.c, C_IMM);
+            }
+
+            int32_t value = 0;
+            if (is_arith(ins.op) && ins.op != OpCode::LOAD && (ins.mode & B_IMM) &&
+                s.regs[ins.a].constant && fold(ins.op, s.regs[ins.a].value, ins.b, value)) {
+                ins = Instr{OpCode::LOAD, B_IMM, ins.a, value};
+                ++counters.instructions_folded;
+                changed = true;
+            }
+            transfer(s, ins);
+        }
+
+        if (is_conditional(b.branch) && s.flags_constant) {
+            b.branch = taken(b.branch, s) ? OpCode::JMP : OpCode::NOP;
+            ++counters.branches_resolved;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool Optimizer::remove_unreachable(IRProgram& program) {
+    const size_t n = program.blocks.size();
+    std::vector<bool> seen(n, false);
+    std::vector<size_t> work{0};
+    if (n) seen[0] = true;
+    while (!work.empty()) {
+        size_t id = work.back();
+        work.pop_back();
+        for (size_t next : program.successors(id)) {
+            if (next < n && !seen[next]) {
+                seen[next] = true;
+                work.push_back(next);
+            }
+        }
+    }
+
+    std::vector<size_t> remap(n + 1, 0);
+    size_t kept = 0;
+    for (size_t id = 0; id < n; ++id)
+        if (seen[id]) remap[id] = kept++;
+    if (kept == n) return false;
+    remap[n] = kept;
+
+    std::vector<BasicBlock> blocks;
+    blocks.reserve(kept);
+    for (size_t id = 0; id < n; ++id) {
+        if (!seen[id]) continue;
+        BasicBlock& b = program.blocks[id];
+        b.target = remap[b.target];
+        b.next = remap[b.next];
+        blocks.push_back(std::move(b));
+    }
+    counters.blocks_removed += n - kept;
+    program.blocks = std::move(blocks);
+    return true;
+}
+
+bool Optimizer::eliminate_dead_stores(IRProgram& program) {
+    const size_t n = program.blocks.size();
+    const size_t regs = program.registers.size();
+    const size_t flags_bit = regs;
+    const size_t words = (regs + 1 + 63) / 64;
+    using Bits = std::vector<uint64_t>;
+    auto test = [](const Bits& bits, size_t i) { return (bits[i / 64] >> (i % 64)) & 1; };
+    auto set = [](Bits& bits, size_t i) { bits[i / 64] |= uint64_t(1) << (i % 64); };
+    auto clear = [](Bits& bits, size_t i) { bits[i / 64] &= ~(uint64_t(1) << (i % 64)); };
+
+    auto add_reads = [&](Bits& live, const Instr& in) {
+        if (is_arith(in.op)) {
+            if (in.op != OpCode::LOAD) set(live, in.a);
+            if (!(in.mode & B_IMM)) set(live, in.b);
+        } else if (in.op == OpCode::CMP || in.op == OpCode::MEM_STORE) {
+            if (!(in.mode & A_IMM)) set(live, in.a);
+            if (!(in.mode & B_IMM)) set(live, in.b);
+        } else if ((in.op == OpCode::PRINT || in.op == OpCode::PUSH || reads_scalar(in.op) ||
+                    in.op == OpCode::MEM_LOAD) && !(in.mode & B_IMM)) {
+            set(live, in.b);
+        } else if (in.op == OpCode::MEM_COPY || in.op == OpCode::MEM_FILL) {
+            if (!(in.mode & A_IMM)) set(live, in.a);
+            if (!(in.mode & B_IMM)) set(live, in.b);
+            if (!(in.mode & C_IMM)) set(live, in.c);
+        }
+    };
+    auto step_back = [&](Bits& live, const Instr& in) {
+        if (is_arith(in.op) || in.op == OpCode::READ || in.op == OpCode::POP || in.op == OpCode::MEM_LOAD ||
+            writes_scalar(in.op))
+            clear(live, in.a);
+        if (in.op == OpCode::CMP || in.op == OpCode::VCMP) clear(live, flags_bit);
+        add_reads(live, in);
+    };
+    auto live_out = [&](const std::vector<Bits>& live_in, size_t id) {
+        Bits live(words, 0);
+        for (size_t next : program.successors(id)) {
+            if (next < n)
+                for (size_t w = 0; w < words; ++w) live[w] |= live_in[next][w];
+            else if (open_registers)
+                for (size_t r = 0; r < regs; ++r) set(live, r);
+        }
+        if (is_conditional(program.blocks[id].branch)) set(live, flags_bit);
+        return live;
+    };
+
+    // Backward liveness to a fixed point.
+    std::vector<Bits> live_in(n, Bits(words, 0));
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t id = n; id-- > 0;) {
+            Bits live = live_out(live_in, id);
+            const auto& body = program.blocks[id].body;
+            for (size_t i = body.size(); i-- > 0;)
+                step_back(live, body[i]);
+            if (live != live_in[id]) {
+                live_in[id] = std::move(live);
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<State> in;
+    if (analysis_fits(program)) in = analyze(program, open_registers);
+
+    bool removed_any = false;
+    for (size_t id = 0; id < n; ++id) {
+        auto& body = program.blocks[id].body;
+
+        // Which instructions could throw on an undefined register.
+        std::vector<bool> throws(body.size(), true);
+        if (!in.empty()) {
+            State s = in[id];
+            for (size_t i = 0; i < body.size(); ++i) {
+                throws[i] = may_throw(s, body[i]);
+                if (s.reached) transfer(s, body[i]);
+            }
+        }
+
+        Bits live = live_out(live_in, id);
+        std::vector<bool> dead(body.size(), false);
+        for (size_t i = body.size(); i-- > 0;) {
+            const Instr& ins = body[i];
+            bool unused = (is_arith(ins.op) && !test(live, ins.a)) ||
+                          (ins.op == OpCode::CMP && !test(live, flags_bit));
+            if (unused && !throws[i]) {
+                dead[i] = true;
+                continue;
+            }
+            step_back(live, ins);
+        }
+
+        auto& locations = program.blocks[id].locations;
+        size_t out = 0;
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (dead[i]) continue;
+            body[out] = body[i];
+            locations[out] = locations[i];
+            ++out;
+        }
+        if (out != body.size()) {
+            counters.stores_removed += body.size() - out;
+            body.resize(out);
+            locations.resize(out);
+            removed_any = true;
+        }
+    }
+    return removed_any;
+}
+
+void Optimizer::dump_stats(std::ostream& out) const {
+    out << "; " << counters.operands_propagated << " operand(s) propagated, "
+        << counters.instructions_folded << " folded, "
+        << counters.branches_resolved << " branch(es) resolved, "
+        << counters.blocks_removed << " block(s) removed, "
+        << counters.stores_removed << " dead store(s) removed\n";
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "ir.hpp"
+
+// IR optimizations:
+//   - constant folding and propagation across blocks (conditional: edges
+//     out of a branch on known flags are never followed)
+//   - removal of unreachable blocks
+//   - dead-store elimination for values that are never read
+// Register reads that can raise "Unknown register" are never folded away
+// or removed, so failing programs fail at the same point as before.
+class Optimizer {
+public:
+    struct Stats {
+        size_t operands_propagated = 0;
+        size_t instructions_folded = 0;
+        size_t branches_resolved = 0;
+        size_t blocks_removed = 0;
+        size_t stores_removed = 0;
+    };
+
+    Optimizer() = default;
+    // With open registers the caller may preset registers before a run and
+    // read them afterwards, so nothing is assumed about their values on
+    // entry and every store that reaches the end of the program is kept.
+    explicit Optimizer(bool open_registers) : open_registers(open_registers) {}
+
+    void optimize(IRProgram& program);
+    const Stats& stats() const { return counters; }
+    void dump_stats(std::ostream& out) const;
+
+    // The analysis keeps one state per register per block; beyond this many
+    // cells constant propagation is skipped.
+    static constexpr size_t MAX_ANALYSIS_CELLS = size_t(1) << 25;
+
+private:
+    Stats counters;
+    bool open_registers = false;
+
+    bool propagate_constants(IRProgram& program);
+    bool remove_unreachable(IRProgram& program);
+    bool eliminate_dead_stores(IRProgram& program);
+};
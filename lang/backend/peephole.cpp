@@ -0,0 +1,63 @@
+#include "peephole.hpp"
+#include <map>
+
+OpCode Peephole::fuse_pair(const Instr& first, const Instr& second) {
+    if (first.op == OpCode::CMP) {
+        switch (second.op) {
+            case OpCode::JE: return OpCode::CMP_JE;
+            case OpCode::JNE: return OpCode::CMP_JNE;
+            case OpCode::JL: return OpCode::CMP_JL;
+            case OpCode::JG: return OpCode::CMP_JG;
+            case OpCode::JLE: return OpCode::CMP_JLE;
+            case OpCode::JGE: return OpCode::CMP_JGE;
+            default: return OpCode::NOP;
+        }
+    }
+    if (first.op == OpCode::LOAD && (first.mode & B_IMM) && second.a == first.a) {
+        switch (second.op) {
+            case OpCode::ADD: return OpCode::LOAD_ADD;
+            case OpCode::SUB: return OpCode::LOAD_SUB;
+            case OpCode::MUL: return OpCode::LOAD_MUL;
+            case OpCode::DIV: return OpCode::LOAD_DIV;
+            default: return OpCode::NOP;
+        }
+    }
+    return OpCode::NOP;
+}
+
+void Peephole::optimize(Program& program) {
+    applied.clear();
+    auto& code = program.code;
+
+    for (size_t i = 0; i < code.size(); ++i) {
+        Instr& in = code[i];
+        if (i + 1 < code.size()) {
+            OpCode fused = fuse_pair(in, code[i + 1]);
+            if (fused != OpCode::NOP) {
+                applied.push_back({i, in.op, code[i + 1].op, fused});
+                in.op = fused;
+                continue;
+            }
+        }
+        if ((in.op == OpCode::ADD || in.op == OpCode::SUB) && (in.mode & B_IMM)) {
+            OpCode fused = in.op == OpCode::ADD ? OpCode::ADD_IMM : OpCode::SUB_IMM;
+            applied.push_back({i, in.op, OpCode::NOP, fused});
+            in.op = fused;
+        }
+    }
+}
+
+void Peephole::dump(std::ostream& out) const {
+    std::map<std::string, size_t> totals;
+    for (const Fusion& f : applied) {
+        std::string pattern = opcode_name(f.first);
+        if (f.second != OpCode::NOP)
+            pattern += std::string(" + ") + opcode_name(f.second);
+        pattern += std::string(" -> ") + opcode_name(f.fused);
+        out << "  " << f.index << ": " << pattern << "\n";
+        ++totals[pattern];
+    }
+    out << "Peephole: " << applied.size() << " rewrite(s)\n";
+    for (const auto& [pattern, count] : totals)
+        out << "  " << count << " x " << pattern << "\n";
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <ostream>
+#include <vector>
+
+#include "bytecode.hpp"
+
+// Rewrites common instruction patterns into superinstructions:
+//   cmp x, y ; jcc L        -> cmp_jcc  (compare and branch)
+//   add r, imm / sub r, imm -> add_imm / sub_imm
+//   let r = imm ; op r, x   -> load_op  (op is add, sub, mul or div)
+// A fused pair keeps its second instruction in place, so jump targets do
+// not move and a jump into the middle of a pair still runs the original.
+class Peephole {
+public:
+    struct Fusion {
+        size_t index;
+        OpCode first;
+        OpCode second; // NOP for single-instruction rewrites
+        OpCode fused;
+    };
+
+    void optimize(Program& program);
+    const std::vector<Fusion>& fusions() const { return applied; }
+    void dump(std::ostream& out) const;
+
+private:
+    std::vector<Fusion> applied;
+
+    static OpCode fuse_pair(const Instr& first, const Instr& second);
+};
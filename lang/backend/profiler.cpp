@@ -0,0 +1,144 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <sys/time.h>
+
+#include "ir.hpp"
+
+namespace {
+
+Profiler* volatile active = nullptr;
+
+void set_timer(long interval_us) {
+    itimerval timer{};
+    timer.it_interval.tv_usec = interval_us;
+    timer.it_value.tv_usec = interval_us;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+}
+
+bool is_conditional(OpCode op) {
+    return op >= OpCode::JE && op <= OpCode::JGE;
+}
+
+} // namespace
+
+void Profiler::on_sample(int) {
+    Profiler* p = active;
+    if (!p) return;
+    size_t at = p->current;
+    if (at < p->samples.size()) ++p->samples[at];
+}
+
+void Profiler::start(size_t size) {
+    counts.assign(size + 1, 0);
+    taken.assign(size + 1, 0);
+    samples.assign(size + 1, 0);
+    current = size;
+    if (!sampling) return;
+    active = this;
+    std::signal(SIGPROF, &Profiler::on_sample);
+    set_timer(SAMPLE_INTERVAL_US);
+}
+
+void Profiler::stop() {
+    if (!sampling) return;
+    set_timer(0);
+    std::signal(SIGPROF, SIG_DFL);
+    active = nullptr;
+}
+
+void Profiler::report(const Program& program, std::ostream& out, size_t top) const {
+    const size_t n = std::min(program.code.size(), counts.size());
+    uint64_t total = 0, total_samples = 0;
+    for (size_t i = 0; i < n; ++i) {
+        total += counts[i];
+        total_samples += samples[i];
+    }
+    auto where = [&](size_t i) {
+        if (i >= program.locations.size() || program.locations[i].line == 0) return std::string("-");
+        return std::to_string(program.locations[i].line) + ":" + std::to_string(program.locations[i].column);
+    };
+    char line[256];
+
+    std::snprintf(line, sizeof(line), "Profile: %llu instructions executed, %llu samples every %ld us\n",
+                  static_cast<unsigned long long>(total), static_cast<unsigned long long>(total_samples),
+                  SAMPLE_INTERVAL_US);
+    out << line;
+
+    // Hottest instructions, by sampled time and then by count.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < n; ++i)
+        if (counts[i]) order.push_back(i);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (samples[a] != samples[b]) return samples[a] > samples[b];
+        return counts[a] > counts[b];
+    });
+    out << "\nHot instructions:\n     %time      %count         count  where     instruction\n";
+    for (size_t k = 0; k < order.size() && k < top; ++k) {
+        size_t i = order[k];
+        std::snprintf(line, sizeof(line), "  %7.2f%%  %9.2f%%  %12llu  %-8s  @%zu %s\n",
+                      percent(samples[i], total_samples), percent(counts[i], total),
+                      static_cast<unsigned long long>(counts[i]), where(i).c_str(), i,
+                      describe(program.code[i], program.registers, program.messages).c_str());
+        out << line;
+    }
+
+    // Label regions: every instruction belongs to the last label before it.
+    struct Region {
+        std::string where;
+        uint64_t count = 0;
+        uint64_t samples = 0;
+    };
+    std::map<std::string, Region> regions;
+    size_t next_label = 0;
+    std::string region = "<entry>";
+    std::string region_where = where(0);
+    for (size_t i = 0; i < n; ++i) {
+        while (next_label < program.labels.size() && program.labels[next_label].first <= i) {
+            region = program.labels[next_label].second;
+            region_where = where(i);
+            ++next_label;
+        }
+        Region& r = regions[region];
+        if (r.where.empty()) r.where = region_where;
+        r.count += counts[i];
+        r.samples += samples[i];
+    }
+    std::vector<std::pair<std::string, Region>> by_region(regions.begin(), regions.end());
+    std::sort(by_region.begin(), by_region.end(), [](const auto& a, const auto& b) {
+        if (a.second.samples != b.second.samples) return a.second.samples > b.second.samples;
+        return a.second.count > b.second.count;
+    });
+    out << "\nLabel regions:\n     %time      %count         count  where     label\n";
+    for (size_t k = 0; k < by_region.size() && k < top; ++k) {
+        const auto& [name, r] = by_region[k];
+        if (!r.count) continue;
+        std::snprintf(line, sizeof(line), "  %7.2f%%  %9.2f%%  %12llu  %-8s  %s\n",
+                      percent(r.samples, total_samples), percent(r.count, total),
+                      static_cast<unsigned long long>(r.count), r.where.c_str(), name.c_str());
+        out << line;
+    }
+
+    // Conditional branches by how often they were reached.
+    std::vector<size_t> branches;
+    for (size_t i = 0; i < n; ++i)
+        if (counts[i] && is_conditional(program.code[i].op)) branches.push_back(i);
+    std::sort(branches.begin(), branches.end(), [&](size_t a, size_t b) { return counts[a] > counts[b]; });
+    out << "\nBranches:\n         taken     not taken   %taken  where     instruction\n";
+    for (size_t k = 0; k < branches.size() && k < top; ++k) {
+        size_t i = branches[k];
+        std::snprintf(line, sizeof(line), "  %12llu  %12llu  %6.1f%%  %-8s  @%zu %s\n",
+                      static_cast<unsigned long long>(taken[i]),
+                      static_cast<unsigned long long>(counts[i] - taken[i]),
+                      percent(taken[i], counts[i]), where(i).c_str(), i,
+                      describe(program.code[i], program.registers, program.messages).c_str());
+        out << line;
+    }
+}
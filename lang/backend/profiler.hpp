@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "bytecode.hpp"
+
+// Execution profile for one VM run. The VM counts every executed
+// instruction and every taken branch; time is sampled with a SIGPROF
+// interval timer that records which instruction was executing. The report
+// groups the numbers per instruction, per label region (the code from one
+// label up to the next) and per conditional branch.
+class Profiler {
+public:
+    static constexpr long SAMPLE_INTERVAL_US = 1000;
+
+    // Without sampling only the counts are kept (for --stats).
+    explicit Profiler(bool sampling = true) : sampling(sampling) {}
+
+    // Resets the counters for a program of `size` instructions and starts
+    // sampling. Only one profiler can be active at a time.
+    void start(size_t size);
+    void stop();
+
+    void report(const Program& program, std::ostream& out, size_t top = 20) const;
+
+    // Updated by the VM; sized one past the program for the end sentinel.
+    std::vector<uint64_t> counts;
+    std::vector<uint64_t> taken;
+    std::vector<uint64_t> samples;
+    volatile size_t current = 0;
+
+private:
+    bool sampling;
+
+    static void on_sample(int);
+};
@@ -0,0 +1,45 @@
+#include "scheduler.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+Scheduler::Scheduler(SchedulerOptions options)
+    : options(options) {}
+
+void Scheduler::add(Execution& exec) {
+    if (!exec.done()) queue.push_back(&exec);
+}
+
+void Scheduler::run() {
+    std::mutex lock;
+    std::condition_variable wake;
+    size_t running = 0; // executions taken off the queue and not yet put back
+
+    auto work = [&] {
+        VM vm(options.buffer);
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;) {
+            // An empty queue only means the end once nobody can requeue.
+            wake.wait(guard, [&] { return !queue.empty() || running == 0; });
+            if (queue.empty()) break;
+            Execution* exec = queue.front();
+            queue.pop_front();
+            ++running;
+            guard.unlock();
+
+            vm.resume(*exec, options.quantum, options.time_quantum, options.dispatch);
+
+            guard.lock();
+            --running;
+            ++total_turns;
+            if (!exec->done()) queue.push_back(exec);
+            wake.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < options.threads; ++t)
+        threads.emplace_back(work);
+    work();
+    for (auto& t : threads) t.join();
+}
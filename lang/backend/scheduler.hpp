@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "io.hpp"
+#include "vm.hpp"
+
+// Round-robin scheduler that multiplexes many executions over a few
+// threads. Every turn an execution runs for one quantum on whichever
+// worker picked it up and then goes to the back of a shared FIFO queue,
+// until it finishes or fails. Each worker has its own VM.
+struct SchedulerOptions {
+    size_t threads = 1;
+    uint64_t quantum = 10000;               // instructions per turn
+    std::chrono::nanoseconds time_quantum{0}; // also ends a turn when non-zero
+    Dispatch dispatch = Dispatch::SWITCH;
+    BufferMode buffer = BufferMode::BLOCK;
+};
+
+class Scheduler {
+public:
+    explicit Scheduler(SchedulerOptions options);
+
+    // The execution must stay alive until run() returns.
+    void add(Execution& exec);
+
+    // Runs until every added execution has finished or failed.
+    void run();
+
+    uint64_t turns() const { return total_turns; }
+
+private:
+    SchedulerOptions options;
+    std::deque<Execution*> queue;
+    uint64_t total_turns = 0;
+};
@@ -0,0 +1,276 @@
+#include "simd.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ASMPLE_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define ASMPLE_SIMD_X86 0
+#endif
+
+namespace {
+
+uint32_t lane(const Vector& v, size_t i) {
+    return static_cast<uint32_t>(v.lanes[i]);
+}
+
+void scalar_add(Vector& dst, const Vector& src) {
+    for (size_t i = 0; i < VECTOR_LANES; ++i)
+        dst.lanes[i] = static_cast<int32_t>(lane(dst, i) + lane(src, i));
+}
+
+void scalar_sub(Vector& dst, const Vector& src) {
+    for (size_t i = 0; i < VECTOR_LANES; ++i)
+        dst.lanes[i] = static_cast<int32_t>(lane(dst, i) - lane(src, i));
+}
+
+void scalar_mul(Vector& dst, const Vector& src) {
+    for (size_t i = 0; i < VECTOR_LANES; ++i)
+        dst.lanes[i] = static_cast<int32_t>(lane(dst, i) * lane(src, i));
+}
+
+void scalar_broadcast(Vector& dst, int32_t value) {
+    for (size_t i = 0; i < VECTOR_LANES; ++i)
+        dst.lanes[i] = value;
+}
+
+int32_t scalar_sum(const Vector& v) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < VECTOR_LANES; ++i)
+        total += lane(v, i);
+    return static_cast<int32_t>(total);
+}
+
+int32_t scalar_min(const Vector& v) {
+    int32_t result = v.lanes[0];
+    for (size_t i = 1; i < VECTOR_LANES; ++i)
+        if (v.lanes[i] < result) result = v.lanes[i];
+    return result;
+}
+
+int32_t scalar_max(const Vector& v) {
+    int32_t result = v.lanes[0];
+    for (size_t i = 1; i < VECTOR_LANES; ++i)
+        if (v.lanes[i] > result) result = v.lanes[i];
+    return result;
+}
+
+int scalar_compare(const Vector& lhs, const Vector& rhs) {
+    for (size_t i = 0; i < VECTOR_LANES; ++i)
+        if (lhs.lanes[i] != rhs.lanes[i]) return lhs.lanes[i] < rhs.lanes[i] ? -1 : 1;
+    return 0;
+}
+
+void scalar_fill(int32_t* dst, int32_t value, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = value;
+}
+
+const VectorKernels SCALAR = {
+    "scalar", scalar_add, scalar_sub, scalar_mul, scalar_broadcast,
+    scalar_sum, scalar_min, scalar_max, scalar_compare, scalar_fill
+};
+
+#if ASMPLE_SIMD_X86
+
+// Decides a comparison from a mask with one bit per equal lane.
+int compare_at(const Vector& lhs, const Vector& rhs, unsigned equal_lanes) {
+    unsigned differ = ~equal_lanes & ((1u << VECTOR_LANES) - 1);
+    if (!differ) return 0;
+    size_t i = static_cast<size_t>(__builtin_ctz(differ));
+    return lhs.lanes[i] < rhs.lanes[i] ? -1 : 1;
+}
+
+// SSE4.1: each vector is two 128-bit halves.
+#define SSE4 __attribute__((target("sse4.1")))
+
+SSE4 __m128i load_half(const Vector& v, size_t half) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(v.lanes) + half);
+}
+
+SSE4 void store_half(Vector& v, size_t half, __m128i value) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(v.lanes) + half, value);
+}
+
+SSE4 void sse4_add(Vector& dst, const Vector& src) {
+    for (size_t h = 0; h < 2; ++h)
+        store_half(dst, h, _mm_add_epi32(load_half(dst, h), load_half(src, h)));
+}
+
+SSE4 void sse4_sub(Vector& dst, const Vector& src) {
+    for (size_t h = 0; h < 2; ++h)
+        store_half(dst, h, _mm_sub_epi32(load_half(dst, h), load_half(src, h)));
+}
+
+SSE4 void sse4_mul(Vector& dst, const Vector& src) {
+    for (size_t h = 0; h < 2; ++h)
+        store_half(dst, h, _mm_mullo_epi32(load_half(dst, h), load_half(src, h)));
+}
+
+SSE4 void sse4_broadcast(Vector& dst, int32_t value) {
+    __m128i all = _mm_set1_epi32(value);
+    store_half(dst, 0, all);
+    store_half(dst, 1, all);
+}
+
+SSE4 int32_t sse4_sum(const Vector& v) {
+    __m128i s = _mm_add_epi32(load_half(v, 0), load_half(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+SSE4 int32_t sse4_min(const Vector& v) {
+    __m128i s = _mm_min_epi32(load_half(v, 0), load_half(v, 1));
+    s = _mm_min_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_min_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+SSE4 int32_t sse4_max(const Vector& v) {
+    __m128i s = _mm_max_epi32(load_half(v, 0), load_half(v, 1));
+    s = _mm_max_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_max_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+SSE4 int sse4_compare(const Vector& lhs, const Vector& rhs) {
+    unsigned low = static_cast<unsigned>(_mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(load_half(lhs, 0), load_half(rhs, 0)))));
+    unsigned high = static_cast<unsigned>(_mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(load_half(lhs, 1), load_half(rhs, 1)))));
+    return compare_at(lhs, rhs, low | (high << 4));
+}
+
+SSE4 void sse4_fill(int32_t* dst, int32_t value, size_t count) {
+    __m128i all = _mm_set1_epi32(value);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), all);
+    for (; i < count; ++i)
+        dst[i] = value;
+}
+
+#undef SSE4
+
+const VectorKernels SSE4_KERNELS = {
+    "sse4", sse4_add, sse4_sub, sse4_mul, sse4_broadcast,
+    sse4_sum, sse4_min, sse4_max, sse4_compare, sse4_fill
+};
+
+// AVX2: one 256-bit register per vector; reductions fold down to 128 bits.
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 __m256i load(const Vector& v) {
+    return _mm256_load_si256(reinterpret_cast<const __m256i*>(v.lanes));
+}
+
+AVX2 void store(Vector& v, __m256i value) {
+    _mm256_store_si256(reinterpret_cast<__m256i*>(v.lanes), value);
+}
+
+AVX2 void avx2_add(Vector& dst, const Vector& src) {
+    store(dst, _mm256_add_epi32(load(dst), load(src)));
+}
+
+AVX2 void avx2_sub(Vector& dst, const Vector& src) {
+    store(dst, _mm256_sub_epi32(load(dst), load(src)));
+}
+
+AVX2 void avx2_mul(Vector& dst, const Vector& src) {
+    store(dst, _mm256_mullo_epi32(load(dst), load(src)));
+}
+
+AVX2 void avx2_broadcast(Vector& dst, int32_t value) {
+    store(dst, _mm256_set1_epi32(value));
+}
+
+AVX2 int32_t avx2_sum(const Vector& v) {
+    __m256i all = load(v);
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(all), _mm256_extracti128_si256(all, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+AVX2 int32_t avx2_min(const Vector& v) {
+    __m256i all = load(v);
+    __m128i s = _mm_min_epi32(_mm256_castsi256_si128(all), _mm256_extracti128_si256(all, 1));
+    s = _mm_min_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_min_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+AVX2 int32_t avx2_max(const Vector& v) {
+    __m256i all = load(v);
+    __m128i s = _mm_max_epi32(_mm256_castsi256_si128(all), _mm256_extracti128_si256(all, 1));
+    s = _mm_max_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_max_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+AVX2 int avx2_compare(const Vector& lhs, const Vector& rhs) {
+    unsigned equal = static_cast<unsigned>(_mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(load(lhs), load(rhs)))));
+    return compare_at(lhs, rhs, equal);
+}
+
+AVX2 void avx2_fill(int32_t* dst, int32_t value, size_t count) {
+    __m256i all = _mm256_set1_epi32(value);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), all);
+    for (; i < count; ++i)
+        dst[i] = value;
+}
+
+#undef AVX2
+
+const VectorKernels AVX2_KERNELS = {
+    "avx2", avx2_add, avx2_sub, avx2_mul, avx2_broadcast,
+    avx2_sum, avx2_min, avx2_max, avx2_compare, avx2_fill
+};
+
+#endif
+
+const VectorKernels* detect() {
+#if ASMPLE_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &AVX2_KERNELS;
+    if (__builtin_cpu_supports("sse4.1")) return &SSE4_KERNELS;
+#endif
+    return &SCALAR;
+}
+
+const VectorKernels*& active() {
+    static const VectorKernels* kernels = detect();
+    return kernels;
+}
+
+} // namespace
+
+const VectorKernels& vector_kernels() {
+    return *active();
+}
+
+bool select_vector_kernels(std::string_view name) {
+    if (name == "auto") {
+        active() = detect();
+        return true;
+    }
+    if (name == "scalar") {
+        active() = &SCALAR;
+        return true;
+    }
+#if ASMPLE_SIMD_X86
+    __builtin_cpu_init();
+    if (name == "sse4" && __builtin_cpu_supports("sse4.1")) {
+        active() = &SSE4_KERNELS;
+        return true;
+    }
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+        active() = &AVX2_KERNELS;
+        return true;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "../common/vector.hpp"
+
+// Kernels behind the vector instructions. Every variant gives the same
+// results (32-bit wrap-around lanes); the widest one the CPU supports is
+// picked on first use.
+struct VectorKernels {
+    const char* name;
+    void (*add)(Vector& dst, const Vector& src);
+    void (*sub)(Vector& dst, const Vector& src);
+    void (*mul)(Vector& dst, const Vector& src);
+    void (*broadcast)(Vector& dst, int32_t value);
+    int32_t (*sum)(const Vector& v);
+    int32_t (*min)(const Vector& v);
+    int32_t (*max)(const Vector& v);
+    // Lane by lane from lane 0; the first lane that differs decides.
+    // Returns -1, 0 or 1.
+    int (*compare)(const Vector& lhs, const Vector& rhs);
+    // memset for 32-bit words (no alignment needed).
+    void (*fill)(int32_t* dst, int32_t value, size_t count);
+};
+
+const VectorKernels& vector_kernels();
+// Forces "scalar", "sse4" or "avx2" ("auto" re-detects). Returns false for
+// an unknown name or one this CPU cannot run.
+bool select_vector_kernels(std::string_view name);
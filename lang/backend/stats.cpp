@@ -0,0 +1,211 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
+
+#include "../common/probes.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#define ASMPLE_PERF_EVENTS 1
+#endif
+#endif
+#ifndef ASMPLE_PERF_EVENTS
+#define ASMPLE_PERF_EVENTS 0
+#endif
+
+namespace {
+
+uint64_t now_ns(clockid_t clock) {
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+const char* const COUNTER_NAMES[] = {"cycles", "branch_misses", "cache_misses"};
+
+#if ASMPLE_PERF_EVENTS
+// Counts user-space events of this process on any CPU.
+int open_counter(uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+// Register operands each instruction reads and writes.
+void register_operands(const Instr& in, uint64_t& reads, uint64_t& writes) {
+    auto reg = [](bool immediate) -> uint64_t { return immediate ? 0 : 1; };
+    reads = writes = 0;
+    switch (in.op) {
+        case OpCode::LOAD: case OpCode::MEM_LOAD:
+            reads = reg(in.mode & B_IMM);
+            writes = 1;
+            break;
+        case OpCode::ADD: case OpCode::SUB: case OpCode::MUL: case OpCode::DIV:
+            reads = 1 + reg(in.mode & B_IMM);
+            writes = 1;
+            break;
+        case OpCode::CMP: case OpCode::MEM_STORE:
+            reads = reg(in.mode & A_IMM) + reg(in.mode & B_IMM);
+            break;
+        case OpCode::MEM_COPY: case OpCode::MEM_FILL:
+            reads = reg(in.mode & A_IMM) + reg(in.mode & B_IMM) + reg(in.mode & C_IMM);
+            break;
+        case OpCode::PRINT: case OpCode::PUSH: case OpCode::VBROADCAST: case OpCode::VSET:
+            reads = reg(in.mode & B_IMM);
+            break;
+        case OpCode::READ: case OpCode::POP: case OpCode::VSUM: case OpCode::VMIN: case OpCode::VMAX:
+            writes = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+} // namespace
+
+ExecutionCounts ExecutionCounts::from_profile(const Program& program, const Profiler& profiler) {
+    ExecutionCounts result;
+    const size_t n = std::min(program.code.size(), profiler.counts.size());
+    for (size_t i = 0; i < n; ++i) {
+        const Instr& in = program.code[i];
+        const uint64_t count = profiler.counts[i];
+        result.instructions += count;
+        if (in.op == OpCode::JMP || in.op == OpCode::CALL || in.op == OpCode::RET) {
+            result.jumps_taken += count;
+        } else if (in.op >= OpCode::JE && in.op <= OpCode::JGE) {
+            result.jumps_taken += profiler.taken[i];
+            result.jumps_not_taken += count - profiler.taken[i];
+        }
+        uint64_t reads, writes;
+        register_operands(in, reads, writes);
+        result.register_reads += count * reads;
+        result.register_writes += count * writes;
+    }
+    return result;
+}
+
+RunStats::~RunStats() {
+    for (int fd : fds)
+        if (fd >= 0) ::close(fd);
+}
+
+void RunStats::enable(const std::atomic<uint64_t>* allocations, bool hardware_counters) {
+    on = true;
+    this->allocations = allocations;
+#if ASMPLE_PERF_EVENTS
+    if (hardware_counters) {
+        static const uint64_t configs[] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+        };
+        hardware = true;
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            fds[i] = open_counter(configs[i]);
+            hardware = hardware && fds[i] >= 0;
+        }
+        if (!hardware) {
+            for (int& fd : fds) {
+                if (fd >= 0) ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+#else
+    (void)hardware_counters;
+#endif
+}
+
+void RunStats::read_counters(std::array<uint64_t, COUNTER_COUNT>& values) const {
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        values[i] = 0;
+        if (fds[i] >= 0 && ::read(fds[i], &values[i], sizeof(values[i])) != sizeof(values[i]))
+            values[i] = 0;
+    }
+}
+
+void RunStats::begin(const char* phase) {
+    ASMPLE_PROBE1(phase__start, phase);
+    current = phase;
+    if (!on) return;
+    allocations_start = allocations ? allocations->load(std::memory_order_relaxed) : 0;
+    if (hardware) read_counters(counters_start);
+    cpu_start = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+    wall_start = now_ns(CLOCK_MONOTONIC);
+}
+
+void RunStats::end() {
+    if (!current) return;
+    const char* phase = current;
+    current = nullptr;
+    if (on) {
+        Phase p;
+        p.name = phase;
+        p.wall_ns = now_ns(CLOCK_MONOTONIC) - wall_start;
+        p.cpu_ns = now_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+        if (hardware) {
+            read_counters(p.counters);
+            for (int i = 0; i < COUNTER_COUNT; ++i)
+                p.counters[i] -= counters_start[i];
+        }
+        p.allocations = allocations ? allocations->load(std::memory_order_relaxed) - allocations_start : 0;
+        phases.push_back(std::move(p));
+    }
+    ASMPLE_PROBE1(phase__end, phase);
+}
+
+void RunStats::report(std::ostream& out) const {
+    char line[160];
+    out << "Statistics (" << engine << " engine)\n";
+    std::snprintf(line, sizeof(line), "  %-10s %12s %12s %10s", "phase", "wall ms", "cpu ms", "allocs");
+    out << line;
+    if (hardware) {
+        std::snprintf(line, sizeof(line), " %14s %14s %14s", "cycles", "branch-misses", "cache-misses");
+        out << line;
+    }
+    out << "\n";
+    for (const Phase& p : phases) {
+        std::snprintf(line, sizeof(line), "  %-10s %12.3f %12.3f %10llu", p.name.c_str(), p.wall_ns / 1e6,
+                      p.cpu_ns / 1e6, static_cast<unsigned long long>(p.allocations));
+        out << line;
+        if (hardware) {
+            std::snprintf(line, sizeof(line), " %14llu %14llu %14llu",
+                          static_cast<unsigned long long>(p.counters[CYCLES]),
+                          static_cast<unsigned long long>(p.counters[BRANCH_MISSES]),
+                          static_cast<unsigned long long>(p.counters[CACHE_MISSES]));
+            out << line;
+        }
+        out << "\n";
+    }
+    out << "  instructions retired  " << execution.instructions << "\n"
+        << "  jumps taken           " << execution.jumps_taken << "\n"
+        << "  jumps not taken       " << execution.jumps_not_taken << "\n"
+        << "  register reads        " << execution.register_reads << "\n"
+        << "  register writes       " << execution.register_writes << "\n";
+}
+
+void RunStats::report_json(std::ostream& out) const {
+    out << "{\"engine\": \"" << engine << "\", \"hardware_counters\": " << (hardware ? "true" : "false")
+        << ", \"phases\": [";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const Phase& p = phases[i];
+        out << (i ? ", " : "") << "{\"name\": \"" << p.name << "\", \"wall_ns\": " << p.wall_ns
+            << ", \"cpu_ns\": " << p.cpu_ns << ", \"allocations\": " << p.allocations;
+        if (hardware)
+            for (int c = 0; c < COUNTER_COUNT; ++c)
+                out << ", \"" << COUNTER_NAMES[c] << "\": " << p.counters[c];
+        out << "}";
+    }
+    out << "], \"instructions\": " << execution.instructions
+        << ", \"jumps_taken\": " << execution.jumps_taken
+        << ", \"jumps_not_taken\": " << execution.jumps_not_taken
+        << ", \"register_reads\": " << execution.register_reads
+        << ", \"register_writes\": " << execution.register_writes << "}\n";
+}
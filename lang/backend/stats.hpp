@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "profiler.hpp"
+
+// What a run did, counted by the engine: instructions (tree: AST nodes)
+// retired, jumps taken and not taken (jmp, call and ret always count as
+// taken) and register operands read and written.
+struct ExecutionCounts {
+    uint64_t instructions = 0;
+    uint64_t jumps_taken = 0;
+    uint64_t jumps_not_taken = 0;
+    uint64_t register_reads = 0;
+    uint64_t register_writes = 0;
+
+    // The VM counts per instruction into a Profiler; this folds those counts
+    // by operand shape. The program must not contain superinstructions.
+    static ExecutionCounts from_profile(const Program& program, const Profiler& profiler);
+};
+
+// Per-phase wall and CPU time, heap allocations and, when asked for and
+// the kernel allows it, hardware counters read with perf_event_open. Phases
+// run one after another; begin() and end() also fire the phase probes
+// (see probes.hpp), whether or not statistics are enabled.
+class RunStats {
+public:
+    enum Counter { CYCLES, BRANCH_MISSES, CACHE_MISSES, COUNTER_COUNT };
+
+    struct Phase {
+        std::string name;
+        uint64_t wall_ns = 0;
+        uint64_t cpu_ns = 0;
+        uint64_t allocations = 0;
+        std::array<uint64_t, COUNTER_COUNT> counters{};
+    };
+
+    RunStats() = default;
+    ~RunStats();
+    RunStats(const RunStats&) = delete;
+    RunStats& operator=(const RunStats&) = delete;
+
+    // `allocations` is a counter the binary bumps in operator new; nullptr
+    // leaves the column at zero.
+    void enable(const std::atomic<uint64_t>* allocations, bool hardware_counters);
+    bool enabled() const { return on; }
+    // False when counters were asked for but perf_event_open failed.
+    bool has_hardware_counters() const { return hardware; }
+
+    void begin(const char* phase);
+    void end();
+
+    void set_engine(std::string name) { engine = std::move(name); }
+    ExecutionCounts& counts() { return execution; }
+
+    void report(std::ostream& out) const;
+    void report_json(std::ostream& out) const;
+
+private:
+    bool on = false;
+    bool hardware = false;
+    const std::atomic<uint64_t>* allocations = nullptr;
+    std::array<int, COUNTER_COUNT> fds{-1, -1, -1};
+    std::string engine;
+    ExecutionCounts execution;
+    std::vector<Phase> phases;
+    const char* current = nullptr;
+    uint64_t wall_start = 0, cpu_start = 0, allocations_start = 0;
+    std::array<uint64_t, COUNTER_COUNT> counters_start{};
+
+    void read_counters(std::array<uint64_t, COUNTER_COUNT>& values) const;
+};
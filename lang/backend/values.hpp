@@ -1,18 +1,166 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "../common/vector.hpp"
 
 struct Value {
     virtual ~Value() = default;
     virtual std::string to_string() const = 0;
 };
 
+// Wide enough for every register width (see arithmetic.hpp).
 struct IntValue : Value {
-    int value;
-    IntValue(int v) : value(v) {}
+    int64_t value;
+    IntValue(int64_t v) : value(v) {}
     std::string to_string() const override { return std::to_string(value); }
 };
 
+struct VectorValue : Value {
+    Vector value;
+    VectorValue(const Vector& v) : value(v) {}
+    std::string to_string() const override {
+        std::string text = "[";
+        for (size_t i = 0; i < VECTOR_LANES; ++i) {
+            if (i) text += ", ";
+            text += std::to_string(value.lanes[i]);
+        }
+        return text + "]";
+    }
+};
+
 using ValuePtr = std::shared_ptr<Value>;
-using RegisterFile = std::unordered_map<std::string, ValuePtr>;
\ No newline at end of file
+
+// The vector registers. Unlike scalars they always exist and start at zero.
+using VectorFile = std::array<Vector, VECTOR_REGISTERS>;
+
+// Integer registers stored unboxed in dense slots. Names are resolved to
+// slot indices once when a program is loaded; the name table is only
+// consulted again for diagnostics and dumps. The bytecode engines use
+// 32-bit registers; the tree interpreter's width follows its arithmetic
+// policy.
+template <typename Int>
+struct BasicRegisterFile {
+    std::vector<Int> values;
+    std::vector<uint8_t> defined;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, size_t> slots;
+
+    size_t resolve(std::string_view name) {
+        std::string key(name);
+        auto it = slots.find(key);
+        if (it != slots.end()) return it->second;
+        size_t slot = names.size();
+        names.push_back(key);
+        slots.emplace(std::move(key), slot);
+        values.push_back(0);
+        defined.push_back(0);
+        return slot;
+    }
+
+    void bind(const std::vector<std::string>& table) {
+        names = table;
+        slots.clear();
+        for (size_t i = 0; i < names.size(); ++i)
+            slots.emplace(names[i], i);
+        values.assign(names.size(), 0);
+        defined.assign(names.size(), 0);
+    }
+
+    size_t size() const { return names.size(); }
+
+    // Forgets every value but keeps the slots.
+    void clear() {
+        std::fill(values.begin(), values.end(), 0);
+        std::fill(defined.begin(), defined.end(), 0);
+    }
+
+    Int read(size_t slot) const {
+        if (!defined[slot])
+            throw std::runtime_error("Unknown register: " + names[slot]);
+        return values[slot];
+    }
+
+    void write(size_t slot, Int value) {
+        values[slot] = value;
+        defined[slot] = 1;
+    }
+};
+
+using RegisterFile = BasicRegisterFile<int>;
+
+// Depths of the call stack (return addresses) and the value stack
+// (push/pop). Both are fixed, so a runaway recursion stops with a
+// diagnostic instead of exhausting memory.
+inline constexpr size_t CALL_STACK_DEPTH = 4096;
+inline constexpr size_t VALUE_STACK_DEPTH = 65536;
+
+enum class StackError {
+    CALL_OVERFLOW,
+    CALL_UNDERFLOW,
+    PUSH_OVERFLOW,
+    POP_UNDERFLOW
+};
+
+// Shared by every engine, including the C++ the AOT backend generates.
+inline std::string stack_error_message(StackError error) {
+    switch (error) {
+        case StackError::CALL_OVERFLOW:
+            return "Call stack overflow: more than " + std::to_string(CALL_STACK_DEPTH) + " nested calls";
+        case StackError::CALL_UNDERFLOW:
+            return "Call stack underflow: ret without a matching call";
+        case StackError::PUSH_OVERFLOW:
+            return "Value stack overflow: more than " + std::to_string(VALUE_STACK_DEPTH) + " values pushed";
+        case StackError::POP_UNDERFLOW:
+            return "Value stack underflow: pop from an empty stack";
+    }
+    return "Stack error";
+}
+
+// A stack of at most `capacity` entries in one block allocated up front;
+// push and pop never allocate.
+template <typename T>
+class BoundedStack {
+public:
+    explicit BoundedStack(size_t capacity) : storage(new T[capacity]), limit(capacity) {}
+
+    void push(T value, StackError overflow) {
+        if (top == limit) throw std::runtime_error(stack_error_message(overflow));
+        storage[top++] = value;
+    }
+
+    T pop(StackError underflow) {
+        if (top == 0) throw std::runtime_error(stack_error_message(underflow));
+        return storage[--top];
+    }
+
+    size_t size() const { return top; }
+    void clear() { top = 0; }
+
+private:
+    std::unique_ptr<T[]> storage;
+    size_t limit;
+    size_t top = 0;
+};
+
+// Return addresses of call/ret and the values of push/pop, kept apart so a
+// ret can never jump to a pushed value.
+template <typename Int>
+struct BasicStackFile {
+    BoundedStack<size_t> returns{CALL_STACK_DEPTH};
+    BoundedStack<Int> values{VALUE_STACK_DEPTH};
+
+    void clear() {
+        returns.clear();
+        values.clear();
+    }
+};
+
+using StackFile = BasicStackFile<int>;
@@ -0,0 +1,404 @@
+#include "vm.hpp"
+#include "arithmetic.hpp"
+#include "../common/probes.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+VM::VM(BufferMode mode, int out_fd, int in_fd)
+    : output(out_fd, mode), input(in_fd, &output) {}
+
+void VM::run(const Program& prog, Dispatch dispatch, Profiler* profiler) {
+    registers.bind(prog.registers);
+    vectors = VectorFile();
+    stacks.clear();
+    flags = Flags();
+    executed = 0;
+    this->profiler = profiler;
+
+    const bool threaded = ASMPLE_COMPUTED_GOTO && dispatch == Dispatch::THREADED;
+    if (profiler) {
+        profiler->start(prog.code.size());
+        try {
+            if (threaded) execute<true, true, false>(prog, 0, 0);
+            else execute<false, true, false>(prog, 0, 0);
+        } catch (...) {
+            profiler->stop();
+            throw;
+        }
+        profiler->stop();
+    } else if (threaded) {
+        execute<true, false, false>(prog, 0, 0);
+    } else {
+        execute<false, false, false>(prog, 0, 0);
+    }
+    output.flush();
+}
+
+void VM::resume(Execution& exec, uint64_t budget, std::chrono::nanoseconds quantum, Dispatch dispatch) {
+    if (exec.done() || budget == 0) return;
+    const Program& prog = *exec.program;
+    const bool threaded = ASMPLE_COMPUTED_GOTO && dispatch == Dispatch::THREADED;
+    const bool timed = quantum.count() > 0;
+    const auto deadline = std::chrono::steady_clock::now() + quantum;
+
+    registers.names.swap(exec.names);
+    registers.values.swap(exec.values);
+    registers.defined.swap(exec.defined);
+    vectors.swap(exec.vectors);
+    std::swap(stacks, exec.stacks);
+    Memory* attached = memory;
+    if (exec.memory) memory = exec.memory;
+    flags = exec.flags;
+    profiler = nullptr;
+    std::string* previous = output.redirection();
+    if (exec.output) output.redirect(exec.output);
+
+    size_t ip = exec.ip;
+    try {
+        while (budget > 0 && ip < prog.code.size()) {
+            uint64_t chunk = timed ? std::min(budget, TIME_CHECK_INTERVAL) : budget;
+            ip = threaded ? execute<true, false, true>(prog, ip, chunk)
+                          : execute<false, false, true>(prog, ip, chunk);
+            exec.executed += executed;
+            budget -= std::min(budget, executed);
+            if (timed && std::chrono::steady_clock::now() >= deadline) break;
+        }
+        if (ip >= prog.code.size()) exec.status = Execution::Status::FINISHED;
+    } catch (const std::runtime_error& e) {
+        exec.executed += executed;
+        ip = faulted;
+        exec.status = Execution::Status::FAILED;
+        exec.error = e.what();
+    }
+    output.flush();
+    output.redirect(previous);
+
+    exec.ip = ip;
+    exec.flags = flags;
+    ++exec.slices;
+    registers.names.swap(exec.names);
+    registers.values.swap(exec.values);
+    registers.defined.swap(exec.defined);
+    vectors.swap(exec.vectors);
+    std::swap(stacks, exec.stacks);
+    memory = attached;
+}
+
+#if ASMPLE_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+// Each opcode body is written once and serves both loops: in switch mode
+// NEXT() breaks back to the decode loop, in threaded mode it jumps straight
+// to the next instruction's pre-resolved handler.
+#define OP(name) case OpCode::name: op_##name:
+#define NEXT()                                   \
+    if constexpr (Threaded) {                    \
+        if constexpr (Budgeted)                  \
+            if (steps >= budget) goto suspended; \
+        in = &code[ip];                          \
+        ++steps;                                 \
+        PROFILE(ip);                             \
+        goto *handlers[ip++];                    \
+    } else break
+#else
+#define OP(name) case OpCode::name:
+#define NEXT() break
+#endif
+// The dispatch probe lives in the counting loop (--profile, --stats) so
+// the plain loops carry nothing extra.
+#define PROFILE(index)                           \
+    if constexpr (Profiling) {                   \
+        ++counts[index];                         \
+        profiler->current = index;               \
+        ASMPLE_PROBE2(dispatch, static_cast<size_t>(index),   \
+                      (index) < size ? static_cast<int>(code[index].op) : -1); \
+    }
+#define BRANCH(cond)                             \
+    if (cond) {                                  \
+        if constexpr (Profiling) ++taken[in - code]; \
+        ip = in->a;                              \
+    }
+
+template <bool Threaded, bool Profiling, bool Budgeted>
+size_t VM::execute(const Program& prog, size_t ip, uint64_t budget) {
+    const Instr* code = prog.code.data();
+    const size_t size = prog.code.size();
+    const Instr* in = nullptr;
+    uint64_t steps = 0;
+    uint64_t* counts = Profiling ? profiler->counts.data() : nullptr;
+    uint64_t* taken = Profiling ? profiler->taken.data() : nullptr;
+    const VectorKernels& simd = vector_kernels();
+
+    // An instruction that throws still counts, and resume() needs its index:
+    // none of them moves ip before throwing, so it is the one before ip.
+    try {
+#if ASMPLE_COMPUTED_GOTO
+        static const void* const labels[] = {
+            &&op_NOP, &&op_LOAD, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_CMP,
+            &&op_JMP, &&op_JE, &&op_JNE, &&op_JL, &&op_JG, &&op_JLE, &&op_JGE,
+            &&op_PRINT, &&op_READ, &&op_TRAP,
+            &&op_VADD, &&op_VSUB, &&op_VMUL, &&op_VBROADCAST, &&op_VSET,
+            &&op_VSUM, &&op_VMIN, &&op_VMAX, &&op_VCMP, &&op_VPRINT,
+            &&op_MEM_LOAD, &&op_MEM_STORE, &&op_MEM_COPY, &&op_MEM_FILL,
+            &&op_CALL, &&op_RET, &&op_PUSH, &&op_POP,
+            &&op_ADD_IMM, &&op_SUB_IMM,
+            &&op_CMP_JE, &&op_CMP_JNE, &&op_CMP_JL, &&op_CMP_JG, &&op_CMP_JLE, &&op_CMP_JGE,
+            &&op_LOAD_ADD, &&op_LOAD_SUB, &&op_LOAD_MUL, &&op_LOAD_DIV
+        };
+        if constexpr (Threaded) {
+            handlers.resize(size + 1);
+            for (size_t i = 0; i < size; ++i)
+                handlers[i] = labels[static_cast<size_t>(code[i].op)];
+            handlers[size] = &&done;
+            in = &code[ip];
+            ++steps;
+            PROFILE(ip);
+            goto *handlers[ip++];
+        }
+#endif
+
+        while (ip < size) {
+            if constexpr (Budgeted)
+                if (steps >= budget) break;
+            in = &code[ip++];
+            ++steps;
+            PROFILE(ip - 1);
+            switch (in->op) {
+                OP(NOP)
+                    NEXT();
+                OP(LOAD)
+                    registers.write(in->a, read(in->b, in->mode & B_IMM));
+                    NEXT();
+                OP(ADD)
+                    registers.write(in->a, Int32Wrap::add(registers.values[in->a], read(in->b, in->mode & B_IMM)));
+                    NEXT();
+                OP(SUB)
+                    registers.write(in->a, Int32Wrap::sub(registers.values[in->a], read(in->b, in->mode & B_IMM)));
+                    NEXT();
+                OP(MUL)
+                    registers.write(in->a, Int32Wrap::mul(registers.values[in->a], read(in->b, in->mode & B_IMM)));
+                    NEXT();
+                OP(DIV) {
+                    registers.write(in->a, Int32Wrap::div(registers.values[in->a], read(in->b, in->mode & B_IMM)));
+                    NEXT();
+                }
+                OP(CMP)
+                    compare(*in);
+                    NEXT();
+                OP(JMP)
+                    ip = in->a;
+                    NEXT();
+                OP(JE)
+                    BRANCH(flags.equal);
+                    NEXT();
+                OP(JNE)
+                    BRANCH(!flags.equal);
+                    NEXT();
+                OP(JL)
+                    BRANCH(flags.less);
+                    NEXT();
+                OP(JG)
+                    BRANCH(flags.greater);
+                    NEXT();
+                OP(JLE)
+                    BRANCH(flags.less || flags.equal);
+                    NEXT();
+                OP(JGE)
+                    BRANCH(flags.greater || flags.equal);
+                    NEXT();
+                OP(PRINT)
+                    output.print_int(read(in->b, in->mode & B_IMM));
+                    NEXT();
+                OP(READ) {
+                    int value = 0;
+                    input.read_int(value);
+                    registers.write(in->a, value);
+                    NEXT();
+                }
+                OP(TRAP)
+                    throw std::runtime_error(prog.messages[in->a]);
+
+                OP(VADD)
+                    simd.add(vectors[in->a], vectors[in->b]);
+                    NEXT();
+                OP(VSUB)
+                    simd.sub(vectors[in->a], vectors[in->b]);
+                    NEXT();
+                OP(VMUL)
+                    simd.mul(vectors[in->a], vectors[in->b]);
+                    NEXT();
+                OP(VBROADCAST)
+                    simd.broadcast(vectors[in->a], read(in->b, in->mode & B_IMM));
+                    NEXT();
+                OP(VSET)
+                    vectors[in->a / VECTOR_LANES].lanes[in->a % VECTOR_LANES] = read(in->b, in->mode & B_IMM);
+                    NEXT();
+                OP(VSUM)
+                    registers.write(in->a, simd.sum(vectors[in->b]));
+                    NEXT();
+                OP(VMIN)
+                    registers.write(in->a, simd.min(vectors[in->b]));
+                    NEXT();
+                OP(VMAX)
+                    registers.write(in->a, simd.max(vectors[in->b]));
+                    NEXT();
+                OP(VCMP) {
+                    int order = simd.compare(vectors[in->a], vectors[in->b]);
+                    flags.equal = order == 0;
+                    flags.less = order < 0;
+                    flags.greater = order > 0;
+                    NEXT();
+                }
+                OP(VPRINT)
+                    output.write(VectorValue(vectors[in->b]).to_string() + "\n");
+                    NEXT();
+
+                OP(MEM_LOAD)
+                    registers.write(in->a, *memory->at(int64_t(read(in->b, in->mode & B_IMM)) + in->c));
+                    NEXT();
+                OP(MEM_STORE) {
+                    int32_t* word = memory->at(int64_t(read(in->a, in->mode & A_IMM)) + in->c);
+                    *word = read(in->b, in->mode & B_IMM);
+                    NEXT();
+                }
+                OP(MEM_COPY) {
+                    int dst = read(in->a, in->mode & A_IMM);
+                    int src = read(in->b, in->mode & B_IMM);
+                    int count = read(in->c, in->mode & C_IMM);
+                    int32_t* to = memory->at(dst, count);
+                    const int32_t* from = memory->at(src, count);
+                    std::memmove(to, from, static_cast<size_t>(count) * sizeof(int32_t));
+                    NEXT();
+                }
+                OP(MEM_FILL) {
+                    int dst = read(in->a, in->mode & A_IMM);
+                    int value = read(in->b, in->mode & B_IMM);
+                    int count = read(in->c, in->mode & C_IMM);
+                    simd.fill(memory->at(dst, count), value, static_cast<size_t>(count));
+                    NEXT();
+                }
+
+                // ip already points past the call, which is the return address.
+                OP(CALL)
+                    stacks.returns.push(ip, StackError::CALL_OVERFLOW);
+                    ip = in->a;
+                    NEXT();
+                OP(RET)
+                    ip = stacks.returns.pop(StackError::CALL_UNDERFLOW);
+                    NEXT();
+                OP(PUSH)
+                    stacks.values.push(read(in->b, in->mode & B_IMM), StackError::PUSH_OVERFLOW);
+                    NEXT();
+                OP(POP)
+                    registers.write(in->a, stacks.values.pop(StackError::POP_UNDERFLOW));
+                    NEXT();
+
+                // Superinstructions. Fused pairs read their second half from
+                // in[1] and step over it; it still counts as executed.
+                OP(ADD_IMM)
+                    registers.write(in->a, Int32Wrap::add(registers.values[in->a], in->b));
+                    NEXT();
+                OP(SUB_IMM)
+                    registers.write(in->a, Int32Wrap::sub(registers.values[in->a], in->b));
+                    NEXT();
+                OP(CMP_JE)
+                    compare(*in);
+                    ip = flags.equal ? in[1].a : ip + 1;
+                    ++steps;
+                    NEXT();
+                OP(CMP_JNE)
+                    compare(*in);
+                    ip = !flags.equal ? in[1].a : ip + 1;
+                    ++steps;
+                    NEXT();
+                OP(CMP_JL)
+                    compare(*in);
+                    ip = flags.less ? in[1].a : ip + 1;
+                    ++steps;
+                    NEXT();
+                OP(CMP_JG)
+                    compare(*in);
+                    ip = flags.greater ? in[1].a : ip + 1;
+                    ++steps;
+                    NEXT();
+                OP(CMP_JLE)
+                    compare(*in);
+                    ip = (flags.less || flags.equal) ? in[1].a : ip + 1;
+                    ++steps;
+                    NEXT();
+                OP(CMP_JGE)
+                    compare(*in);
+                    ip = (flags.greater || flags.equal) ? in[1].a : ip + 1;
+                    ++steps;
+                    NEXT();
+                OP(LOAD_ADD)
+                    registers.write(in->a, in->b);
+                    registers.write(in->a, Int32Wrap::add(in->b, read(in[1].b, in[1].mode & B_IMM)));
+                    ++ip;
+                    ++steps;
+                    NEXT();
+                OP(LOAD_SUB)
+                    registers.write(in->a, in->b);
+                    registers.write(in->a, Int32Wrap::sub(in->b, read(in[1].b, in[1].mode & B_IMM)));
+                    ++ip;
+                    ++steps;
+                    NEXT();
+                OP(LOAD_MUL)
+                    registers.write(in->a, in->b);
+                    registers.write(in->a, Int32Wrap::mul(in->b, read(in[1].b, in[1].mode & B_IMM)));
+                    ++ip;
+                    ++steps;
+                    NEXT();
+                OP(LOAD_DIV) {
+                    registers.write(in->a, in->b);
+                    registers.write(in->a, Int32Wrap::div(in->b, read(in[1].b, in[1].mode & B_IMM)));
+                    ++ip;
+                    ++steps;
+                    NEXT();
+                }
+            }
+        }
+    } catch (...) {
+        executed = steps;
+        faulted = ip - 1;
+        throw;
+    }
+#if ASMPLE_COMPUTED_GOTO
+done: __attribute__((unused));
+    if constexpr (Threaded) --steps; // the end-of-program sentinel is not an instruction
+suspended: __attribute__((unused));
+#endif
+    executed = steps;
+    return ip < size ? ip : size;
+}
+
+#undef OP
+#undef NEXT
+#undef PROFILE
+#undef BRANCH
+#if ASMPLE_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+void VM::compare(const Instr& in) {
+    int lhs = read(in.a, in.mode & A_IMM);
+    int rhs = read(in.b, in.mode & B_IMM);
+    flags.equal = (lhs == rhs);
+    flags.less = (lhs < rhs);
+    flags.greater = (lhs > rhs);
+}
+
+int VM::read(int32_t operand, bool immediate) const {
+    if (immediate) return operand;
+    return registers.read(operand);
+}
+
+void VM::dump_registers() {
+    output.write("Registers:\n");
+    for (size_t i = 0; i < registers.size(); ++i) {
+        if (registers.defined[i])
+            output.write("  " + registers.names[i] + " = " + std::to_string(registers.values[i]) + "\n");
+    }
+    output.flush();
+}
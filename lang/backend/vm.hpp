@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../frontend/tokens.hpp"
+#include "bytecode.hpp"
+#include "values.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "profiler.hpp"
+#include "simd.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ASMPLE_COMPUTED_GOTO 1
+#else
+#define ASMPLE_COMPUTED_GOTO 0
+#endif
+
+enum class Dispatch {
+    SWITCH,
+    THREADED // direct-threaded via computed goto; falls back to SWITCH where unsupported
+};
+
+// Suspended state of a program run through VM::resume: everything needed
+// to continue (ip, registers, flags, stacks) lives here rather than in the VM, so
+// an execution can be resumed later by any VM on any thread, as long as
+// only one thread uses it at a time. The program must outlive it.
+struct Execution {
+    enum class Status { SUSPENDED, FINISHED, FAILED };
+
+    explicit Execution(const Program& program)
+        : program(&program), names(program.registers),
+          values(program.registers.size(), 0), defined(program.registers.size(), 0) {}
+
+    bool done() const { return status != Status::SUSPENDED; }
+    // Back to the start of the program; register values are kept.
+    void rewind() {
+        status = Status::SUSPENDED;
+        ip = 0;
+        flags = Flags();
+        stacks.clear();
+        executed = 0;
+        slices = 0;
+        error.clear();
+    }
+
+    const Program* program;
+    Status status = Status::SUSPENDED;
+    size_t ip = 0; // once FAILED, the instruction that threw
+    std::vector<std::string> names;
+    std::vector<int> values;
+    std::vector<uint8_t> defined;
+    VectorFile vectors{};
+    StackFile stacks;
+    Memory* memory = nullptr; // nullptr: the memory attached to the VM
+    Flags flags;
+    uint64_t executed = 0;  // instructions over all slices
+    uint64_t slices = 0;
+    std::string error;      // set when FAILED
+    std::string* output = nullptr; // captures this execution's output; nullptr: the VM's fd
+};
+
+class VM {
+public:
+    explicit VM(BufferMode mode = BufferMode::BLOCK, int out_fd = 1, int in_fd = 0);
+    // With a profiler the run is counted and sampled into it; without one
+    // the profiling code is compiled out of the dispatch loop.
+    void run(const Program& program, Dispatch dispatch = Dispatch::SWITCH, Profiler* profiler = nullptr);
+    // Continues `exec` for at most `budget` instructions and, when `quantum`
+    // is non-zero, until roughly that much time has passed (the clock is
+    // read every TIME_CHECK_INTERVAL instructions). Errors are recorded in
+    // the execution instead of being thrown. Threaded dispatch rebuilds its
+    // handler table on every call, so it only pays off for large budgets.
+    void resume(Execution& exec, uint64_t budget, std::chrono::nanoseconds quantum = {},
+                Dispatch dispatch = Dispatch::SWITCH);
+    static constexpr uint64_t TIME_CHECK_INTERVAL = 4096;
+
+    void dump_registers();
+    void redirect_output(std::string* sink) { output.redirect(sink); }
+    // Memory used by load/store/memcpy/memset; it must outlive the runs.
+    // Without one every access is out of bounds.
+    void attach_memory(Memory* memory) { this->memory = memory ? memory : &Memory::none(); }
+    uint64_t instructions_executed() const { return executed; }
+
+private:
+    RegisterFile registers;
+    VectorFile vectors{};
+    StackFile stacks;
+    Memory* memory = &Memory::none();
+    Flags flags;
+    OutputBuffer output;
+    InputBuffer input;
+    std::vector<const void*> handlers;
+    uint64_t executed = 0;
+    size_t faulted = 0; // index of the instruction that threw
+    Profiler* profiler = nullptr;
+
+    // Runs from `ip` until the end of the program or, when Budgeted, until
+    // `budget` instructions have run; returns where it stopped.
+    template <bool Threaded, bool Profiling, bool Budgeted>
+    size_t execute(const Program& program, size_t ip, uint64_t budget);
+    void compare(const Instr& in);
+    int read(int32_t operand, bool immediate) const;
+};
@@ -0,0 +1,173 @@
+#include "watch.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "../frontend/incremental.hpp"
+#include "interpreter.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool read_file(const std::string& path, std::string& text) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st {};
+    // One byte to spare, so a file that did not grow is read to its end
+    // without resizing.
+    text.resize(fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) + 1 : 4096);
+    size_t length = 0;
+    for (;;) {
+        if (length == text.size()) text.resize(text.size() * 2);
+        ssize_t n = ::read(fd, &text[length], text.size() - length);
+        if (n <= 0) {
+            ::close(fd);
+            text.resize(length);
+            return n == 0;
+        }
+        length += static_cast<size_t>(n);
+    }
+}
+
+class FileMonitor {
+public:
+    explicit FileMonitor(const std::string& path) : path(path) {
+#ifdef __linux__
+        std::filesystem::path file(path);
+        name = file.filename().string();
+        std::string directory = file.has_parent_path() ? file.parent_path().string() : ".";
+        fd = inotify_init1(IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+        stamp(last);
+    }
+
+    ~FileMonitor() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    FileMonitor(const FileMonitor&) = delete;
+    FileMonitor& operator=(const FileMonitor&) = delete;
+
+    // Blocks until the file may have changed; false when it cannot be watched.
+    bool wait() {
+#ifdef __linux__
+        if (fd >= 0) {
+            alignas(inotify_event) char buffer[4096];
+            for (;;) {
+                ssize_t n = ::read(fd, buffer, sizeof(buffer));
+                if (n <= 0) return false;
+                for (ssize_t offset = 0; offset < n;) {
+                    auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                    if (event->len && name == event->name) return true;
+                    offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                }
+            }
+        }
+#endif
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            Stamp now;
+            stamp(now);
+            if (now.size != last.size || now.modified != last.modified) {
+                last = now;
+                return true;
+            }
+        }
+    }
+
+private:
+    struct Stamp {
+        off_t size = -1;
+        time_t modified = 0;
+    };
+
+    std::string path;
+    std::string name;
+    int fd = -1;
+    Stamp last;
+
+    void stamp(Stamp& out) const {
+        struct stat st {};
+        if (stat(path.c_str(), &st) == 0) {
+            out.size = st.st_size;
+            out.modified = st.st_mtime;
+        }
+    }
+};
+
+double milliseconds(Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+} // namespace
+
+int watch(const std::string& path, const WatchOptions& options) {
+    FileMonitor monitor(path);
+    Clock::time_point noticed = Clock::now();
+    std::string text;
+    if (!read_file(path, text)) {
+        std::cerr << "Could not open " << path << "\n";
+        return 1;
+    }
+
+    return with_arithmetic(options.arithmetic, [&](auto arith) {
+        BasicInterpreter<decltype(arith)> interpreter(options.output_mode);
+        IncrementalProgram program;
+        for (;;) {
+            IncrementalProgram::Edit edit = program.update(text);
+            // Nothing to do for a write that left the bytes as they were.
+            if (edit.relexed_lines) {
+                for (ASTNode* node : program.added())
+                    interpreter.resolve(node);
+                Clock::time_point updated = Clock::now();
+
+                std::unique_ptr<Memory> memory;
+                try {
+                    program.check_labels();
+                    memory = std::make_unique<Memory>(options.memory_words);
+                    if (!options.data_file.empty()) memory->map_file(options.data_file);
+                    memory->set_checked(options.checked_memory);
+                    interpreter.attach_memory(memory.get());
+                    interpreter.rerun(program);
+                } catch (const std::runtime_error& e) {
+                    std::cerr << "Error: " << e.what() << "\n";
+                }
+                interpreter.attach_memory(nullptr);
+                Clock::time_point done = Clock::now();
+
+                char line[200];
+                std::snprintf(line, sizeof(line),
+                              "[watch] %zu of %zu line(s) re-lexed, %zu re-parsed, %zu target(s) relinked: "
+                              "update %.3f ms, run %.3f ms, edit to output %.3f ms\n",
+                              edit.relexed_lines, program.line_count(), edit.reparsed_lines, edit.relinked,
+                              milliseconds(updated - noticed), milliseconds(done - updated),
+                              milliseconds(done - noticed));
+                std::cerr << line;
+            }
+
+            do {
+                if (!monitor.wait()) {
+                    std::cerr << "Could not watch " << path << "\n";
+                    return 1;
+                }
+                noticed = Clock::now();
+            } while (!read_file(path, text));
+        }
+    });
+}
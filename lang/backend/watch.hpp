@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+
+#include "arithmetic.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+
+// Runs one program on the tree engine, then again every time its file is
+// written. The program stays resident as an IncrementalProgram, so an edit
+// costs a diff of the text, the lexing and parsing of the lines that
+// changed and O(log n) in the number of lines to splice them in; only the
+// new nodes get their registers resolved. After every run
+// a line on stderr tells what was re-lexed and re-parsed and how long it
+// took from noticing the change to the end of the output.
+//
+// Changes are noticed with inotify on the file's directory on Linux (so
+// editors that save by renaming a new file over the old one are seen) and
+// by polling the file's size and modification time elsewhere. Every run
+// starts with undefined registers and fresh memory; stdin is only there
+// for the first run.
+struct WatchOptions {
+    ArithmeticPolicy arithmetic = ArithmeticPolicy::INT32_WRAP;
+    BufferMode output_mode = BufferMode::LINE;
+    std::string data_file;
+    size_t memory_words = Memory::DEFAULT_WORDS;
+    bool checked_memory = true;
+};
+
+// Returns only when the file cannot be read at the start or cannot be
+// watched; the status is then 1.
+int watch(const std::string& path, const WatchOptions& options);
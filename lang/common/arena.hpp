@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that share one lifetime. Memory is carved out
+// of large blocks and released all at once; destructors never run, so only
+// trivially destructible types may live here.
+class Arena {
+public:
+    explicit Arena(size_t block_size = 64 * 1024) : block_size(block_size) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    void* allocate(size_t size, size_t align) {
+        size_t offset = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+        if (!cursor || offset + size > static_cast<size_t>(end - cursor)) {
+            grow(size + align);
+            offset = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+        }
+        std::byte* result = cursor + offset;
+        cursor = result + size;
+        used += size;
+        return result;
+    }
+
+    // Frees every allocation at once, keeping the first block for reuse.
+    void reset() {
+        if (blocks.size() > 1) blocks.resize(1);
+        cursor = blocks.empty() ? nullptr : blocks.front().get();
+        end = blocks.empty() ? nullptr : cursor + block_size;
+        reserved = blocks.empty() ? 0 : block_size;
+        used = 0;
+    }
+
+    size_t bytes_used() const { return used; }
+    size_t bytes_reserved() const { return reserved; }
+
+private:
+    size_t block_size;
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::byte* cursor = nullptr;
+    std::byte* end = nullptr;
+    size_t used = 0;
+    size_t reserved = 0;
+
+    void grow(size_t min_size) {
+        size_t size = min_size > block_size ? min_size : block_size;
+        blocks.emplace_back(new std::byte[size]);
+        cursor = blocks.back().get();
+        end = cursor + size;
+        reserved += size;
+    }
+};
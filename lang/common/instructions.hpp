@@ -0,0 +1,148 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "opcodes.hpp"
+
+// Every instruction of the language, in one table. The lexer's keyword
+// lookup, the parser's statement dispatch and the compiler's opcode choice
+// are all derived from it, and the Mnemonic travels on the token into the
+// AST so nothing downstream compares instruction names again.
+enum class Mnemonic : uint8_t {
+    NONE, // not an instruction
+    LET, ADD, SUB, MUL, DIV, CMP,
+    JMP, JE, JNE, JL, JG, JLE, JGE,
+    PRINT, READ,
+    VADD, VSUB, VMUL, VBROADCAST, VSET, VSUM, VMIN, VMAX, VCMP, VPRINT,
+    LOAD, STORE, MEMCPY, MEMSET,
+    CALL, RET, PUSH, POP
+};
+
+// Which statement parser reads the operands.
+enum class OperandShape : uint8_t {
+    ASSIGN,  // let r = x
+    BINARY,  // add r, x
+    COMPARE, // cmp x, y
+    JUMP,    // jmp label
+    PRINT,   // print x
+    READ,    // read r
+    VECTOR,  // see VectorOp
+    MEMORY,  // see MemoryOp
+    STACK    // see StackOp
+};
+
+struct InstructionInfo {
+    std::string_view name;
+    Mnemonic mnemonic;
+    OperandShape shape;
+    OpCode opcode;
+    uint8_t variant; // the node's JumpKind, VectorOp, MemoryOp or StackOp, by shape
+};
+
+// Ordered like Mnemonic, which is checked below.
+inline constexpr InstructionInfo instructions[] = {
+    {"let", Mnemonic::LET, OperandShape::ASSIGN, OpCode::LOAD, 0},
+    {"add", Mnemonic::ADD, OperandShape::BINARY, OpCode::ADD, 0},
+    {"sub", Mnemonic::SUB, OperandShape::BINARY, OpCode::SUB, 0},
+    {"mul", Mnemonic::MUL, OperandShape::BINARY, OpCode::MUL, 0},
+    {"div", Mnemonic::DIV, OperandShape::BINARY, OpCode::DIV, 0},
+    {"cmp", Mnemonic::CMP, OperandShape::COMPARE, OpCode::CMP, 0},
+    {"jmp", Mnemonic::JMP, OperandShape::JUMP, OpCode::JMP, 0},
+    {"je", Mnemonic::JE, OperandShape::JUMP, OpCode::JE, 1},
+    {"jne", Mnemonic::JNE, OperandShape::JUMP, OpCode::JNE, 2},
+    {"jl", Mnemonic::JL, OperandShape::JUMP, OpCode::JL, 3},
+    {"jg", Mnemonic::JG, OperandShape::JUMP, OpCode::JG, 4},
+    {"jle", Mnemonic::JLE, OperandShape::JUMP, OpCode::JLE, 5},
+    {"jge", Mnemonic::JGE, OperandShape::JUMP, OpCode::JGE, 6},
+    {"print", Mnemonic::PRINT, OperandShape::PRINT, OpCode::PRINT, 0},
+    {"read", Mnemonic::READ, OperandShape::READ, OpCode::READ, 0},
+    {"vadd", Mnemonic::VADD, OperandShape::VECTOR, OpCode::VADD, 0},
+    {"vsub", Mnemonic::VSUB, OperandShape::VECTOR, OpCode::VSUB, 1},
+    {"vmul", Mnemonic::VMUL, OperandShape::VECTOR, OpCode::VMUL, 2},
+    {"vbroadcast", Mnemonic::VBROADCAST, OperandShape::VECTOR, OpCode::VBROADCAST, 3},
+    {"vset", Mnemonic::VSET, OperandShape::VECTOR, OpCode::VSET, 4},
+    {"vsum", Mnemonic::VSUM, OperandShape::VECTOR, OpCode::VSUM, 5},
+    {"vmin", Mnemonic::VMIN, OperandShape::VECTOR, OpCode::VMIN, 6},
+    {"vmax", Mnemonic::VMAX, OperandShape::VECTOR, OpCode::VMAX, 7},
+    {"vcmp", Mnemonic::VCMP, OperandShape::VECTOR, OpCode::VCMP, 8},
+    {"vprint", Mnemonic::VPRINT, OperandShape::VECTOR, OpCode::VPRINT, 9},
+    {"load", Mnemonic::LOAD, OperandShape::MEMORY, OpCode::MEM_LOAD, 0},
+    {"store", Mnemonic::STORE, OperandShape::MEMORY, OpCode::MEM_STORE, 1},
+    {"memcpy", Mnemonic::MEMCPY, OperandShape::MEMORY, OpCode::MEM_COPY, 2},
+    {"memset", Mnemonic::MEMSET, OperandShape::MEMORY, OpCode::MEM_FILL, 3},
+    {"call", Mnemonic::CALL, OperandShape::STACK, OpCode::CALL, 0},
+    {"ret", Mnemonic::RET, OperandShape::STACK, OpCode::RET, 1},
+    {"push", Mnemonic::PUSH, OperandShape::STACK, OpCode::PUSH, 2},
+    {"pop", Mnemonic::POP, OperandShape::STACK, OpCode::POP, 3},
+};
+
+inline constexpr size_t INSTRUCTION_COUNT = std::size(instructions);
+
+constexpr bool instructions_in_order() {
+    for (size_t i = 0; i < INSTRUCTION_COUNT; ++i)
+        if (static_cast<size_t>(instructions[i].mnemonic) != i + 1) return false;
+    return true;
+}
+static_assert(instructions_in_order(), "instructions[] must follow the Mnemonic order");
+
+constexpr const InstructionInfo& instruction(Mnemonic mnemonic) {
+    return instructions[static_cast<size_t>(mnemonic) - 1];
+}
+
+// Perfect hash over the instruction names: the length, first, second and
+// last byte mixed with a seed that is searched at compile time until no two
+// names share a slot. A lookup is one hash and one string compare.
+inline constexpr size_t KEYWORD_SLOTS = 128;
+
+constexpr uint32_t keyword_hash(std::string_view word, uint32_t seed) {
+    uint32_t h = seed ^ static_cast<uint32_t>(word.size());
+    h = (h ^ static_cast<unsigned char>(word[0])) * 0x01000193u;
+    h = (h ^ static_cast<unsigned char>(word[1])) * 0x01000193u;
+    h = (h ^ static_cast<unsigned char>(word[word.size() - 1])) * 0x01000193u;
+    return h >> 25; // top 7 bits: 0..KEYWORD_SLOTS-1
+}
+
+struct KeywordTable {
+    uint32_t seed = 0;
+    size_t min_length = 0;
+    size_t max_length = 0;
+    std::array<uint8_t, KEYWORD_SLOTS> slots{}; // instruction index + 1, 0 when empty
+};
+
+constexpr KeywordTable make_keyword_table() {
+    KeywordTable table;
+    table.min_length = table.max_length = instructions[0].name.size();
+    for (const auto& in : instructions) {
+        if (in.name.size() < table.min_length) table.min_length = in.name.size();
+        if (in.name.size() > table.max_length) table.max_length = in.name.size();
+    }
+    for (uint32_t seed = 1; seed < 100000; ++seed) {
+        table.seed = seed;
+        table.slots = {};
+        bool collision = false;
+        for (size_t i = 0; i < INSTRUCTION_COUNT && !collision; ++i) {
+            uint8_t& slot = table.slots[keyword_hash(instructions[i].name, seed)];
+            collision = slot != 0;
+            slot = static_cast<uint8_t>(i + 1);
+        }
+        if (!collision) return table;
+    }
+    table.seed = 0;
+    return table;
+}
+
+inline constexpr KeywordTable keyword_table = make_keyword_table();
+static_assert(keyword_table.seed != 0, "no collision-free seed for the instruction names");
+static_assert(keyword_table.min_length >= 2, "keyword_hash reads the second byte");
+
+inline Mnemonic find_instruction(std::string_view word) {
+    if (word.size() < keyword_table.min_length || word.size() > keyword_table.max_length)
+        return Mnemonic::NONE;
+    uint8_t slot = keyword_table.slots[keyword_hash(word, keyword_table.seed)];
+    if (slot && instructions[slot - 1].name == word)
+        return instructions[slot - 1].mnemonic;
+    return Mnemonic::NONE;
+}
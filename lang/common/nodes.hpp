@@ -1,68 +1,196 @@
 #pragma once
-#include <memory>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
-#include <vector>
+#include <string_view>
 #include "../frontend/tokens.hpp"
+#include "arena.hpp"
+
+// AST nodes are plain tagged structs allocated from a per-program Arena.
+// Dispatch is a switch on `kind`; children are arena pointers owned by the
+// same arena, so a whole tree is released in one step.
+enum class NodeKind : uint8_t {
+    NUMBER,
+    IDENTIFIER,
+    ASSIGNMENT,
+    BINOP,
+    PRINT,
+    LABEL,
+    JUMP,
+    CMP,
+    READ,
+    VECTOR,
+    MEMORY,
+    STACK
+};
+
+inline const char* node_kind_name(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::NUMBER: return "NumberNode";
+        case NodeKind::IDENTIFIER: return "IdentifierNode";
+        case NodeKind::ASSIGNMENT: return "AssignmentNode";
+        case NodeKind::BINOP: return "BinOpNode";
+        case NodeKind::PRINT: return "PrintNode";
+        case NodeKind::LABEL: return "LabelNode";
+        case NodeKind::JUMP: return "JumpNode";
+        case NodeKind::CMP: return "CmpNode";
+        case NodeKind::READ: return "ReadNode";
+        case NodeKind::VECTOR: return "VectorNode";
+        case NodeKind::MEMORY: return "MemoryNode";
+        case NodeKind::STACK: return "StackNode";
+    }
+    return "UnknownNode";
+}
 
 struct ASTNode {
-    virtual ~ASTNode() = default;
-    virtual std::string type_name() const = 0;
+    NodeKind kind;
+    explicit ASTNode(NodeKind k) : kind(k) {}
 };
 
 struct NumberNode : ASTNode {
     Token token;
-    NumberNode(const Token& t) : token(t) {}
-    std::string type_name() const override { return "NumberNode"; }
+    NumberNode(const Token& t) : ASTNode(NodeKind::NUMBER), token(t) {}
+    // False when the literal does not fit in Int.
+    template <typename Int = int>
+    bool fits(Int& result) const {
+        auto [end, ec] = std::from_chars(token.value.data(), token.value.data() + token.value.size(), result);
+        return ec == std::errc() && end == token.value.data() + token.value.size();
+    }
+    template <typename Int = int>
+    Int value() const {
+        Int result = 0;
+        if (!fits(result))
+            throw std::runtime_error("Integer literal out of range: " + std::string(token.value));
+        return result;
+    }
 };
 
 struct IdentifierNode : ASTNode {
     Token token;
-    IdentifierNode(const Token& t) : token(t) {}
-    std::string type_name() const override { return "IdentifierNode"; }
+    size_t slot = 0; // register slot, resolved at load time
+    IdentifierNode(const Token& t) : ASTNode(NodeKind::IDENTIFIER), token(t) {}
 };
 
 struct AssignmentNode : ASTNode {
     Token var_token;
-    std::unique_ptr<ASTNode> value;
-    AssignmentNode(Token t, std::unique_ptr<ASTNode> v)
-        : var_token(t), value(std::move(v)) {}
-    std::string type_name() const override { return "AssignmentNode"; }
+    size_t slot = 0; // register slot, resolved at load time
+    ASTNode* value;
+    AssignmentNode(Token t, ASTNode* v)
+        : ASTNode(NodeKind::ASSIGNMENT), var_token(t), value(v) {}
 };
 
 struct BinOpNode : ASTNode {
-    std::unique_ptr<ASTNode> left;
+    IdentifierNode* left;
     Token op_token;
-    std::unique_ptr<ASTNode> right;
-    BinOpNode(std::unique_ptr<ASTNode> l, Token op, std::unique_ptr<ASTNode> r)
-        : left(std::move(l)), op_token(op), right(std::move(r)) {}
-    std::string type_name() const override { return "BinOpNode"; }
+    ASTNode* right;
+    BinOpNode(IdentifierNode* l, Token op, ASTNode* r)
+        : ASTNode(NodeKind::BINOP), left(l), op_token(op), right(r) {}
 };
 
 struct PrintNode : ASTNode {
-    std::unique_ptr<ASTNode> expr;
-    PrintNode(std::unique_ptr<ASTNode> expr)
-        : expr(std::move(expr)) {}
-    std::string type_name() const override { return "PrintNode"; }
+    ASTNode* expr;
+    PrintNode(ASTNode* expr)
+        : ASTNode(NodeKind::PRINT), expr(expr) {}
 };
 
 struct LabelNode : ASTNode {
-    std::string label;
-    LabelNode(const std::string& name) : label(name) {}
-    std::string type_name() const override { return "LabelNode"; }
+    std::string_view label;
+    LabelNode(std::string_view name) : ASTNode(NodeKind::LABEL), label(name) {}
+};
+
+enum class JumpKind {
+    JMP,
+    JE,
+    JNE,
+    JL,
+    JG,
+    JLE,
+    JGE
 };
 
 struct JumpNode : ASTNode {
-    std::string op;
-    std::string label;
-    JumpNode(const std::string& jump_type, const std::string& label)
-        : op(jump_type), label(label) {}
-    std::string type_name() const override { return "JumpNode"; }
+    JumpKind op;
+    Token label;
+    size_t target = 0; // index of the first node after the label, resolved at load time
+    JumpNode(JumpKind op, const Token& label)
+        : ASTNode(NodeKind::JUMP), op(op), label(label) {}
 };
 
 struct CmpNode : ASTNode {
-    std::unique_ptr<ASTNode> left;
-    std::unique_ptr<ASTNode> right;
-    CmpNode(std::unique_ptr<ASTNode> l, std::unique_ptr<ASTNode> r)
-        : left(std::move(l)), right(std::move(r)) {}
-    std::string type_name() const override { return "CmpNode"; }
-};
\ No newline at end of file
+    ASTNode* left;
+    ASTNode* right;
+    CmpNode(ASTNode* l, ASTNode* r)
+        : ASTNode(NodeKind::CMP), left(l), right(r) {}
+};
+
+struct ReadNode : ASTNode {
+    Token var_token;
+    size_t slot = 0; // register slot, resolved at load time
+    ReadNode(const Token& t) : ASTNode(NodeKind::READ), var_token(t) {}
+};
+
+enum class VectorOp {
+    ADD,       // vadd vd, vs
+    SUB,       // vsub vd, vs
+    MUL,       // vmul vd, vs
+    BROADCAST, // vbroadcast vd, x
+    SET,       // vset vd, lane, x
+    SUM,       // vsum r, vs
+    MIN,       // vmin r, vs
+    MAX,       // vmax r, vs
+    CMP,       // vcmp va, vb
+    PRINT      // vprint vs
+};
+
+// One vector instruction. `vector` is the first vector operand and
+// `source` the second; `scalar` is the value of vbroadcast/vset or, as an
+// IdentifierNode, the destination of vsum/vmin/vmax.
+struct VectorNode : ASTNode {
+    VectorOp op;
+    Token op_token;
+    int vector = 0;
+    int source = 0;
+    int lane = 0;
+    ASTNode* scalar = nullptr;
+    VectorNode(VectorOp op, const Token& t) : ASTNode(NodeKind::VECTOR), op(op), op_token(t) {}
+};
+
+enum class MemoryOp {
+    LOAD,  // load r, [base + offset]
+    STORE, // store [base + offset], x
+    COPY,  // memcpy dst, src, count
+    FILL   // memset dst, value, count
+};
+
+// One linear-memory instruction; addresses and counts are in 32-bit words.
+// `base` is a register or a number (an absolute address). `args` holds the
+// destination register of load, the value of store, and the three operands
+// of memcpy/memset.
+struct MemoryNode : ASTNode {
+    MemoryOp op;
+    Token op_token;
+    ASTNode* base = nullptr;
+    int offset = 0;
+    ASTNode* args[3] = {};
+    MemoryNode(MemoryOp op, const Token& t) : ASTNode(NodeKind::MEMORY), op(op), op_token(t) {}
+};
+
+enum class StackOp {
+    CALL, // call label
+    RET,  // ret
+    PUSH, // push x
+    POP   // pop r
+};
+
+// One call-stack or value-stack instruction. `label` and `target` are
+// used by call, `operand` holds the value of push and, as an
+// IdentifierNode, the destination of pop.
+struct StackNode : ASTNode {
+    StackOp op;
+    Token op_token;
+    Token label;
+    size_t target = 0; // index of the first node after the label, resolved at load time
+    ASTNode* operand = nullptr;
+    StackNode(StackOp op, const Token& t) : ASTNode(NodeKind::STACK), op(op), op_token(t), label(t) {}
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+
+// Bytecode operations. Shared with the instruction table, which picks the
+// opcode each mnemonic compiles to.
+enum class OpCode : uint8_t {
+    NOP,
+    LOAD,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    CMP,
+    JMP,
+    JE,
+    JNE,
+    JL,
+    JG,
+    JLE,
+    JGE,
+    PRINT,
+    READ,
+    TRAP,
+    // Vector instructions. Vector operands are register numbers 0..15:
+    // vadd/vsub/vmul/vcmp take two, vbroadcast a vector and a scalar
+    // operand, vset the lane index (vector * VECTOR_LANES + lane) and a
+    // scalar operand, vsum/vmin/vmax a scalar destination and a vector,
+    // vprint a vector in `b`.
+    VADD,
+    VSUB,
+    VMUL,
+    VBROADCAST,
+    VSET,
+    VSUM,
+    VMIN,
+    VMAX,
+    VCMP,
+    VPRINT,
+    // Linear memory. Addresses and counts are in words; `c` is the offset
+    // of mem_load/mem_store and the count of mem_copy/mem_fill.
+    MEM_LOAD,  // a = destination register, b = base
+    MEM_STORE, // a = base, b = value
+    MEM_COPY,  // a = destination address, b = source address
+    MEM_FILL,  // a = destination address, b = value
+    // Subroutines and the value stack (see StackFile).
+    CALL, // a = target; pushes the address of the next instruction
+    RET,
+    PUSH, // b = value
+    POP,  // a = destination register
+    // Superinstructions produced by the peephole pass. Fused pairs keep
+    // their second instruction in the following slot and skip over it.
+    ADD_IMM,
+    SUB_IMM,
+    CMP_JE,
+    CMP_JNE,
+    CMP_JL,
+    CMP_JG,
+    CMP_JLE,
+    CMP_JGE,
+    LOAD_ADD,
+    LOAD_SUB,
+    LOAD_MUL,
+    LOAD_DIV
+};
+
+inline const char* opcode_name(OpCode op) {
+    switch (op) {
+        case OpCode::NOP: return "nop";
+        case OpCode::LOAD: return "load";
+        case OpCode::ADD: return "add";
+        case OpCode::SUB: return "sub";
+        case OpCode::MUL: return "mul";
+        case OpCode::DIV: return "div";
+        case OpCode::CMP: return "cmp";
+        case OpCode::JMP: return "jmp";
+        case OpCode::JE: return "je";
+        case OpCode::JNE: return "jne";
+        case OpCode::JL: return "jl";
+        case OpCode::JG: return "jg";
+        case OpCode::JLE: return "jle";
+        case OpCode::JGE: return "jge";
+        case OpCode::PRINT: return "print";
+        case OpCode::READ: return "read";
+        case OpCode::TRAP: return "trap";
+        case OpCode::VADD: return "vadd";
+        case OpCode::VSUB: return "vsub";
+        case OpCode::VMUL: return "vmul";
+        case OpCode::VBROADCAST: return "vbroadcast";
+        case OpCode::VSET: return "vset";
+        case OpCode::VSUM: return "vsum";
+        case OpCode::VMIN: return "vmin";
+        case OpCode::VMAX: return "vmax";
+        case OpCode::VCMP: return "vcmp";
+        case OpCode::VPRINT: return "vprint";
+        case OpCode::MEM_LOAD: return "load";
+        case OpCode::MEM_STORE: return "store";
+        case OpCode::MEM_COPY: return "memcpy";
+        case OpCode::MEM_FILL: return "memset";
+        case OpCode::CALL: return "call";
+        case OpCode::RET: return "ret";
+        case OpCode::PUSH: return "push";
+        case OpCode::POP: return "pop";
+        case OpCode::ADD_IMM: return "add_imm";
+        case OpCode::SUB_IMM: return "sub_imm";
+        case OpCode::CMP_JE: return "cmp_je";
+        case OpCode::CMP_JNE: return "cmp_jne";
+        case OpCode::CMP_JL: return "cmp_jl";
+        case OpCode::CMP_JG: return "cmp_jg";
+        case OpCode::CMP_JLE: return "cmp_jle";
+        case OpCode::CMP_JGE: return "cmp_jge";
+        case OpCode::LOAD_ADD: return "load_add";
+        case OpCode::LOAD_SUB: return "load_sub";
+        case OpCode::LOAD_MUL: return "load_mul";
+        case OpCode::LOAD_DIV: return "load_div";
+    }
+    return "unknown";
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// USDT static probes in the "asmple" provider, for perf and bpftrace:
+//
+//   asmple:phase__start(const char* phase)   a --stats phase begins
+//   asmple:phase__end(const char* phase)     ... and ends
+//   asmple:dispatch(size_t ip, int kind)     one instruction (VM: opcode) or
+//                                            AST node (tree: NodeKind)
+//
+// e.g. bpftrace -e 'usdt:./asmple:asmple:dispatch { @[arg1] = count(); }'
+// Each probe is a single nop until a tracer attaches. Without <sys/sdt.h>
+// (systemtap-sdt-dev) they compile to nothing.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define ASMPLE_HAVE_PROBES 1
+#define ASMPLE_PROBE1(name, a) DTRACE_PROBE1(asmple, name, a)
+#define ASMPLE_PROBE2(name, a, b) DTRACE_PROBE2(asmple, name, a, b)
+#endif
+#endif
+
+#ifndef ASMPLE_HAVE_PROBES
+#define ASMPLE_HAVE_PROBES 0
+#define ASMPLE_PROBE1(name, a) do {} while (0)
+#define ASMPLE_PROBE2(name, a, b) do {} while (0)
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool that runs a known batch of tasks to completion. Tasks are
+// dealt round-robin onto per-worker deques; a worker takes from the front
+// of its own deque and, once that is empty, steals from the back of the
+// others, so long tasks on one worker do not leave the rest idle.
+class WorkStealingPool {
+public:
+    using Task = std::function<void(size_t worker)>;
+
+    struct WorkerStats {
+        size_t tasks = 0;
+        size_t steals = 0;
+        double busy_seconds = 0;
+    };
+
+    explicit WorkStealingPool(size_t workers)
+        : queues(workers ? workers : 1), counters(queues.size()) {}
+
+    size_t size() const { return queues.size(); }
+    const std::vector<WorkerStats>& stats() const { return counters; }
+
+    // Runs every task and returns when all of them have finished.
+    void run(std::vector<Task> tasks) {
+        for (size_t i = 0; i < tasks.size(); ++i)
+            queues[i % queues.size()].tasks.push_back(std::move(tasks[i]));
+        counters.assign(queues.size(), WorkerStats());
+
+        std::vector<std::thread> threads;
+        for (size_t w = 1; w < queues.size(); ++w)
+            threads.emplace_back([this, w] { work(w); });
+        work(0);
+        for (auto& t : threads) t.join();
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues;
+    std::vector<WorkerStats> counters;
+
+    bool take(size_t worker, Task& task) {
+        {
+            Queue& own = queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue& victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                ++counters[worker].steals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // No task ever spawns another, so once every deque is empty the
+    // worker is done.
+    void work(size_t worker) {
+        Task task;
+        while (take(worker, task)) {
+            auto start = std::chrono::steady_clock::now();
+            task(worker);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            ++counters[worker].tasks;
+            counters[worker].busy_seconds += elapsed.count();
+        }
+    }
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Vector registers v0..v15, each holding eight 32-bit lanes (one AVX2
+// register). They only exist as operands of the vector instructions, so a
+// scalar register may still be called v0.
+constexpr size_t VECTOR_REGISTERS = 16;
+constexpr size_t VECTOR_LANES = 8;
+
+struct alignas(32) Vector {
+    int32_t lanes[VECTOR_LANES] = {};
+};
+
+// Index of a vector register name ("v0".."v15"), or -1.
+inline int vector_register(std::string_view name) {
+    if (name.size() < 2 || name.size() > 3 || name[0] != 'v') return -1;
+    int index = 0;
+    for (size_t i = 1; i < name.size(); ++i) {
+        if (name[i] < '0' || name[i] > '9') return -1;
+        index = index * 10 + (name[i] - '0');
+    }
+    if (name.size() == 3 && name[1] == '0') return -1;
+    return index < static_cast<int>(VECTOR_REGISTERS) ? index : -1;
+}
@@ -0,0 +1,406 @@
+#include "incremental.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+
+namespace {
+
+constexpr size_t COMPARE_BLOCK = 256;
+
+size_t common_prefix(std::string_view a, std::string_view b) {
+    const size_t limit = std::min(a.size(), b.size());
+    size_t n = 0;
+    while (n + COMPARE_BLOCK <= limit && std::memcmp(a.data() + n, b.data() + n, COMPARE_BLOCK) == 0)
+        n += COMPARE_BLOCK;
+    while (n < limit && a[n] == b[n])
+        ++n;
+    return n;
+}
+
+size_t common_suffix(std::string_view a, std::string_view b, size_t limit) {
+    const char* a_end = a.data() + a.size();
+    const char* b_end = b.data() + b.size();
+    size_t n = 0;
+    while (n + COMPARE_BLOCK <= limit &&
+           std::memcmp(a_end - n - COMPARE_BLOCK, b_end - n - COMPARE_BLOCK, COMPARE_BLOCK) == 0)
+        n += COMPARE_BLOCK;
+    while (n < limit && a_end[-1 - static_cast<ptrdiff_t>(n)] == b_end[-1 - static_cast<ptrdiff_t>(n)])
+        ++n;
+    return n;
+}
+
+// Counted 64 bytes at a time into a byte, which compilers vectorize;
+// std::count does not.
+size_t count_newlines(const char* text, size_t length) {
+    size_t total = 0;
+    for (; length >= 64; text += 64, length -= 64) {
+        unsigned char block = 0;
+        for (int i = 0; i < 64; ++i)
+            block += text[i] == '\n';
+        total += block;
+    }
+    for (; length; ++text, --length)
+        total += *text == '\n';
+    return total;
+}
+
+// The label of a jump or call, nullptr for any other node.
+const Token* branch_label(const ASTNode* node) {
+    if (node->kind == NodeKind::JUMP)
+        return &static_cast<const JumpNode*>(node)->label;
+    if (node->kind == NodeKind::STACK && static_cast<const StackNode*>(node)->op == StackOp::CALL)
+        return &static_cast<const StackNode*>(node)->label;
+    return nullptr;
+}
+
+// The slot of a jump or call, see IncrementalProgram.
+size_t& branch_slot(ASTNode* node) {
+    if (node->kind == NodeKind::JUMP)
+        return static_cast<JumpNode*>(node)->target;
+    return static_cast<StackNode*>(node)->target;
+}
+
+// Line numbers are left out, so a line that only moved parses the same,
+// and so is the end of the line, which moves with a trailing comment.
+bool same_tokens(const std::vector<Token>& a, const std::vector<Token>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const Token& x, const Token& y) {
+        return x.type == y.type && x.value == y.value &&
+               (x.column == y.column || x.type == TokenType::EOF_TOKEN);
+    });
+}
+
+} // namespace
+
+static_assert(sizeof(size_t) >= 8, "a position packs a line id and an index into one size_t");
+
+IncrementalProgram::IncrementalProgram() {
+    root = head = adopt(lex_line("", 1));
+}
+
+std::unique_ptr<IncrementalProgram::Line> IncrementalProgram::lex_line(std::string_view source, size_t number) {
+    auto line = std::make_unique<Line>();
+    if (!source.empty()) {
+        char* copy = static_cast<char*>(line->arena.allocate(source.size(), 1));
+        std::memcpy(copy, source.data(), source.size());
+        source = std::string_view(copy, source.size());
+    }
+    // Lexed into a reused buffer, so the line's own vector is allocated once.
+    Lexer lexer(source);
+    scratch.clear();
+    do {
+        scratch.push_back(lexer.next_token());
+        scratch.back().line = static_cast<int>(number);
+    } while (scratch.back().type != TokenType::EOF_TOKEN);
+    line->tokens.assign(scratch.begin(), scratch.end());
+    return line;
+}
+
+// Gives a line an id and a treap priority; the program owns it from here.
+IncrementalProgram::Line* IncrementalProgram::adopt(std::unique_ptr<Line> line) {
+    if (free_ids.empty()) {
+        line->id = by_id.size();
+        by_id.emplace_back();
+    } else {
+        line->id = free_ids.back();
+        free_ids.pop_back();
+    }
+    line->priority = static_cast<uint32_t>(random());
+    Line* adopted = line.get();
+    by_id[adopted->id] = std::move(line);
+    return adopted;
+}
+
+IncrementalProgram::Edit IncrementalProgram::update(std::string& next) {
+    Edit edit;
+    fresh_nodes.clear();
+    const size_t prefix = common_prefix(text, next);
+    if (prefix == text.size() && prefix == next.size()) return edit;
+
+    // The edited region starts at the beginning of the line holding the
+    // first difference. It ends where the common suffix starts if that is
+    // the start of a line in both texts, else after the first newline of
+    // the suffix, or at the end of both texts (taking in the last line,
+    // which has no newline) when the suffix holds none.
+    size_t start = std::string_view(text).substr(0, prefix).rfind('\n');
+    start = start == std::string_view::npos ? 0 : start + 1;
+    size_t suffix = common_suffix(text, next, std::min(text.size(), next.size()) - start);
+    const bool line_start = (suffix == text.size() || text[text.size() - suffix - 1] == '\n') &&
+                            (suffix == next.size() || next[next.size() - suffix - 1] == '\n');
+    if (suffix && !line_start) {
+        size_t newline = text.find('\n', text.size() - suffix);
+        suffix = newline == std::string::npos ? 0 : text.size() - newline - 1;
+    }
+    const bool to_end = suffix == 0;
+    const size_t old_end = text.size() - suffix;
+    const size_t new_end = next.size() - suffix;
+
+    size_t first = count_newlines(text.data(), start);
+    size_t removed = count_newlines(text.data() + start, old_end - start) + to_end;
+
+    std::vector<std::unique_ptr<Line>> fresh;
+    for (size_t pos = start;;) {
+        size_t newline = next.find('\n', pos);
+        if (newline == std::string::npos || newline >= new_end) {
+            if (to_end)
+                fresh.push_back(lex_line(std::string_view(next).substr(pos, new_end - pos),
+                                         first + fresh.size() + 1));
+            break;
+        }
+        fresh.push_back(lex_line(std::string_view(next).substr(pos, newline - pos), first + fresh.size() + 1));
+        pos = newline + 1;
+    }
+    edit.relexed_lines = fresh.size();
+    text.swap(next);
+
+    std::vector<Line*> old;
+    old.reserve(removed);
+    for (Line* line = removed ? select(first) : nullptr; old.size() < removed; line = line->next)
+        old.push_back(line);
+
+    // Lines whose tokens did not change (blanks or comments were edited)
+    // keep their nodes.
+    size_t head_kept = 0;
+    while (head_kept < fresh.size() && head_kept < removed &&
+           same_tokens(fresh[head_kept]->tokens, old[head_kept]->tokens))
+        ++head_kept;
+    size_t tail_kept = 0;
+    while (tail_kept < fresh.size() - head_kept && tail_kept < removed - head_kept &&
+           same_tokens(fresh[fresh.size() - 1 - tail_kept]->tokens, old[removed - 1 - tail_kept]->tokens))
+        ++tail_kept;
+    fresh.erase(fresh.end() - static_cast<ptrdiff_t>(tail_kept), fresh.end());
+    fresh.erase(fresh.begin(), fresh.begin() + static_cast<ptrdiff_t>(head_kept));
+    old.erase(old.end() - static_cast<ptrdiff_t>(tail_kept), old.end());
+    old.erase(old.begin(), old.begin() + static_cast<ptrdiff_t>(head_kept));
+    first += head_kept;
+    removed = old.size();
+    edit.first_line = first;
+    edit.removed_lines = removed;
+    edit.reparsed_lines = fresh.size();
+    if (!removed && fresh.empty()) return edit;
+
+    for (auto& line : fresh) {
+        TokenStream stream(line->tokens);
+        Parser parser(stream, line->arena);
+        line->nodes = parser.parse();
+        line->errors = parser.error_count();
+        edit.errors += line->errors;
+        edit.inserted_nodes += line->nodes.size();
+    }
+
+    bool patched = true;
+    for (const Line* line : old) {
+        patched = unlink(*line, edit.relinked) && patched;
+        errors -= line->errors;
+        edit.removed_nodes += line->nodes.size();
+    }
+    errors += edit.errors;
+
+    // Splice: the lines around the edit are found before the old lines go.
+    Line* before = first ? (removed ? old.front()->prev : select(first - 1)) : nullptr;
+    Line* after = removed ? old.back()->next : select(first);
+    Line *left, *rest, *middle, *right;
+    split(root, first, left, rest);
+    split(rest, removed, middle, right);
+    for (const Line* line : old) {
+        free_ids.push_back(line->id);
+        by_id[line->id].reset();
+    }
+
+    std::vector<Line*> added;
+    added.reserve(fresh.size());
+    for (auto& line : fresh) {
+        Line* adopted = adopt(std::move(line));
+        adopted->prev = added.empty() ? before : added.back();
+        if (!added.empty()) added.back()->next = adopted;
+        added.push_back(adopted);
+    }
+    Line* first_added = added.empty() ? after : added.front();
+    Line* last_added = added.empty() ? before : added.back();
+    if (before) before->next = first_added;
+    else head = first_added;
+    if (after) after->prev = last_added;
+    if (last_added) last_added->next = after;
+    root = merge(merge(left, build(added)), right);
+    root->parent = nullptr;
+
+    for (const Line* line : added)
+        fresh_nodes.insert(fresh_nodes.end(), line->nodes.begin(), line->nodes.end());
+    if (!patched) {
+        edit.relinked = relink_all();
+        return edit;
+    }
+    for (const Line* line : added)
+        for (size_t i = 0; i < line->nodes.size(); ++i)
+            link(line->nodes[i], *line, i, edit.relinked);
+    return edit;
+}
+
+void IncrementalProgram::pull(Line* tree) {
+    tree->lines = 1 + size(tree->left) + size(tree->right);
+    if (tree->left) tree->left->parent = tree;
+    if (tree->right) tree->right->parent = tree;
+}
+
+// The first `count` lines of `tree` go to `left`, the rest to `right`.
+void IncrementalProgram::split(Line* tree, size_t count, Line*& left, Line*& right) {
+    if (!tree) {
+        left = right = nullptr;
+    } else if (size(tree->left) < count) {
+        split(tree->right, count - size(tree->left) - 1, tree->right, right);
+        pull(tree);
+        left = tree;
+    } else {
+        split(tree->left, count, left, tree->left);
+        pull(tree);
+        right = tree;
+    }
+    if (left) left->parent = nullptr;
+    if (right) right->parent = nullptr;
+}
+
+IncrementalProgram::Line* IncrementalProgram::merge(Line* left, Line* right) {
+    if (!left) return right;
+    if (!right) return left;
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        pull(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    pull(right);
+    return right;
+}
+
+// A treap of lines already in program order, built in one pass: each line
+// takes the lines after the last one with a higher priority as its left
+// subtree and becomes that one's right child.
+IncrementalProgram::Line* IncrementalProgram::build(const std::vector<Line*>& lines) {
+    std::vector<Line*> spine;
+    for (Line* line : lines) {
+        line->right = nullptr;
+        Line* last = nullptr;
+        while (!spine.empty() && spine.back()->priority < line->priority) {
+            last = spine.back();
+            spine.pop_back();
+        }
+        line->left = last;
+        if (!spine.empty()) spine.back()->right = line;
+        spine.push_back(line);
+    }
+    if (spine.empty()) return nullptr;
+    count(spine.front());
+    spine.front()->parent = nullptr;
+    return spine.front();
+}
+
+void IncrementalProgram::count(Line* tree) {
+    if (!tree) return;
+    count(tree->left);
+    count(tree->right);
+    pull(tree);
+}
+
+IncrementalProgram::Line* IncrementalProgram::select(size_t number) const {
+    Line* tree = root;
+    while (tree) {
+        size_t before = size(tree->left);
+        if (number < before) {
+            tree = tree->left;
+        } else if (number == before) {
+            return tree;
+        } else {
+            number -= before + 1;
+            tree = tree->right;
+        }
+    }
+    return nullptr;
+}
+
+// The number of lines before `line`.
+size_t IncrementalProgram::rank(const Line* line) {
+    size_t before = size(line->left);
+    for (; line->parent; line = line->parent)
+        if (line == line->parent->right) before += size(line->parent->left) + 1;
+    return before;
+}
+
+size_t IncrementalProgram::slot(std::string_view name) {
+    auto it = slots.find(name);
+    if (it != slots.end()) return it->second;
+    names.emplace_back(name);
+    slot_targets.push_back(END);
+    labels.emplace_back();
+    return slots.emplace(names.back(), names.size() - 1).first->second;
+}
+
+// Drops the labels, jumps and calls of a line. Returns false when it held
+// the definition in effect of a label that is defined again elsewhere:
+// finding that one takes a rebuild.
+bool IncrementalProgram::unlink(const Line& line, size_t& relinked) {
+    bool patched = true;
+    for (size_t i = 0; i < line.nodes.size(); ++i) {
+        ASTNode* node = line.nodes[i];
+        if (node->kind == NodeKind::LABEL) {
+            size_t s = slot(static_cast<const LabelNode*>(node)->label);
+            if (--labels[s].definitions == 0) {
+                slot_targets[s] = END;
+                unresolved += labels[s].references;
+                ++relinked;
+            } else if (slot_targets[s] == position(&line, i + 1)) {
+                patched = false;
+            }
+        } else if (branch_label(node)) {
+            size_t s = branch_slot(node);
+            --labels[s].references;
+            if (slot_targets[s] == END) --unresolved;
+        }
+    }
+    return patched;
+}
+
+void IncrementalProgram::link(ASTNode* node, const Line& line, size_t index, size_t& relinked) {
+    if (node->kind == NodeKind::LABEL) {
+        size_t s = slot(static_cast<const LabelNode*>(node)->label);
+        if (labels[s].definitions++ == 0) {
+            unresolved -= labels[s].references;
+        } else {
+            const size_t current = slot_targets[s];
+            const Line* other = line_at(current);
+            if (other == &line ? (current & INDEX_MASK) > index : rank(other) > rank(&line)) return;
+        }
+        slot_targets[s] = position(&line, index + 1);
+        ++relinked;
+    } else if (const Token* label = branch_label(node)) {
+        size_t s = slot(label->value);
+        branch_slot(node) = s;
+        ++labels[s].references;
+        if (slot_targets[s] == END) ++unresolved;
+    }
+}
+
+size_t IncrementalProgram::relink_all() {
+    std::fill(slot_targets.begin(), slot_targets.end(), END);
+    std::fill(labels.begin(), labels.end(), Label());
+    unresolved = 0;
+    size_t relinked = 0;
+    for (const Line* line = head; line; line = line->next)
+        for (size_t i = 0; i < line->nodes.size(); ++i)
+            link(line->nodes[i], *line, i, relinked);
+    return relinked;
+}
+
+void IncrementalProgram::check_labels() const {
+    if (!unresolved) return;
+    size_t number = 1;
+    for (const Line* line = head; line; line = line->next, ++number) {
+        for (ASTNode* node : line->nodes) {
+            const Token* label = branch_label(node);
+            if (label && slot_targets[branch_slot(node)] == END)
+                throw std::runtime_error("Undefined label '" + std::string(label->value) + "' at line " +
+                                         std::to_string(number) + ", column " + std::to_string(label->column));
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "tokens.hpp"
+#include "../common/arena.hpp"
+#include "../common/nodes.hpp"
+
+// A program kept resident between edits, for --watch. No statement spans a
+// newline, so every line is lexed and parsed on its own and owns its text,
+// tokens and nodes. update() diffs the new text against the old one and
+// re-lexes only the lines between the common prefix and suffix; of those,
+// only lines whose tokens changed are re-parsed.
+//
+// Nothing refers to a node by its index in the whole program. A position
+// is a line's id and an index into that line, and lines are kept in a
+// treap ordered by program order, so finding a line by number or a line's
+// number takes O(log n) and splicing lines in or out does not touch the
+// others. Jumps and calls hold a slot, one per label name, holding the
+// position after the label. An edit therefore costs O(log n) plus the
+// lines and labels it touches, besides the diff of the text itself. Run
+// the program with BasicInterpreter::rerun(), which walks it through
+// start(), at(), next() and target().
+//
+// Token line numbers are the ones a line had when it was lexed; inserting
+// or removing lines above does not renumber it. check_labels() reports
+// current line numbers.
+class IncrementalProgram {
+public:
+    // Past the last node; also the target of a slot whose label is undefined.
+    static constexpr size_t END = SIZE_MAX;
+
+    // What one update() did.
+    struct Edit {
+        size_t first_line = 0;
+        size_t removed_lines = 0;
+        size_t relexed_lines = 0;
+        size_t reparsed_lines = 0;
+        size_t removed_nodes = 0;
+        size_t inserted_nodes = 0;
+        size_t relinked = 0; // label slots that were set or cleared
+        size_t errors = 0;   // syntax errors in the re-parsed lines
+
+        bool changed() const { return removed_lines || reparsed_lines; }
+    };
+
+    IncrementalProgram();
+
+    // Takes over the new text by swapping: on return `text` holds the
+    // previous one, so its buffer can be reused for the next read.
+    Edit update(std::string& text);
+
+    // The nodes parsed by the last update(), which still need their
+    // registers resolved.
+    const std::vector<ASTNode*>& added() const { return fresh_nodes; }
+
+    size_t start() const { return settle(head, 0); }
+    // nullptr at END.
+    const ASTNode* at(size_t position) const {
+        return position == END ? nullptr : line_at(position)->nodes[position & INDEX_MASK];
+    }
+    size_t next(size_t position) const { return settle(line_at(position), (position & INDEX_MASK) + 1); }
+    // Where a jump or call holding `slot` continues.
+    size_t target(size_t slot) const {
+        size_t after = slot_targets[slot];
+        return after == END ? END : settle(line_at(after), after & INDEX_MASK);
+    }
+    bool defined(size_t slot) const { return slot_targets[slot] != END; }
+
+    size_t line_count() const { return size(root); }
+    size_t error_count() const { return errors; }
+
+    // Throws std::runtime_error for the first jump or call whose label is
+    // not defined, worded as the tree interpreter words it.
+    void check_labels() const;
+
+private:
+    static constexpr size_t LINE_ARENA_BLOCK = 256;
+    static constexpr unsigned INDEX_BITS = 32;
+    static constexpr size_t INDEX_MASK = (size_t(1) << INDEX_BITS) - 1;
+
+    struct Line {
+        Arena arena{LINE_ARENA_BLOCK}; // the line's text and nodes
+        std::vector<Token> tokens;
+        std::vector<ASTNode*> nodes;
+        size_t errors = 0;
+        size_t id = 0;
+
+        Line* prev = nullptr; // program order
+        Line* next = nullptr;
+        Line* left = nullptr; // treap, by program order and priority
+        Line* right = nullptr;
+        Line* parent = nullptr;
+        uint32_t priority = 0;
+        size_t lines = 1; // in this subtree
+    };
+
+    // Per slot. The last definition of a label wins, as in the interpreter.
+    struct Label {
+        size_t definitions = 0;
+        size_t references = 0;
+    };
+
+    std::string text;
+    std::vector<std::unique_ptr<Line>> by_id;
+    std::vector<size_t> free_ids;
+    Line* root = nullptr;
+    Line* head = nullptr; // the first line
+    std::minstd_rand random;
+
+    std::deque<std::string> names; // slot names; the map keys view them
+    std::unordered_map<std::string_view, size_t> slots;
+    std::vector<size_t> slot_targets;
+    std::vector<Label> labels;
+    size_t unresolved = 0; // jumps and calls to undefined labels
+    size_t errors = 0;
+
+    std::vector<Token> scratch;
+    std::vector<ASTNode*> fresh_nodes;
+
+    static size_t position(const Line* line, size_t index) { return (line->id << INDEX_BITS) | index; }
+    const Line* line_at(size_t position) const { return by_id[position >> INDEX_BITS].get(); }
+    // The first node at or after `index` in `line` or the lines after it.
+    static size_t settle(const Line* line, size_t index) {
+        while (index == line->nodes.size()) {
+            line = line->next;
+            if (!line) return END;
+            index = 0;
+        }
+        return position(line, index);
+    }
+
+    static size_t size(const Line* tree) { return tree ? tree->lines : 0; }
+    static void pull(Line* tree);
+    static void split(Line* tree, size_t count, Line*& left, Line*& right);
+    static Line* merge(Line* left, Line* right);
+    static Line* build(const std::vector<Line*>& lines);
+    static void count(Line* tree);
+    Line* select(size_t number) const;
+    static size_t rank(const Line* line);
+
+    std::unique_ptr<Line> lex_line(std::string_view source, size_t number);
+    Line* adopt(std::unique_ptr<Line> line);
+    size_t slot(std::string_view name);
+    bool unlink(const Line& line, size_t& relinked);
+    void link(ASTNode* node, const Line& line, size_t index, size_t& relinked);
+    size_t relink_all();
+};
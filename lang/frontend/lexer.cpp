@@ -1,171 +1,96 @@
 #include "lexer.hpp"
-#include <cctype>
 
-Lexer::Lexer(const std::string& src)
-    : source(src), pos(0), line(1), column(0), current_char('\0') {
-    if (!source.empty())
-        current_char = source[0];
-}
-
-void Lexer::advance() {
-    if (current_char == '\n') {
-        ++line;
-        column = 0;
-    } else {
-        ++column;
-    }
-    if (++pos < source.size())
-        current_char = source[pos];
-    else
-        current_char = '\0';
-}
-
-char Lexer::peek() const {
-    if (pos + 1 < source.size())
-        return source[pos + 1];
-    return '\0';
-}
-
-void Lexer::skip_whitespace() {
-    while (current_char == ' ' || current_char == '\t' || current_char == '\r')
-        advance();
-}
-
-void Lexer::skip_comment() {
-    while (current_char && current_char != '\n')
-        advance();
-}
-
-bool Lexer::is_at_end() const {
-    return current_char == '\0';
-}
-
-bool Lexer::is_digit(char c) const {
-    return std::isdigit(static_cast<unsigned char>(c));
-}
-
-bool Lexer::is_alpha(char c) const {
-    return std::isalpha(static_cast<unsigned char>(c));
-}
-
-bool Lexer::is_alnum(char c) const {
-    return std::isalnum(static_cast<unsigned char>(c));
-}
+Lexer::Lexer(std::string_view src)
+    : source(src), scan(scan_kernels()), pos(0), line_start(0), line(1) {}
 
 Token Lexer::make_number() {
-    std::string value;
-    int start_col = column;
-    while (is_digit(current_char)) {
-        value += current_char;
-        advance();
-    }
-    return Token(TokenType::INT, value, line, start_col);
-}
-
-Token Lexer::make_identifier_or_keyword() {
-    std::string value;
-    int start_col = column;
-    while (is_alnum(current_char) || current_char == '_') {
-        value += current_char;
-        advance();
-    }
-    TokenType type = TokenType::IDENT;
-    for (const auto& kw : keywords) {
-        if (value == kw) {
-            type = TokenType::KEYWORD;
-            break;
-        }
-    }
-    return Token(type, value, line, start_col);
+    size_t start = pos;
+    int start_col = column();
+    if (++pos < source.size() && (char_class(source[pos]) & CHAR_DIGIT))
+        pos = scan.skip_digits(source.data(), pos + 1, source.size());
+    return Token(TokenType::INT, source.substr(start, pos - start), line, start_col);
 }
 
-Token Lexer::make_label() {
-    std::string value;
-    int start_col = column;
-    while (is_alnum(current_char) || current_char == '_') {
-        value += current_char;
-        advance();
-    }
-    if (current_char == ':') {
-        advance();
+// One scan finds the end of the word; a ':' right after it makes the word a
+// label, unless it starts with '_' (labels must start with a letter).
+Token Lexer::make_word() {
+    size_t start = pos;
+    int start_col = column();
+    if (++pos < source.size() && (char_class(source[pos]) & CHAR_WORD))
+        pos = scan.skip_word(source.data(), pos + 1, source.size());
+    std::string_view value = source.substr(start, pos - start);
+    if (pos < source.size() && source[pos] == ':' && (char_class(value[0]) & CHAR_ALPHA)) {
+        ++pos;
         return Token(TokenType::LABEL, value, line, start_col);
     }
-    return Token(TokenType::IDENT, value, line, start_col);
+    Mnemonic op = find_instruction(value);
+    return Token(op == Mnemonic::NONE ? TokenType::IDENT : TokenType::KEYWORD, value, line, start_col, op);
 }
 
-std::vector<Token> Lexer::tokenize() {
-    std::vector<Token> tokens;
-    while (!is_at_end()) {
-        skip_whitespace();
+Token Lexer::make_single(TokenType type, std::string_view text) {
+    Token token(type, text, line, column());
+    ++pos;
+    return token;
+}
 
-        if (current_char == ';') {
-            skip_comment();
-            continue;
+Token Lexer::next_token() {
+    const char* text = source.data();
+    const size_t end = source.size();
+    // A NUL byte ends the source, as it always has.
+    while (pos < end && text[pos] != '\0') {
+        // Most runs are a single space; only longer ones go to the scanner.
+        if (char_class(text[pos]) & CHAR_BLANK) {
+            if (++pos < end && (char_class(text[pos]) & CHAR_BLANK))
+                pos = scan.skip_blanks(text, pos + 1, end);
+        }
+        if (pos == end) {
+            // Trailing blanks: step past the end so the EOF column stays
+            // one past the last blank.
+            ++pos;
+            break;
         }
 
-        if (is_digit(current_char)) {
-            tokens.push_back(make_number());
+        char c = text[pos];
+        if (c == ';') {
+            pos = scan.skip_line(text, pos + 1, end);
             continue;
         }
 
-        if (is_alpha(current_char) && peek() != '\0') {
-            size_t temp_pos = pos;
-            while ((is_alnum(source[temp_pos]) || source[temp_pos] == '_') && temp_pos < source.size())
-                ++temp_pos;
-            if (source[temp_pos] == ':') {
-                tokens.push_back(make_label());
-                continue;
+        uint8_t cls = char_class(c);
+        if (cls & CHAR_DIGIT)
+            return make_number();
+        if (cls & CHAR_WORD)
+            return make_word();
+
+        switch (c) {
+            case '+': return make_single(TokenType::PLUS, "+");
+            case '-': return make_single(TokenType::MINUS, "-");
+            case '*': return make_single(TokenType::MUL, "*");
+            case '/': return make_single(TokenType::DIV, "/");
+            case '=': return make_single(TokenType::EQ, "=");
+            case ',': return make_single(TokenType::COMMA, ",");
+            case ':': return make_single(TokenType::COLON, ":");
+            case '[': return make_single(TokenType::LBRACKET, "[");
+            case ']': return make_single(TokenType::RBRACKET, "]");
+            case '\n': {
+                Token token = make_single(TokenType::NEWLINE, "\\n");
+                ++line;
+                line_start = pos;
+                return token;
             }
+            default: break;
         }
 
-        if (is_alpha(current_char) || current_char == '_') {
-            tokens.push_back(make_identifier_or_keyword());
-            continue;
-        }
-
-        if (current_char == '+') {
-            tokens.emplace_back(TokenType::PLUS, "+", line, column);
-            advance();
-            continue;
-        }
-        if (current_char == '-') {
-            tokens.emplace_back(TokenType::MINUS, "-", line, column);
-            advance();
-            continue;
-        }
-        if (current_char == '*') {
-            tokens.emplace_back(TokenType::MUL, "*", line, column);
-            advance();
-            continue;
-        }
-        if (current_char == '/') {
-            tokens.emplace_back(TokenType::DIV, "/", line, column);
-            advance();
-            continue;
-        }
-        if (current_char == '=') {
-            tokens.emplace_back(TokenType::EQ, "=", line, column);
-            advance();
-            continue;
-        }
-        if (current_char == ',') {
-            tokens.emplace_back(TokenType::COMMA, ",", line, column);
-            advance();
-            continue;
-        }
-        if (current_char == ':') {
-            tokens.emplace_back(TokenType::COLON, ":", line, column);
-            advance();
-            continue;
-        }
-        if (current_char == '\n') {
-            tokens.emplace_back(TokenType::NEWLINE, "\\n", line, column);
-            advance();
-            continue;
-        }
+        ++pos;
+    }
+    return Token(TokenType::EOF_TOKEN, "", line, column());
+}
 
-        advance();
+std::vector<Token> Lexer::tokenize() {
+    std::vector<Token> tokens;
+    while (true) {
+        tokens.push_back(next_token());
+        if (tokens.back().type == TokenType::EOF_TOKEN) break;
     }
-    tokens.emplace_back(TokenType::EOF_TOKEN, "", line, column);
     return tokens;
-}
\ No newline at end of file
+}
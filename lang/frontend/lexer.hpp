@@ -1,31 +1,29 @@
 #pragma once
-#include <string>
+#include <string_view>
 #include <vector>
+#include "scan.hpp"
 #include "tokens.hpp"
 
+// Runs of blanks, comments, words and numbers are measured with the SIMD
+// scanners from scan.hpp. Every newline is a token, so the line count moves
+// only there and a column is the distance from the start of its line.
 class Lexer {
 public:
-    Lexer(const std::string& src);
+    Lexer(std::string_view src);
 
     std::vector<Token> tokenize();
+    Token next_token();
+    size_t offset() const { return pos; }
 
 private:
-    std::string source;
+    std::string_view source;
+    const ScanKernels& scan;
     size_t pos;
+    size_t line_start;
     int line;
-    int column;
-    char current_char;
 
-    void advance();
-    char peek() const;
-    void skip_whitespace();
-    void skip_comment();
+    int column() const { return static_cast<int>(pos - line_start); }
     Token make_number();
-    Token make_identifier_or_keyword();
-    Token make_label();
-
-    bool is_at_end() const;
-    bool is_digit(char c) const;
-    bool is_alpha(char c) const;
-    bool is_alnum(char c) const;
-};
\ No newline at end of file
+    Token make_word();
+    Token make_single(TokenType type, std::string_view text);
+};
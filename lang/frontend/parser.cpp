@@ -1,8 +1,17 @@
 #include "parser.hpp"
+#include <charconv>
 #include <iostream>
 
-Parser::Parser(const std::vector<Token>& toks)
-    : tokens(toks), token_idx(-1), current_token(Token(TokenType::EOF_TOKEN, "")) {
+#include "../common/vector.hpp"
+
+Parser::Parser(const std::vector<Token>& toks, Arena& arena)
+    : owned_stream(std::make_unique<TokenStream>(toks)), stream(owned_stream.get()),
+      arena(arena), current_token(Token(TokenType::EOF_TOKEN, "")) {
+    advance();
+}
+
+Parser::Parser(TokenStream& stream, Arena& arena)
+    : stream(&stream), arena(arena), current_token(Token(TokenType::EOF_TOKEN, "")) {
     advance();
 }
 
@@ -20,17 +29,15 @@ std::string tokenTypeToString(TokenType type) {
         case TokenType::NEWLINE: return "NEWLINE";
         case TokenType::LABEL: return "LABEL";
         case TokenType::COLON: return "COLON";
+        case TokenType::LBRACKET: return "LBRACKET";
+        case TokenType::RBRACKET: return "RBRACKET";
         case TokenType::EOF_TOKEN: return "EOF_TOKEN";
         default: return "UNKNOWN";
     }
 }
 
 void Parser::advance() {
-    token_idx++;
-    if (token_idx < tokens.size())
-        current_token = tokens[token_idx];
-    else
-        current_token = Token(TokenType::EOF_TOKEN, "");
+    current_token = stream->next();
 }
 
 bool Parser::is_at_end() const {
@@ -42,38 +49,61 @@ void Parser::skip_newlines() {
         advance();
 }
 
-std::vector<std::unique_ptr<ASTNode>> Parser::parse() {
-    std::vector<std::unique_ptr<ASTNode>> nodes;
+std::vector<ASTNode*> Parser::parse() {
+    std::vector<ASTNode*> nodes;
+    while (auto node = parse_next())
+        nodes.push_back(node);
+    return nodes;
+}
+
+ASTNode* Parser::parse_next() {
     while (!is_at_end()) {
         skip_newlines();
         if (is_at_end()) break;
+        size_t before = stream->consumed();
         auto node = statement();
-        if (node) nodes.push_back(std::move(node));
+        if (!node && stream->consumed() == before) {
+            // Nothing can start with this token; skip it rather than loop.
+            ++errors;
+            *diagnostics << "Parser error: Unexpected '" << current_token.value << "'\n";
+            advance();
+        }
         skip_newlines();
+        if (node) return node;
     }
-    return nodes;
+    return nullptr;
 }
 
-std::unique_ptr<ASTNode> Parser::statement() {
-    if (current_token.type == TokenType::KEYWORD) {
-        if (current_token.value == "let") return assignment();
-        if (current_token.value == "add" || current_token.value == "sub" ||
-            current_token.value == "mul" || current_token.value == "div")
-            return parse_binop();
-        if (current_token.value == "jmp" || current_token.value == "je" ||
-            current_token.value == "jne" || current_token.value == "jl" ||
-            current_token.value == "jg" || current_token.value == "jle" ||
-            current_token.value == "jge")
-            return parse_jump();
-        if (current_token.value == "cmp") return parse_cmp();
-        if (current_token.value == "print") return parse_print();
+constexpr std::array<Parser::StatementParser, INSTRUCTION_COUNT + 1> Parser::statement_parsers = [] {
+    std::array<StatementParser, INSTRUCTION_COUNT + 1> table{};
+    table[static_cast<size_t>(Mnemonic::NONE)] = &Parser::expression;
+    for (const auto& in : instructions) {
+        StatementParser parse = &Parser::expression;
+        switch (in.shape) {
+            case OperandShape::ASSIGN: parse = &Parser::assignment; break;
+            case OperandShape::BINARY: parse = &Parser::parse_binop; break;
+            case OperandShape::COMPARE: parse = &Parser::parse_cmp; break;
+            case OperandShape::JUMP: parse = &Parser::parse_jump; break;
+            case OperandShape::PRINT: parse = &Parser::parse_print; break;
+            case OperandShape::READ: parse = &Parser::parse_read; break;
+            case OperandShape::VECTOR: parse = &Parser::parse_vector; break;
+            case OperandShape::MEMORY: parse = &Parser::parse_memory; break;
+            case OperandShape::STACK: parse = &Parser::parse_stack; break;
+        }
+        table[static_cast<size_t>(in.mnemonic)] = parse;
     }
+    return table;
+}();
+
+ASTNode* Parser::statement() {
+    if (current_token.type == TokenType::KEYWORD)
+        return (this->*statement_parsers[static_cast<size_t>(current_token.op)])();
     if (current_token.type == TokenType::LABEL)
         return parse_label();
     return expression();
 }
 
-std::unique_ptr<ASTNode> Parser::assignment() {
+ASTNode* Parser::assignment() {
     advance();
     if (current_token.type != TokenType::IDENT) return nullptr;
     Token var_token = current_token;
@@ -81,10 +111,10 @@ std::unique_ptr<ASTNode> Parser::assignment() {
     if (current_token.type != TokenType::EQ) return nullptr;
     advance();
     auto value = expression();
-    return std::make_unique<AssignmentNode>(var_token, std::move(value));
+    return arena.make<AssignmentNode>(var_token, value);
 }
 
-std::unique_ptr<ASTNode> Parser::expression() {
+ASTNode* Parser::expression() {
     if (current_token.type == TokenType::INT)
         return parse_number();
     if (current_token.type == TokenType::IDENT)
@@ -92,74 +122,284 @@ std::unique_ptr<ASTNode> Parser::expression() {
     return nullptr;
 }
 
-std::unique_ptr<ASTNode> Parser::parse_number() {
-    auto node = std::make_unique<NumberNode>(current_token);
+ASTNode* Parser::parse_number() {
+    auto node = arena.make<NumberNode>(current_token);
     advance();
     return node;
 }
 
-std::unique_ptr<ASTNode> Parser::parse_identifier() {
-    auto node = std::make_unique<IdentifierNode>(current_token);
+IdentifierNode* Parser::parse_identifier() {
+    auto node = arena.make<IdentifierNode>(current_token);
     advance();
     return node;
 }
 
-std::unique_ptr<ASTNode> Parser::parse_binop() {
-    Token op_token = current_token; // "add", "sub", etc.
+ASTNode* Parser::parse_binop() {
+    Token op_token = current_token; // op is ADD, SUB, MUL or DIV
     advance();
     if (current_token.type != TokenType::IDENT) return nullptr;
     auto left = parse_identifier();
     if (current_token.type != TokenType::COMMA) return nullptr;
     advance();
     auto right = expression();
-    return std::make_unique<BinOpNode>(std::move(left), op_token, std::move(right));
+    return arena.make<BinOpNode>(left, op_token, right);
 }
 
-std::unique_ptr<ASTNode> Parser::parse_label() {
-    std::string label_name = current_token.value;
+ASTNode* Parser::parse_label() {
+    std::string_view label_name = current_token.value;
     advance();
-    return std::make_unique<LabelNode>(label_name);
+    return arena.make<LabelNode>(label_name);
 }
 
-std::unique_ptr<ASTNode> Parser::parse_jump() {
-    std::string jump_type = current_token.value;
+ASTNode* Parser::parse_jump() {
+    auto kind = static_cast<JumpKind>(instruction(current_token.op).variant);
     advance();
     if (current_token.type != TokenType::IDENT) return nullptr;
-    std::string label_name = current_token.value;
+    Token label_token = current_token;
     advance();
-    return std::make_unique<JumpNode>(jump_type, label_name);
+    return arena.make<JumpNode>(kind, label_token);
 }
 
-std::unique_ptr<ASTNode> Parser::parse_cmp() {
+ASTNode* Parser::parse_cmp() {
     advance();
     auto left = expression();
     if (!left) {
-        std::cerr << "Parser error: Expected expression after 'cmp', got " << current_token.value << std::endl;
+        ++errors;
+        *diagnostics << "Parser error: Expected expression after 'cmp', got " << current_token.value << std::endl;
         advance();
         return nullptr;
     }
 
     if (current_token.type != TokenType::COMMA) {
-        std::cerr << "Parser error: Expected ',' after first expression in cmp, got " << current_token.value << std::endl;
+        ++errors;
+        *diagnostics << "Parser error: Expected ',' after first expression in cmp, got " << current_token.value << std::endl;
         advance();
         return nullptr;
     }
     advance();
     auto right = expression();
     if (!right) {
-        std::cerr << "Parser error: Expected right-hand expression in cmp, got " << current_token.value << std::endl;
+        ++errors;
+        *diagnostics << "Parser error: Expected right-hand expression in cmp, got " << current_token.value << std::endl;
         advance();
         return nullptr;
     }
-    return std::make_unique<CmpNode>(std::move(left), std::move(right));
+    return arena.make<CmpNode>(left, right);
 }
 
-std::unique_ptr<ASTNode> Parser::parse_print() {
+ASTNode* Parser::parse_print() {
     advance();
     auto expr = expression();
     if (!expr) {
-        std::cerr << "Parser error: Expected expression after 'print'\n";
+        ++errors;
+        *diagnostics << "Parser error: Expected expression after 'print'\n";
+        return nullptr;
+    }
+    return arena.make<PrintNode>(expr);
+}
+
+ASTNode* Parser::parse_read() {
+    advance();
+    if (current_token.type != TokenType::IDENT) {
+        ++errors;
+        *diagnostics << "Parser error: Expected register after 'read', got " << current_token.value << std::endl;
         return nullptr;
     }
-    return std::make_unique<PrintNode>(std::move(expr));
-}
\ No newline at end of file
+    auto node = arena.make<ReadNode>(current_token);
+    advance();
+    return node;
+}
+
+ASTNode* Parser::parse_vector() {
+    Token op_token = current_token;
+    auto op = static_cast<VectorOp>(instruction(op_token.op).variant);
+    advance();
+    auto node = arena.make<VectorNode>(op, op_token);
+    if (parse_vector_operands(node)) return node;
+    // Drop the rest of the statement so parsing resumes on the next line.
+    while (!is_at_end() && current_token.type != TokenType::NEWLINE)
+        advance();
+    return nullptr;
+}
+
+bool Parser::parse_vector_operands(VectorNode* node) {
+    std::string_view name = node->op_token.value;
+    switch (node->op) {
+        case VectorOp::ADD: case VectorOp::SUB: case VectorOp::MUL: case VectorOp::CMP:
+            if (!parse_vector_register(node->vector) || !expect_comma(name) ||
+                !parse_vector_register(node->source))
+                return false;
+            break;
+        case VectorOp::BROADCAST: case VectorOp::SET:
+            if (!parse_vector_register(node->vector) || !expect_comma(name)) return false;
+            if (node->op == VectorOp::SET) {
+                if (current_token.type != TokenType::INT || current_token.value.size() != 1 ||
+                    current_token.value[0] - '0' >= static_cast<int>(VECTOR_LANES)) {
+                    ++errors;
+                    *diagnostics << "Parser error: Expected lane 0.." << VECTOR_LANES - 1
+                              << " in vset, got " << current_token.value << std::endl;
+                    return false;
+                }
+                node->lane = current_token.value[0] - '0';
+                advance();
+                if (!expect_comma(name)) return false;
+            }
+            node->scalar = expression();
+            if (!node->scalar) {
+                ++errors;
+                *diagnostics << "Parser error: Expected expression in " << name << ", got "
+                          << current_token.value << std::endl;
+                return false;
+            }
+            break;
+        case VectorOp::SUM: case VectorOp::MIN: case VectorOp::MAX:
+            if (current_token.type != TokenType::IDENT) {
+                ++errors;
+                *diagnostics << "Parser error: Expected register after '" << name << "', got "
+                          << current_token.value << std::endl;
+                return false;
+            }
+            node->scalar = parse_identifier();
+            if (!expect_comma(name) || !parse_vector_register(node->source)) return false;
+            break;
+        case VectorOp::PRINT:
+            if (!parse_vector_register(node->source)) return false;
+            break;
+    }
+    return true;
+}
+
+bool Parser::parse_vector_register(int& index) {
+    index = current_token.type == TokenType::IDENT ? vector_register(current_token.value) : -1;
+    if (index < 0) {
+        ++errors;
+        *diagnostics << "Parser error: Expected vector register v0..v" << VECTOR_REGISTERS - 1
+                  << ", got " << current_token.value << std::endl;
+        return false;
+    }
+    advance();
+    return true;
+}
+
+bool Parser::expect_comma(std::string_view after) {
+    if (current_token.type != TokenType::COMMA) {
+        ++errors;
+        *diagnostics << "Parser error: Expected ',' in " << after << ", got " << current_token.value << std::endl;
+        return false;
+    }
+    advance();
+    return true;
+}
+
+ASTNode* Parser::parse_memory() {
+    Token op_token = current_token;
+    auto op = static_cast<MemoryOp>(instruction(op_token.op).variant);
+    advance();
+    auto node = arena.make<MemoryNode>(op, op_token);
+    if (parse_memory_operands(node)) return node;
+    while (!is_at_end() && current_token.type != TokenType::NEWLINE)
+        advance();
+    return nullptr;
+}
+
+bool Parser::parse_memory_operands(MemoryNode* node) {
+    std::string_view name = node->op_token.value;
+    switch (node->op) {
+        case MemoryOp::LOAD:
+            if (current_token.type != TokenType::IDENT) {
+                ++errors;
+                *diagnostics << "Parser error: Expected register after 'load', got " << current_token.value << std::endl;
+                return false;
+            }
+            node->args[0] = parse_identifier();
+            return expect_comma(name) && parse_address(node);
+        case MemoryOp::STORE:
+            return parse_address(node) && expect_comma(name) && parse_operand(node->args[0], name);
+        case MemoryOp::COPY: case MemoryOp::FILL:
+            return parse_operand(node->args[0], name) && expect_comma(name) &&
+                   parse_operand(node->args[1], name) && expect_comma(name) &&
+                   parse_operand(node->args[2], name);
+    }
+    return false;
+}
+
+// [base], [base + n] or [base - n], where base is a register or a number.
+bool Parser::parse_address(MemoryNode* node) {
+    if (current_token.type != TokenType::LBRACKET) {
+        ++errors;
+        *diagnostics << "Parser error: Expected '[' in " << node->op_token.value << ", got "
+                  << current_token.value << std::endl;
+        return false;
+    }
+    advance();
+    if (!parse_operand(node->base, node->op_token.value)) return false;
+    if (current_token.type == TokenType::PLUS || current_token.type == TokenType::MINUS) {
+        bool negative = current_token.type == TokenType::MINUS;
+        advance();
+        std::string_view digits = current_token.value;
+        if (current_token.type != TokenType::INT ||
+            std::from_chars(digits.data(), digits.data() + digits.size(), node->offset).ec != std::errc()) {
+            ++errors;
+            *diagnostics << "Parser error: Expected offset in address, got " << current_token.value << std::endl;
+            return false;
+        }
+        if (negative) node->offset = -node->offset;
+        advance();
+    }
+    if (current_token.type != TokenType::RBRACKET) {
+        ++errors;
+        *diagnostics << "Parser error: Expected ']' in address, got " << current_token.value << std::endl;
+        return false;
+    }
+    advance();
+    return true;
+}
+
+ASTNode* Parser::parse_stack() {
+    Token op_token = current_token;
+    auto op = static_cast<StackOp>(instruction(op_token.op).variant);
+    advance();
+    auto node = arena.make<StackNode>(op, op_token);
+    if (parse_stack_operands(node)) return node;
+    while (!is_at_end() && current_token.type != TokenType::NEWLINE)
+        advance();
+    return nullptr;
+}
+
+bool Parser::parse_stack_operands(StackNode* node) {
+    std::string_view name = node->op_token.value;
+    switch (node->op) {
+        case StackOp::CALL:
+            if (current_token.type != TokenType::IDENT) {
+                ++errors;
+                *diagnostics << "Parser error: Expected label after 'call', got " << current_token.value << std::endl;
+                return false;
+            }
+            node->label = current_token;
+            advance();
+            return true;
+        case StackOp::RET:
+            return true;
+        case StackOp::PUSH:
+            return parse_operand(node->operand, name);
+        case StackOp::POP:
+            if (current_token.type != TokenType::IDENT) {
+                ++errors;
+                *diagnostics << "Parser error: Expected register after 'pop', got " << current_token.value << std::endl;
+                return false;
+            }
+            node->operand = parse_identifier();
+            return true;
+    }
+    return false;
+}
+
+bool Parser::parse_operand(ASTNode*& operand, std::string_view in) {
+    operand = expression();
+    if (!operand) {
+        ++errors;
+        *diagnostics << "Parser error: Expected expression in " << in << ", got " << current_token.value << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -1,32 +1,62 @@
 #pragma once
+#include <array>
+#include <iostream>
 #include <vector>
 #include <memory>
+#include <string_view>
 #include "../frontend/tokens.hpp"
+#include "../frontend/token_stream.hpp"
 #include "../common/nodes.hpp"
 
 class Parser {
 public:
-    Parser(const std::vector<Token>& tokens);
+    Parser(const std::vector<Token>& tokens, Arena& arena);
+    Parser(TokenStream& stream, Arena& arena);
 
-    std::vector<std::unique_ptr<ASTNode>> parse();
+    std::vector<ASTNode*> parse();
+    // Parses the next statement; returns nullptr once the input is exhausted.
+    // Nodes are allocated from the arena passed to the constructor.
+    ASTNode* parse_next();
+    // Number of syntax errors reported so far.
+    size_t error_count() const { return errors; }
+    // Syntax errors go to std::cerr unless sent elsewhere.
+    void report_to(std::ostream& out) { diagnostics = &out; }
 
 private:
-    std::vector<Token> tokens;
-    int token_idx;
+    // Statement parsers indexed by Mnemonic, built from the instruction table.
+    using StatementParser = ASTNode* (Parser::*)();
+    static const std::array<StatementParser, INSTRUCTION_COUNT + 1> statement_parsers;
+
+    std::unique_ptr<TokenStream> owned_stream;
+    TokenStream* stream;
+    Arena& arena;
     Token current_token;
+    size_t errors = 0;
+    std::ostream* diagnostics = &std::cerr;
 
     void advance();
     bool is_at_end() const;
     void skip_newlines();
 
-    std::unique_ptr<ASTNode> statement();
-    std::unique_ptr<ASTNode> assignment();
-    std::unique_ptr<ASTNode> expression();
-    std::unique_ptr<ASTNode> parse_number();
-    std::unique_ptr<ASTNode> parse_identifier();
-    std::unique_ptr<ASTNode> parse_binop();
-    std::unique_ptr<ASTNode> parse_label();
-    std::unique_ptr<ASTNode> parse_jump();
-    std::unique_ptr<ASTNode> parse_cmp();
-    std::unique_ptr<ASTNode> parse_print();
+    ASTNode* statement();
+    ASTNode* assignment();
+    ASTNode* expression();
+    ASTNode* parse_number();
+    IdentifierNode* parse_identifier();
+    ASTNode* parse_binop();
+    ASTNode* parse_label();
+    ASTNode* parse_jump();
+    ASTNode* parse_cmp();
+    ASTNode* parse_print();
+    ASTNode* parse_read();
+    ASTNode* parse_vector();
+    bool parse_vector_operands(VectorNode* node);
+    bool parse_vector_register(int& index);
+    bool expect_comma(std::string_view after);
+    ASTNode* parse_memory();
+    bool parse_memory_operands(MemoryNode* node);
+    bool parse_address(MemoryNode* node);
+    ASTNode* parse_stack();
+    bool parse_stack_operands(StackNode* node);
+    bool parse_operand(ASTNode*& operand, std::string_view in);
 };
\ No newline at end of file
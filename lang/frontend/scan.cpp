@@ -0,0 +1,200 @@
+#include "scan.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ASMPLE_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define ASMPLE_SCAN_X86 0
+#endif
+
+namespace {
+
+using Scanner = size_t (*)(const char* text, size_t pos, size_t end);
+
+size_t skip_class(const char* text, size_t pos, size_t end, uint8_t cls) {
+    while (pos < end && (char_class(text[pos]) & cls))
+        ++pos;
+    return pos;
+}
+
+size_t scalar_skip_blanks(const char* text, size_t pos, size_t end) {
+    return skip_class(text, pos, end, CHAR_BLANK);
+}
+
+size_t scalar_skip_word(const char* text, size_t pos, size_t end) {
+    return skip_class(text, pos, end, CHAR_WORD);
+}
+
+size_t scalar_skip_digits(const char* text, size_t pos, size_t end) {
+    return skip_class(text, pos, end, CHAR_DIGIT);
+}
+
+size_t scalar_skip_line(const char* text, size_t pos, size_t end) {
+    while (pos < end && text[pos] != '\n' && text[pos] != '\0')
+        ++pos;
+    return pos;
+}
+
+const ScanKernels SCALAR = {
+    "scalar", scalar_skip_blanks, scalar_skip_word, scalar_skip_digits, scalar_skip_line
+};
+
+#if ASMPLE_SCAN_X86
+
+// Each *_stops function returns a mask with one bit per byte of the block
+// that ends the run; the scan loop stops at the lowest one. Ranges use the
+// signed-compare trick: shifting [low, low + count) down to the bottom of
+// the int8 range turns the range test into one compare.
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 __m128i sse2_in_range(__m128i bytes, int low, int count) {
+    __m128i shifted = _mm_add_epi8(bytes, _mm_set1_epi8(static_cast<char>(-128 - low)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + count)));
+}
+
+SSE2 unsigned sse2_mask(__m128i matches) {
+    return static_cast<unsigned>(_mm_movemask_epi8(matches));
+}
+
+SSE2 unsigned sse2_blank_stops(__m128i bytes) {
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                                 _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+    blank = _mm_or_si128(blank, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')));
+    return ~sse2_mask(blank) & 0xFFFFu;
+}
+
+SSE2 unsigned sse2_word_stops(__m128i bytes) {
+    __m128i letter = sse2_in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 26);
+    __m128i word = _mm_or_si128(letter, sse2_in_range(bytes, '0', 10));
+    word = _mm_or_si128(word, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+    return ~sse2_mask(word) & 0xFFFFu;
+}
+
+SSE2 unsigned sse2_digit_stops(__m128i bytes) {
+    return ~sse2_mask(sse2_in_range(bytes, '0', 10)) & 0xFFFFu;
+}
+
+SSE2 unsigned sse2_line_stops(__m128i bytes) {
+    return sse2_mask(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')),
+                                  _mm_cmpeq_epi8(bytes, _mm_setzero_si128())));
+}
+
+template <unsigned (*Stops)(__m128i), Scanner Tail>
+SSE2 size_t sse2_scan(const char* text, size_t pos, size_t end) {
+    for (; pos + 16 <= end; pos += 16) {
+        unsigned stops = Stops(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos)));
+        if (stops) return pos + static_cast<size_t>(__builtin_ctz(stops));
+    }
+    return Tail(text, pos, end);
+}
+
+#undef SSE2
+
+const ScanKernels SSE2_KERNELS = {
+    "sse2",
+    sse2_scan<sse2_blank_stops, scalar_skip_blanks>,
+    sse2_scan<sse2_word_stops, scalar_skip_word>,
+    sse2_scan<sse2_digit_stops, scalar_skip_digits>,
+    sse2_scan<sse2_line_stops, scalar_skip_line>,
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 __m256i avx2_in_range(__m256i bytes, int low, int count) {
+    __m256i shifted = _mm256_add_epi8(bytes, _mm256_set1_epi8(static_cast<char>(-128 - low)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + count)), shifted);
+}
+
+AVX2 unsigned avx2_mask(__m256i matches) {
+    return static_cast<unsigned>(_mm256_movemask_epi8(matches));
+}
+
+AVX2 unsigned avx2_blank_stops(__m256i bytes) {
+    __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')));
+    blank = _mm256_or_si256(blank, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')));
+    return ~avx2_mask(blank);
+}
+
+AVX2 unsigned avx2_word_stops(__m256i bytes) {
+    __m256i letter = avx2_in_range(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 26);
+    __m256i word = _mm256_or_si256(letter, avx2_in_range(bytes, '0', 10));
+    word = _mm256_or_si256(word, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+    return ~avx2_mask(word);
+}
+
+AVX2 unsigned avx2_digit_stops(__m256i bytes) {
+    return ~avx2_mask(avx2_in_range(bytes, '0', 10));
+}
+
+AVX2 unsigned avx2_line_stops(__m256i bytes) {
+    return avx2_mask(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')),
+                                     _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256())));
+}
+
+// The tail under 32 bytes still takes one 16-byte step where it can.
+template <unsigned (*Stops)(__m256i), Scanner Tail>
+AVX2 size_t avx2_scan(const char* text, size_t pos, size_t end) {
+    for (; pos + 32 <= end; pos += 32) {
+        unsigned stops = Stops(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos)));
+        if (stops) return pos + static_cast<size_t>(__builtin_ctz(stops));
+    }
+    return Tail(text, pos, end);
+}
+
+#undef AVX2
+
+const ScanKernels AVX2_KERNELS = {
+    "avx2",
+    avx2_scan<avx2_blank_stops, sse2_scan<sse2_blank_stops, scalar_skip_blanks>>,
+    avx2_scan<avx2_word_stops, sse2_scan<sse2_word_stops, scalar_skip_word>>,
+    avx2_scan<avx2_digit_stops, sse2_scan<sse2_digit_stops, scalar_skip_digits>>,
+    avx2_scan<avx2_line_stops, sse2_scan<sse2_line_stops, scalar_skip_line>>,
+};
+
+#endif
+
+// Most runs in source text end inside the first 16 bytes, where the 32-byte
+// kernels only add cost, so auto stops at sse2; avx2 pays off on long
+// comments and can be forced.
+const ScanKernels* detect() {
+#if ASMPLE_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) return &SSE2_KERNELS;
+#endif
+    return &SCALAR;
+}
+
+const ScanKernels*& active() {
+    static const ScanKernels* kernels = detect();
+    return kernels;
+}
+
+} // namespace
+
+const ScanKernels& scan_kernels() {
+    return *active();
+}
+
+bool select_scan_kernels(std::string_view name) {
+    if (name == "auto") {
+        active() = detect();
+        return true;
+    }
+    if (name == "scalar") {
+        active() = &SCALAR;
+        return true;
+    }
+#if ASMPLE_SCAN_X86
+    __builtin_cpu_init();
+    if (name == "sse2" && __builtin_cpu_supports("sse2")) {
+        active() = &SSE2_KERNELS;
+        return true;
+    }
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+        active() = &AVX2_KERNELS;
+        return true;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Character classes for the lexer, one table lookup per byte. Only ASCII
+// letters and digits count, which is what <cctype> gives in the C locale.
+enum CharClass : uint8_t {
+    CHAR_BLANK = 1, // ' ', '\t', '\r' (newlines are tokens)
+    CHAR_DIGIT = 2,
+    CHAR_ALPHA = 4,
+    CHAR_WORD = 8,  // letters, digits and '_'
+};
+
+constexpr std::array<uint8_t, 256> make_char_classes() {
+    std::array<uint8_t, 256> table{};
+    table[' '] = table['\t'] = table['\r'] = CHAR_BLANK;
+    for (int c = '0'; c <= '9'; ++c) table[c] = CHAR_DIGIT | CHAR_WORD;
+    for (int c = 'a'; c <= 'z'; ++c) table[c] = CHAR_ALPHA | CHAR_WORD;
+    for (int c = 'A'; c <= 'Z'; ++c) table[c] = CHAR_ALPHA | CHAR_WORD;
+    table['_'] = CHAR_WORD;
+    return table;
+}
+
+inline constexpr std::array<uint8_t, 256> char_classes = make_char_classes();
+
+inline uint8_t char_class(char c) {
+    return char_classes[static_cast<unsigned char>(c)];
+}
+
+// Scanners behind the lexer's runs of blanks, comments, words and numbers.
+// Each returns the index of the first byte in [pos, end) that ends the run,
+// or `end`. The SIMD variants test 16 or 32 bytes per step and finish the
+// last partial block one byte at a time; all variants agree exactly.
+struct ScanKernels {
+    const char* name;
+    size_t (*skip_blanks)(const char* text, size_t pos, size_t end);
+    size_t (*skip_word)(const char* text, size_t pos, size_t end);
+    size_t (*skip_digits)(const char* text, size_t pos, size_t end);
+    // Stops at '\n' or at a NUL byte, which ends the source for the lexer.
+    size_t (*skip_line)(const char* text, size_t pos, size_t end);
+};
+
+const ScanKernels& scan_kernels();
+// Forces "scalar", "sse2" or "avx2" ("auto" re-detects). Returns false for
+// an unknown name or one this CPU cannot run.
+bool select_scan_kernels(std::string_view name);
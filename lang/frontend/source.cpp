@@ -0,0 +1,56 @@
+#include "source.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::~SourceFile() {
+    close();
+}
+
+bool SourceFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            mapping = addr;
+            mapping_size = static_cast<size_t>(st.st_size);
+            view = std::string_view(static_cast<const char*>(addr), mapping_size);
+            ::close(fd);
+            return true;
+        }
+    }
+
+    char chunk[65536];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0)
+        buffer.append(chunk, static_cast<size_t>(n));
+    ::close(fd);
+    if (n < 0) return false;
+    view = buffer;
+    return true;
+}
+
+void SourceFile::release(size_t offset) {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    static const size_t granularity = page * 1024;
+    if (!mapping || offset > mapping_size) return;
+    size_t end = offset / granularity * granularity;
+    if (end <= released) return;
+    madvise(static_cast<char*>(mapping) + released, end - released, MADV_DONTNEED);
+    released = end;
+}
+
+void SourceFile::close() {
+    if (mapping) munmap(mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+    released = 0;
+    buffer.clear();
+    view = std::string_view();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Read-only view of a source file. Regular files are memory-mapped so the
+// lexer and the tokens it produces can refer to the original bytes without
+// copying; anything that cannot be mapped (pipes, empty files) is read
+// into an owned buffer instead.
+class SourceFile {
+public:
+    SourceFile() = default;
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    bool open(const std::string& path);
+    std::string_view text() const { return view; }
+
+    // Drops resident pages of the mapping below `offset`. The view stays
+    // valid: touching those bytes again faults them back in from the file.
+    void release(size_t offset);
+
+private:
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    size_t released = 0;
+    std::string buffer;
+    std::string_view view;
+
+    void close();
+};
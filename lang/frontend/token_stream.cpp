@@ -0,0 +1,38 @@
+#include "token_stream.hpp"
+
+TokenStream::TokenStream(Lexer& lexer, SourceFile* source)
+    : lexer(&lexer), source(source) {
+    window.reserve(CHUNK_SIZE);
+}
+
+TokenStream::TokenStream(const std::vector<Token>& tokens)
+    : tokens(&tokens) {}
+
+Token TokenStream::next() {
+    ++count;
+    if (tokens) {
+        if (index < tokens->size())
+            return (*tokens)[index++];
+        return Token(TokenType::EOF_TOKEN, "");
+    }
+    if (index == window.size()) {
+        if (exhausted)
+            return window.back();
+        refill();
+    }
+    return window[index++];
+}
+
+void TokenStream::refill() {
+    window.clear();
+    index = 0;
+    while (window.size() < CHUNK_SIZE) {
+        window.push_back(lexer->next_token());
+        if (window.back().type == TokenType::EOF_TOKEN) {
+            exhausted = true;
+            break;
+        }
+    }
+    if (source)
+        source->release(lexer->offset());
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "lexer.hpp"
+#include "source.hpp"
+#include "tokens.hpp"
+
+// Pull-based token source for the parser. Over a Lexer, tokens are produced
+// on demand in fixed-size chunks, so only a small window is ever resident.
+// When the backing SourceFile is given, already-lexed source pages are
+// handed back to the kernel as the window moves forward.
+class TokenStream {
+public:
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    explicit TokenStream(Lexer& lexer, SourceFile* source = nullptr);
+    explicit TokenStream(const std::vector<Token>& tokens);
+
+    Token next();
+    size_t consumed() const { return count; }
+
+private:
+    Lexer* lexer = nullptr;
+    SourceFile* source = nullptr;
+    const std::vector<Token>* tokens = nullptr;
+    std::vector<Token> window;
+    size_t index = 0;
+    size_t count = 0;
+    bool exhausted = false;
+
+    void refill();
+};
@@ -1,6 +1,7 @@
 #pragma once
-#include <string>
-#include <vector>
+#include <string_view>
+
+#include "../common/instructions.hpp"
 
 struct Flags {
     bool equal = false;
@@ -21,21 +22,20 @@ enum class TokenType {
     NEWLINE,
     LABEL,
     COLON,
+    LBRACKET,
+    RBRACKET,
     EOF_TOKEN
 };
 
+// Token text is a view into the source buffer, which must outlive every
+// token and AST node built from it. KEYWORD tokens carry their instruction.
 struct Token {
     TokenType type;
-    std::string value;
+    Mnemonic op = Mnemonic::NONE;
+    std::string_view value;
     int line;
     int column;
 
-    Token(TokenType t, std::string v, int l = 0, int c = 0)
-        : type(t), value(std::move(v)), line(l), column(c) {}
+    Token(TokenType t, std::string_view v, int l = 0, int c = 0, Mnemonic m = Mnemonic::NONE)
+        : type(t), op(m), value(v), line(l), column(c) {}
 };
-
-inline const std::vector<std::string> keywords = {
-    "let", "add", "sub", "mul", "div",
-    "cmp", "jmp", "je", "jne", "jl",
-    "jg", "jle", "jge", "print"
-};
\ No newline at end of file
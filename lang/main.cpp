@@ -1,32 +1,408 @@
+#include <atomic>
+#include <charconv>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include <new>
+#include <unistd.h>
+#include "../frontend/source.hpp"
 #include "../frontend/lexer.hpp"
 #include "../frontend/parser.hpp"
+#include "../frontend/scan.hpp"
+#include "../backend/arithmetic.hpp"
 #include "../backend/interpreter.hpp"
+#include "../backend/batch.hpp"
+#include "../backend/cache.hpp"
+#include "../backend/compiler.hpp"
+#include "../backend/cpp_emitter.hpp"
+#include "../backend/optimizer.hpp"
+#include "../backend/vm.hpp"
+#include "../backend/jit.hpp"
+#include "../backend/memory.hpp"
+#include "../backend/peephole.hpp"
+#include "../backend/simd.hpp"
+#include "../backend/stats.hpp"
+#include "../backend/watch.hpp"
+
+// Heap allocations for --stats, counted in this binary only so embedders
+// of asmple_core keep their own operator new.
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// A whole decimal number, for options like --jobs=N.
+static bool parse_count(std::string_view text, size_t& value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && ec == std::errc() && end == text.data() + text.size();
+}
 
 int main(int argc, char* argv[]) {
     std::string filename = "tests/lang/example.asmp";
-    if (argc > 1) filename = argv[1];
+    std::string engine = "vm";
+    Dispatch dispatch = Dispatch::SWITCH;
+    bool optimize = true;
+    bool emit_ir = false;
+    bool emit_cpp = false;
+    std::string cpp_file;
+    bool batch = false;
+    BatchOptions batch_options;
+    std::vector<std::string> inputs;
+    bool profile = false;
+    bool use_cache = true;
+    std::string cache_dir;
+    bool peephole = true;
+    bool dump_peephole = false;
+    std::string data_file;
+    size_t memory_words = Memory::DEFAULT_WORDS;
+    bool checked_memory = true;
+    ArithmeticPolicy arithmetic = ArithmeticPolicy::INT32_WRAP;
+    std::string stats_format; // empty: no --stats
+    bool perf_counters = false;
+    bool watching = false;
+    bool bytecode_options = false; // an engine other than tree, or its settings
+    BufferMode output_mode = isatty(1) ? BufferMode::LINE : BufferMode::BLOCK;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0) {
+            engine = arg.substr(9);
+            if (engine != "vm" && engine != "tree" && engine != "jit") {
+                std::cerr << "Unknown engine: " << engine << " (expected vm, tree or jit)\n";
+                return 1;
+            }
+            bytecode_options = bytecode_options || engine != "tree";
+        } else if (arg == "--dispatch=switch") {
+            dispatch = Dispatch::SWITCH;
+            bytecode_options = true;
+        } else if (arg == "--dispatch=threaded") {
+            dispatch = Dispatch::THREADED;
+            bytecode_options = true;
+        } else if (arg == "--no-optimize") {
+            optimize = false;
+            bytecode_options = true;
+        } else if (arg == "--emit-ir") {
+            emit_ir = true;
+        } else if (arg == "--emit-cpp") {
+            emit_cpp = true;
+        } else if (arg.rfind("--emit-cpp=", 0) == 0) {
+            emit_cpp = true;
+            cpp_file = arg.substr(11);
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            if (!parse_count(arg.substr(7), batch_options.jobs)) {
+                std::cerr << "Invalid job count: " << arg.substr(7) << " (expected a number, 0 for one per core)\n";
+                return 1;
+            }
+        } else if (arg.rfind("--output-dir=", 0) == 0) {
+            batch_options.output_dir = arg.substr(13);
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--no-cache") {
+            use_cache = false;
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            cache_dir = arg.substr(12);
+        } else if (arg == "--no-peephole") {
+            peephole = false;
+            bytecode_options = true;
+        } else if (arg == "--dump-peephole") {
+            dump_peephole = true;
+            bytecode_options = true;
+        } else if (arg.rfind("--data=", 0) == 0) {
+            data_file = arg.substr(7);
+        } else if (arg.rfind("--memory=", 0) == 0) {
+            if (!parse_count(arg.substr(9), memory_words)) {
+                std::cerr << "Invalid memory size: " << arg.substr(9) << " (expected a number of words)\n";
+                return 1;
+            }
+        } else if (arg == "--unchecked-memory") {
+            checked_memory = false;
+        } else if (arg.rfind("--simd=", 0) == 0) {
+            std::string level = arg.substr(7);
+            if (!select_vector_kernels(level) ||
+                !select_scan_kernels(level == "sse4" ? "sse2" : level)) {
+                std::cerr << "Unknown or unsupported SIMD level: " << level
+                          << " (expected auto, scalar, sse4 or avx2)\n";
+                return 1;
+            }
+        } else if (arg.rfind("--arith=", 0) == 0) {
+            if (!parse_arithmetic(arg.substr(8), arithmetic)) {
+                std::cerr << "Unknown arithmetic policy: " << arg.substr(8)
+                          << " (expected int32|int64 with -wrap, -trap or -saturate)\n";
+                return 1;
+            }
+        } else if (arg == "--stats" || arg == "--stats=text") {
+            stats_format = "text";
+        } else if (arg == "--stats=json") {
+            stats_format = "json";
+        } else if (arg == "--perf-counters") {
+            perf_counters = true;
+        } else if (arg == "--watch") {
+            watching = true;
+        } else if (arg == "--output=line") {
+            output_mode = BufferMode::LINE;
+        } else if (arg == "--output=block") {
+            output_mode = BufferMode::BLOCK;
+        } else if (arg == "--output=unbuffered") {
+            output_mode = BufferMode::UNBUFFERED;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        } else {
+            filename = arg;
+            inputs.push_back(arg);
+        }
+    }
 
-    std::ifstream file(filename);
-    if (!file) {
+    if (profile) {
+        if (engine == "tree") {
+            std::cerr << "--profile runs on the vm engine\n";
+            return 1;
+        }
+        // Profile the plain bytecode with its debug info: no superinstructions,
+        // no JIT and no cached program (the cache has no source positions).
+        engine = "vm";
+        peephole = false;
+        use_cache = false;
+    }
+
+    RunStats stats;
+    if (!stats_format.empty()) {
+        if (batch || emit_ir || emit_cpp) {
+            std::cerr << "--stats reports a single run\n";
+            return 1;
+        }
+        // Like --profile, the VM counts the plain bytecode: no
+        // superinstructions and no JIT.
+        if (engine == "jit") engine = "vm";
+        peephole = false;
+        stats.enable(&allocations, perf_counters);
+        if (perf_counters && !stats.has_hardware_counters())
+            std::cerr << "Hardware counters are unavailable (perf_event_open failed)\n";
+    }
+
+    if (arithmetic != ArithmeticPolicy::INT32_WRAP) {
+        // The bytecode engines only implement 32-bit wrapping arithmetic.
+        if (profile || batch || emit_cpp) {
+            std::cerr << "--arith=" << arithmetic_name(arithmetic) << " runs on the tree engine\n";
+            return 1;
+        }
+        engine = "tree";
+    }
+
+    const bool precompiled = filename.size() > 6 &&
+                             filename.compare(filename.size() - 6, 6, ".asmpc") == 0;
+
+    if (watching) {
+        // The resident AST is run by the tree engine; recompiling to
+        // bytecode would cost time in proportion to the whole program.
+        if (batch || emit_ir || emit_cpp || profile || stats.enabled() || precompiled || bytecode_options) {
+            std::cerr << "--watch re-runs one source file on the tree engine\n";
+            return 1;
+        }
+        WatchOptions options;
+        options.arithmetic = arithmetic;
+        options.output_mode = output_mode;
+        options.data_file = data_file;
+        options.memory_words = memory_words;
+        options.checked_memory = checked_memory;
+        return watch(filename, options);
+    }
+
+    if (batch) {
+        if (engine == "jit") {
+            std::cerr << "Batch mode runs the vm or tree engine\n";
+            return 1;
+        }
+        batch_options.engine = engine;
+        batch_options.optimize = optimize;
+        BatchRunner runner(batch_options);
+        size_t failed;
+        try {
+            failed = runner.run(BatchRunner::collect(inputs));
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        runner.summary(std::cerr);
+        return failed ? 1 : 0;
+    }
+
+    std::unique_ptr<Memory> memory;
+    try {
+        memory = std::make_unique<Memory>(memory_words);
+        if (!data_file.empty()) memory->map_file(data_file);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    memory->set_checked(checked_memory);
+
+    stats.begin("read");
+    ProgramCache cache(cache_dir);
+    Program program;
+    bool have_program = false;
+
+    if (precompiled) {
+        if (engine == "tree" || emit_ir || emit_cpp) {
+            std::cerr << "A precompiled program can only run on the vm or jit engine\n";
+            return 1;
+        }
+        if (!cache.load(filename, program)) {
+            std::cerr << "Invalid or outdated program cache: " << filename << "\n";
+            return 1;
+        }
+        have_program = true;
+    }
+
+    SourceFile source;
+    if (!precompiled && !source.open(filename)) {
         std::cerr << "Could not open " << filename << "\n";
         return 1;
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
 
-    Lexer lexer(source);
-    auto tokens = lexer.tokenize();
+    // The cache only holds bytecode, so the tree engine, --emit-ir and
+    // --emit-cpp always go through the front end.
+    const bool cached = use_cache && !precompiled && engine != "tree" && !emit_ir && !emit_cpp;
+    uint64_t cache_key = 0;
+    std::string cache_path;
+    if (cached) {
+        cache_key = ProgramCache::key(source.text(), optimize);
+        cache_path = cache.path_for(filename, cache_key);
+        have_program = cache.load(cache_path, cache_key, program);
+    }
+    stats.end();
 
-    Parser parser(tokens);
-    auto ast = parser.parse();
+    // --stats lexes everything up front so lexing and parsing are timed
+    // apart; otherwise the parser pulls tokens as it goes.
+    Lexer lexer(source.text());
+    std::vector<Token> lexed;
+    if (stats.enabled() && !have_program) {
+        stats.begin("lex");
+        lexed = lexer.tokenize();
+        stats.end();
+    }
+    TokenStream tokens = stats.enabled() ? TokenStream(lexed) : TokenStream(lexer, &source);
 
-    Interpreter interpreter;
-    interpreter.interpret(ast);
+    Arena arena;
+    Parser parser(tokens, arena);
+    std::vector<ASTNode*> ast;
+    if (!have_program) {
+        stats.begin("parse");
+        ast = parser.parse();
+        stats.end();
+    }
+
+    stats.set_engine(engine);
+    auto finish = [&](int status) {
+        if (!stats.enabled()) return status;
+        stats.end();
+        if (stats_format == "json") stats.report_json(std::cerr);
+        else stats.report(std::cerr);
+        return status;
+    };
 
-    // interpreter.dump_registers();
-    return 0;
-}
\ No newline at end of file
+    try {
+        if (emit_ir) {
+            Compiler compiler;
+            IRProgram ir = compiler.build(ast);
+            Optimizer optimizer;
+            if (optimize) optimizer.optimize(ir);
+            ir.dump(std::cout);
+            if (optimize) optimizer.dump_stats(std::cout);
+        } else if (emit_cpp) {
+            // Translating a program with syntax errors would hide them in a
+            // binary that silently skips the bad lines.
+            if (parser.error_count() > 0) return 1;
+            Compiler compiler;
+            program = compiler.compile(ast, optimize);
+            CppEmitter emitter;
+            if (cpp_file.empty()) {
+                emitter.emit(program, std::cout, filename);
+            } else {
+                std::ofstream out(cpp_file);
+                if (!out) {
+                    std::cerr << "Could not write " << cpp_file << "\n";
+                    return 1;
+                }
+                emitter.emit(program, out, filename);
+                if (!out.flush()) {
+                    std::cerr << "Could not write " << cpp_file << "\n";
+                    return 1;
+                }
+            }
+        } else if (engine == "tree") {
+            with_arithmetic(arithmetic, [&](auto arith) {
+                BasicInterpreter<decltype(arith)> interpreter(output_mode);
+                interpreter.attach_memory(memory.get());
+                if (stats.enabled()) interpreter.count_into(&stats.counts());
+                stats.begin("run");
+                interpreter.interpret(ast);
+                stats.end();
+                // interpreter.dump_registers();
+            });
+        } else {
+            if (!have_program) {
+                stats.begin("compile");
+                Compiler compiler;
+                program = compiler.compile(ast, optimize);
+                stats.end();
+                // Programs with syntax errors are not cached so the errors
+                // are reported again on the next run.
+                if (cached && parser.error_count() == 0)
+                    cache.store(cache_path, cache_key, program);
+            }
+            if (engine == "jit") {
+                Jit jit(output_mode);
+                if (jit.compile(program)) {
+                    jit.run();
+                    return 0;
+                }
+            }
+            if (peephole) {
+                Peephole pass;
+                pass.optimize(program);
+                if (dump_peephole) pass.dump(std::cerr);
+            }
+            VM vm(output_mode);
+            vm.attach_memory(memory.get());
+            if (profile || stats.enabled()) {
+                Profiler profiler(profile);
+                auto report = [&] {
+                    if (profile) profiler.report(program, std::cerr);
+                    stats.counts() = ExecutionCounts::from_profile(program, profiler);
+                };
+                stats.begin("run");
+                try {
+                    vm.run(program, dispatch, &profiler);
+                } catch (const std::runtime_error&) {
+                    stats.end();
+                    report();
+                    throw;
+                }
+                stats.end();
+                report();
+                return finish(0);
+            }
+            vm.run(program, dispatch);
+            // vm.dump_registers();
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return finish(1);
+    }
+    return finish(0);
+}
@@ -0,0 +1,39 @@
+# cmake -DASMPLE=<asmple> -DAOT=<binary> -DSOURCE=<prog.asmp> -DINPUT=<file> -P compare_aot.cmake
+#
+# Runs a program built by asmple_add_executable and the same source on the
+# tree interpreter with the same stdin, and fails unless stdout, stderr
+# and the exit code all match.
+foreach(var ASMPLE AOT SOURCE INPUT)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "compare_aot.cmake: ${var} is not set")
+    endif()
+endforeach()
+
+execute_process(
+    COMMAND "${ASMPLE}" --engine=tree --no-cache "${SOURCE}"
+    INPUT_FILE "${INPUT}"
+    OUTPUT_VARIABLE tree_out
+    ERROR_VARIABLE tree_err
+    RESULT_VARIABLE tree_status
+)
+execute_process(
+    COMMAND "${AOT}"
+    INPUT_FILE "${INPUT}"
+    OUTPUT_VARIABLE aot_out
+    ERROR_VARIABLE aot_err
+    RESULT_VARIABLE aot_status
+)
+
+set(differs "")
+if(NOT tree_out STREQUAL aot_out)
+    string(APPEND differs "stdout:\n--- tree\n${tree_out}\n--- aot\n${aot_out}\n")
+endif()
+if(NOT tree_err STREQUAL aot_err)
+    string(APPEND differs "stderr:\n--- tree\n${tree_err}\n--- aot\n${aot_err}\n")
+endif()
+if(NOT tree_status STREQUAL aot_status)
+    string(APPEND differs "exit code: tree ${tree_status}, aot ${aot_status}\n")
+endif()
+if(differs)
+    message(FATAL_ERROR "${SOURCE}: the --emit-cpp build differs from the tree interpreter\n${differs}")
+endif()
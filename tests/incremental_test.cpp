@@ -0,0 +1,215 @@
+// Edits small programs through IncrementalProgram and checks after every
+// update that it holds what a full parse of the same text gives: the same
+// nodes in the same order, jumps and calls landing on the same node, the
+// same number of syntax errors and the same undefined-label error. Edits
+// are random (seeded) insertions, deletions and line replacements built
+// from label, jump, call and comment snippets.
+//
+// usage: asmple_incremental_test [--seed N] [--rounds N]
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../lang/frontend/incremental.hpp"
+#include "../lang/frontend/lexer.hpp"
+#include "../lang/frontend/parser.hpp"
+
+namespace {
+
+const char* const programs[] = {
+    "let x = 0\nloop:\n    add x, 1\n    cmp x, 10\n    jl loop\nprint x\n",
+    "let n = 5\ncall square\nprint n\njmp end\nsquare:\n    mul n, n\n    ret\nend:\n",
+    "; duplicate labels: the last one wins\na:\nprint 1\na:\nprint 2\njmp a\n",
+    "start: let i = 3\n  sub i, 1\n  cmp i, 0\n  jg start\n  jmp missing\n",
+    "",
+    "print 7",
+};
+
+const char* const snippets[] = {
+    "jmp end\n", "end:\n", "loop:\n", "a:\n", "print x\n", "let x = 3\n", "add x, 1\n", "cmp x, 10\n",
+    "jl loop\n", "jge end\n", "; comment\n", "\n", "call sub\n", "ret\n", "sub:\n", "foo: print 7\n",
+    "let m = -5\n", "x", " ", "1", ":", ";",
+};
+
+// The label of a jump or call, nullptr for any other node.
+const Token* branch_label(const ASTNode* node) {
+    if (node->kind == NodeKind::JUMP)
+        return &static_cast<const JumpNode*>(node)->label;
+    if (node->kind == NodeKind::STACK && static_cast<const StackNode*>(node)->op == StackOp::CALL)
+        return &static_cast<const StackNode*>(node)->label;
+    return nullptr;
+}
+
+std::string describe(const ASTNode* node) {
+    if (!node) return "null";
+    std::string s = node_kind_name(node->kind);
+    switch (node->kind) {
+        case NodeKind::NUMBER: return s + " " + std::string(static_cast<const NumberNode*>(node)->token.value);
+        case NodeKind::IDENTIFIER: return s + " " + std::string(static_cast<const IdentifierNode*>(node)->token.value);
+        case NodeKind::ASSIGNMENT: {
+            auto* n = static_cast<const AssignmentNode*>(node);
+            return s + " " + std::string(n->var_token.value) + " = " + describe(n->value);
+        }
+        case NodeKind::BINOP: {
+            auto* n = static_cast<const BinOpNode*>(node);
+            return s + " " + std::string(n->op_token.value) + " " + describe(n->left) + ", " + describe(n->right);
+        }
+        case NodeKind::PRINT: return s + " " + describe(static_cast<const PrintNode*>(node)->expr);
+        case NodeKind::CMP: {
+            auto* n = static_cast<const CmpNode*>(node);
+            return s + " " + describe(n->left) + ", " + describe(n->right);
+        }
+        case NodeKind::LABEL: return s + " " + std::string(static_cast<const LabelNode*>(node)->label);
+        case NodeKind::STACK: return s + " " + std::string(static_cast<const StackNode*>(node)->op_token.value);
+        default: return s;
+    }
+}
+
+// One line per node, a jump or call followed by the index it lands on,
+// then the undefined-label error if there is one.
+struct Snapshot {
+    std::string nodes;
+    std::string error;
+    size_t errors = 0;
+
+    bool operator==(const Snapshot& other) const {
+        return nodes == other.nodes && error == other.error && errors == other.errors;
+    }
+};
+
+std::string landing(size_t target) {
+    return target == SIZE_MAX ? " -> undefined" : " -> " + std::to_string(target);
+}
+
+Snapshot full_parse(const std::string& text) {
+    Lexer lexer(text);
+    auto tokens = lexer.tokenize();
+    Arena arena;
+    std::ostringstream diagnostics;
+    Parser parser(tokens, arena);
+    parser.report_to(diagnostics);
+    auto ast = parser.parse();
+
+    Snapshot snapshot;
+    snapshot.errors = parser.error_count();
+    std::unordered_map<std::string_view, size_t> labels;
+    for (size_t i = 0; i < ast.size(); ++i)
+        if (ast[i]->kind == NodeKind::LABEL) labels[static_cast<const LabelNode*>(ast[i])->label] = i + 1;
+    for (const ASTNode* node : ast) {
+        snapshot.nodes += describe(node);
+        if (const Token* label = branch_label(node)) {
+            auto it = labels.find(label->value);
+            snapshot.nodes += landing(it == labels.end() ? SIZE_MAX : it->second);
+            if (it == labels.end() && snapshot.error.empty())
+                snapshot.error = "Undefined label '" + std::string(label->value) + "' at line " +
+                                 std::to_string(label->line) + ", column " + std::to_string(label->column);
+        }
+        snapshot.nodes += "\n";
+    }
+    return snapshot;
+}
+
+Snapshot resident(const IncrementalProgram& program) {
+    Snapshot snapshot;
+    snapshot.errors = program.error_count();
+    // Positions are numbered as a full parse numbers its nodes.
+    std::unordered_map<size_t, size_t> index;
+    std::vector<const ASTNode*> nodes;
+    for (size_t position = program.start(); position != IncrementalProgram::END; position = program.next(position)) {
+        index[position] = nodes.size();
+        nodes.push_back(program.at(position));
+    }
+    index[IncrementalProgram::END] = nodes.size();
+    for (const ASTNode* node : nodes) {
+        snapshot.nodes += describe(node);
+        if (branch_label(node)) {
+            size_t slot = node->kind == NodeKind::JUMP ? static_cast<const JumpNode*>(node)->target
+                                                        : static_cast<const StackNode*>(node)->target;
+            snapshot.nodes += landing(program.defined(slot) ? index.at(program.target(slot)) : SIZE_MAX);
+        }
+        snapshot.nodes += "\n";
+    }
+    try {
+        program.check_labels();
+    } catch (const std::runtime_error& e) {
+        snapshot.error = e.what();
+    }
+    return snapshot;
+}
+
+void edit(std::string& text, std::mt19937& rng) {
+    const size_t count = sizeof(snippets) / sizeof(snippets[0]);
+    const size_t pos = rng() % (text.size() + 1);
+    switch (rng() % 4) {
+        case 0:
+            text.erase(pos, rng() % 8);
+            break;
+        case 1:
+            text.insert(pos, snippets[rng() % count]);
+            break;
+        case 2: { // replace the line holding pos
+            size_t start = pos == 0 ? 0 : text.rfind('\n', pos - 1);
+            start = start == std::string::npos || pos == 0 ? 0 : start + 1;
+            size_t end = text.find('\n', pos);
+            text.replace(start, (end == std::string::npos ? text.size() : end) - start, snippets[rng() % count]);
+            break;
+        }
+        default:
+            text.insert(pos, std::string(snippets[rng() % count]) + snippets[rng() % count]);
+            break;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned seed = 1;
+    size_t rounds = 200;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--rounds" && i + 1 < argc) rounds = std::strtoul(argv[++i], nullptr, 10);
+        else {
+            std::fprintf(stderr, "usage: %s [--seed N] [--rounds N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // IncrementalProgram's parsers report syntax errors to std::cerr;
+    // only their count is compared.
+    std::ostringstream quiet;
+    std::streambuf* stderr_buffer = std::cerr.rdbuf(quiet.rdbuf());
+
+    std::mt19937 rng(seed);
+    const size_t program_count = sizeof(programs) / sizeof(programs[0]);
+    size_t checks = 0, failures = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+        std::string text = programs[round % program_count];
+        IncrementalProgram program;
+        for (int step = 0; step < 30; ++step) {
+            std::string next = text;
+            program.update(next);
+            quiet.str("");
+            Snapshot want = full_parse(text);
+            Snapshot got = resident(program);
+            ++checks;
+            if (!(got == want) && ++failures <= 3) {
+                std::printf("round %zu, step %d differs\n--- text\n%s\n--- incremental (%zu syntax errors)\n%s%s\n"
+                            "--- full parse (%zu syntax errors)\n%s%s\n",
+                            round, step, text.c_str(), got.errors, got.nodes.c_str(), got.error.c_str(), want.errors,
+                            want.nodes.c_str(), want.error.c_str());
+            }
+            edit(text, rng);
+        }
+    }
+
+    std::cerr.rdbuf(stderr_buffer);
+    std::printf("%zu checks, %zu mismatches\n", checks, failures);
+    return failures ? 1 : 0;
+}